@@ -296,6 +296,15 @@ SOURCES   += src/main.cpp\
              src/gvgenerictimevalue.cpp \
              src/wgenerictimevalue.cpp \
              src/wdialogfiletypechoosertxt.cpp \
+             src/polyphaseresampler.cpp \
+             src/yinestimator.cpp \
+             src/textcolumnsreader.cpp \
+             src/binaryarrayreader.cpp \
+             src/ftfzerotracking.cpp \
+             src/biquadcascade.cpp \
+             src/stftmasking.cpp \
+             src/soundsmixer.cpp \
+             src/gvplaycursor.cpp \
              external/libqxt/qxtspanslider.cpp \
              external/audioengine/audioengine.cpp \
              external/libqaudioextra/src/qaesigproc.cpp \
@@ -333,6 +342,16 @@ HEADERS   += src/wmainwindow.h \
              src/gvgenerictimevalue.h \
              src/wgenerictimevalue.h \
              src/wdialogfiletypechoosertxt.h \
+             src/polyphaseresampler.h \
+             src/yinestimator.h \
+             src/textcolumnsreader.h \
+             src/binaryarrayreader.h \
+             src/slidingwindowmaximum.h \
+             src/biquadcascade.h \
+             src/stftmasking.h \
+             src/soundsmixer.h \
+             src/sortedmove.h \
+             src/gvplaycursor.h \
              external/libqxt/qxtglobal.h \
              external/libqxt/qxtnamespace.h \
              external/libqxt/qxtspanslider.h \
@@ -63,11 +63,86 @@ This example has been widely adapted for the purpose of DFasma.
 #include <qendian.h>
 
 #include "../../src/ftsound.h"
+#include "../../src/soundsmixer.h"
 
 #include "qaehelpers.h"
 
 const int    NotifyIntervalMs       = 100;
 
+//-----------------------------------------------------------------------------
+// Audio output worker (lives in the playback thread)
+//-----------------------------------------------------------------------------
+
+AudioOutputWorker::AudioOutputWorker()
+    : m_audioOutput(NULL)
+    , m_source(NULL)
+    , m_state(QAudio::StoppedState)
+    , m_error(QAudio::NoError)
+    , m_processedms(0)
+{
+}
+
+void AudioOutputWorker::create() {
+    destroy();
+
+    m_audioOutput = new QAudioOutput(m_device, m_format, this);
+    m_audioOutput->setNotifyInterval(NotifyIntervalMs); // Use 100ms notification intervals
+    if(m_audioOutput->notifyInterval()!=NotifyIntervalMs)
+        qDebug() << "AudioOutputWorker::create: Chosen notification intervals not used!" << m_audioOutput->notifyInterval() << "is used instead of" << NotifyIntervalMs;
+    connect(m_audioOutput, SIGNAL(notify()), this, SLOT(audioNotify()));
+    connect(m_audioOutput, SIGNAL(stateChanged(QAudio::State)), this, SLOT(audioStateChanged(QAudio::State)));
+}
+
+void AudioOutputWorker::destroy() {
+    if(m_audioOutput){
+        m_audioOutput->disconnect(this);
+        m_audioOutput->stop();
+        delete m_audioOutput;
+        m_audioOutput = NULL;
+    }
+    m_state.store(QAudio::StoppedState);
+}
+
+void AudioOutputWorker::start() {
+    if(m_audioOutput){
+        m_processedms.store(0);
+        m_audioOutput->start(m_source);
+        m_state.store(m_audioOutput->state());
+    }
+}
+
+void AudioOutputWorker::stop() {
+    if(m_audioOutput){
+        m_audioOutput->stop();
+        m_state.store(m_audioOutput->state());
+    }
+}
+
+void AudioOutputWorker::suspend() {
+    if(m_audioOutput){
+        m_audioOutput->suspend();
+        m_state.store(m_audioOutput->state());
+    }
+}
+
+void AudioOutputWorker::resume() {
+    if(m_audioOutput){
+        m_audioOutput->resume();
+        m_state.store(m_audioOutput->state());
+    }
+}
+
+void AudioOutputWorker::audioNotify() {
+    m_processedms.store(int(m_audioOutput->processedUSecs()/1000));
+    emit notify();
+}
+
+void AudioOutputWorker::audioStateChanged(QAudio::State state) {
+    m_error.store(m_audioOutput->error());
+    m_state.store(state);
+    emit stateChanged(int(state));
+}
+
 //-----------------------------------------------------------------------------
 // Constructor and destructor
 //-----------------------------------------------------------------------------
@@ -75,12 +150,27 @@ const int    NotifyIntervalMs       = 100;
 AudioEngine::AudioEngine(QObject *parent)
     : QObject(parent)
     , m_fs(0)
+    , m_clockorigin(0.0)
+    , m_processedms(0)
+    , m_processedtime(0)
+    , m_playedseq(-1)
     , m_state(QAudio::StoppedState)
-    , m_audioOutput(NULL)
+    , m_audioWorker(NULL)
+    , m_hasAudioOutput(false)
     , m_ftsound(NULL)
+    , m_mixer(NULL)
 {
+    m_mixer = new SoundsMixer(this);
+
+    // The audio output runs in its own thread
+    m_audioWorker = new AudioOutputWorker();
+    m_audioWorker->moveToThread(&m_audioThread);
+    connect(m_audioWorker, SIGNAL(notify()), this, SLOT(audioNotify()));
+    connect(m_audioWorker, SIGNAL(stateChanged(int)), this, SLOT(audioStateChanged(int)));
+    m_audioThread.start(QThread::TimeCriticalPriority);
+
     m_rtinfo_timer.setSingleShot(false);
-    m_rtinfo_timer.setInterval(1000*1/12.0);  // Ask for 24 refresh per second
+    m_rtinfo_timer.setInterval(1000*1/60.0);  // Ask for 60 refresh per second (only the cursor strips are repainted)
     connect(&m_rtinfo_timer, SIGNAL(timeout()), this, SLOT(sendRealTimeInfo()));
 }
 
@@ -104,10 +194,15 @@ void AudioEngine::selectAudioOutputDevice(const QString& devicename) {
 
 AudioEngine::~AudioEngine()
 {
-    if(m_audioOutput) {
-        m_audioOutput->stop();
-        delete m_audioOutput;
-    }
+    callAudioWorker("destroy");
+    m_audioThread.quit();
+    m_audioThread.wait();
+    delete m_audioWorker;
+}
+
+// Blocks until the worker has run the method in the playback thread
+void AudioEngine::callAudioWorker(const char* method) {
+    QMetaObject::invokeMethod(m_audioWorker, method, Qt::BlockingQueuedConnection);
 }
 
 //-----------------------------------------------------------------------------
@@ -118,25 +213,29 @@ void AudioEngine::startPlayback(FTSound* dssound, double tstart, double tstop, d
 {
     DLOG << "AudioEngine::startPlayback";
 
-    if (m_audioOutput) {
+    if (m_hasAudioOutput) {
         if (m_state==QAudio::SuspendedState) {
 #ifdef Q_OS_WIN
             // The Windows backend seems to internally go back into ActiveState
             // while still returning SuspendedState, so to ensure that it doesn't
             // ignore the resume() call, we first re-suspend
-            m_audioOutput->suspend();
+            callAudioWorker("suspend");
 #endif
-            m_audioOutput->resume();
+            callAudioWorker("resume");
+            setState(QAudio::State(m_audioWorker->m_state.load()));
         } else {
             stopPlayback();
             m_ftsound = dssound; // Select the new sound to play
 //            connect(m_dssound, SIGNAL(readChannelFinished()), this, SLOT(readChannelFinished()));
-            m_tobeplayed = m_ftsound->setPlay(m_format, tstart, tstop, fstart, fstop);
+            // Play through the mixer, so that the sound can be switched (A/B comparison)
+            m_tobeplayed = m_mixer->setPlay(std::vector<FTSound*>(1, m_ftsound), m_format, tstart, tstop, fstart, fstop);
             // TODO Should check that the device is still available before starting it!
             // 2015-10-22 I cannot find a way to do it with current Qt library (5.2)
-            m_audioOutput->start(m_ftsound);
+            m_audioWorker->m_source = m_mixer;
+            callAudioWorker("start");
+            setState(QAudio::State(m_audioWorker->m_state.load()));
+            startClock();
             m_rtinfo_timer.start();
-            m_starttime = QDateTime::currentMSecsSinceEpoch();
 //            cout << "AudioEngine::startPlayback bufferSize: " << m_audioOutput->bufferSize() << endl;
         }
     }
@@ -144,10 +243,73 @@ void AudioEngine::startPlayback(FTSound* dssound, double tstart, double tstop, d
 //    std::cout << "~AudioEngine::startPlayback" << endl;
 }
 
+void AudioEngine::startPlayback(const std::vector<FTSound*>& sounds, double tstart, double tstop, double headroom)
+{
+    DLOG << "AudioEngine::startPlayback mixing " << sounds.size() << " sounds";
+
+    if (m_hasAudioOutput && !sounds.empty()) {
+        stopPlayback();
+        m_tobeplayed = m_mixer->setPlay(sounds, m_format, tstart, tstop, 0.0, 0.0, headroom);
+
+        // The position is given by the sound which plays the longest
+        m_ftsound = sounds[0];
+        for(size_t si=1; si<sounds.size(); ++si)
+            if(sounds[si]->m_end>m_ftsound->m_end)
+                m_ftsound = sounds[si];
+
+        m_audioWorker->m_source = m_mixer;
+        callAudioWorker("start");
+        setState(QAudio::State(m_audioWorker->m_state.load()));
+        startClock();
+        m_rtinfo_timer.start();
+    }
+}
+
+// Continue the playback with another sound, from the same position
+bool AudioEngine::switchPlayback(FTSound* sound)
+{
+    if(!m_hasAudioOutput || m_state!=QAudio::ActiveState)
+        return false;
+
+    return m_mixer->switchTo(sound);
+}
+
+bool AudioEngine::isLooping() const
+{
+    return FTSound::s_playloop.load()!=0;
+}
+
+// Move the loop while it is playing
+void AudioEngine::setLoopSelection(double tstart, double tstop)
+{
+    if(!m_hasAudioOutput || m_state!=QAudio::ActiveState || !isLooping())
+        return;
+
+    m_mixer->setLoopSelection(tstart, tstop);
+}
+
+void AudioEngine::setLoop(bool loop)
+{
+    FTSound::s_playloop.storeRelease(loop?1:0);
+
+    if(!loop && m_hasAudioOutput && m_state==QAudio::ActiveState && m_ftsound){
+        // Finish the current pass of the loop, and restart the cursor's clock at its beginning
+        double played = playedDuration();
+        qint64 start, end;
+        playedBounds(start, end);
+        double loopdur = double(end-start+1)/m_ftsound->fs;
+        double looppos = 0.0;
+        if(loopdur>0.0)
+            looppos = std::fmod(played-m_clockorigin, loopdur);
+        m_clockorigin = played - looppos;
+        m_tobeplayed = m_clockorigin + loopdur;
+    }
+}
+
 void AudioEngine::stopPlayback()
 {
-    if (m_audioOutput && m_state!=QAudio::StoppedState) {
-        m_audioOutput->stop();
+    if (m_hasAudioOutput && m_state!=QAudio::StoppedState) {
+        callAudioWorker("stop");
         QCoreApplication::instance()->processEvents(); // What was the purpose of this call ? Crashes when called from audioNotify (extremely rarely)
 //        if(m_dssound) m_dssound->stop();
         m_tobeplayed = 0.0;
@@ -181,10 +343,20 @@ void AudioEngine::sendRealTimeInfo(){
 //    std::cout << "start=" << QDateTime::fromMSecsSinceEpoch(m_starttime).toString("hh:mm:ss.zzz             ").toLocal8Bit().constData() << " curr=" << QDateTime::fromMSecsSinceEpoch(QDateTime::currentMSecsSinceEpoch()).toString("hh:mm:ss.zzz             ").toLocal8Bit().constData() << " AudioEngine::sendRealTimeInfo" << endl;
 
     if(m_ftsound){
-        double t = double(m_ftsound->m_start/m_ftsound->fs) + (QDateTime::currentMSecsSinceEpoch() - m_starttime)/1000.0;
+        // The playback thread moves the bounds of the loop, read them as it published them
+        qint64 start, end;
+        playedBounds(start, end);
+        double elapsed = playedDuration() - m_clockorigin;
+        if(isLooping()){
+            double loopdur = double(end-start+1)/m_ftsound->fs;
+            elapsed = std::max(0.0, elapsed); // The frames of the previous loop are still being played
+            if(loopdur>0.0)
+                elapsed = std::fmod(elapsed, loopdur);
+        }
+        double t = double(start/m_ftsound->fs) + elapsed;
 //        double t = double(m_dssound->m_start)/m_dssound->fs + m_audioOutput->processedUSecs()/1000000.0;
 
-        if(t > double(m_ftsound->m_end/m_ftsound->fs)){
+        if(t > double(end/m_ftsound->fs)){
             emit playPositionChanged(-1);
             emit localEnergyChanged(0);
         }
@@ -197,6 +369,32 @@ void AudioEngine::sendRealTimeInfo(){
     }
 }
 
+void AudioEngine::startClock()
+{
+    m_clockorigin = 0.0;
+    m_processedms = 0;
+    m_processedtime = QDateTime::currentMSecsSinceEpoch();
+}
+
+// Bounds of the loop played by the mixer, and the cursor's clock re-based when they changed
+void AudioEngine::playedBounds(qint64& start, qint64& end)
+{
+    int originms;
+    int seq = m_mixer->playedBounds(start, end, originms);
+    if(seq!=m_playedseq){
+        m_playedseq = seq;
+        m_clockorigin = originms/1000.0;
+    }
+}
+
+// [s] Duration played by the device, interpolated since its last notification
+double AudioEngine::playedDuration() const
+{
+    qint64 sincenotify = QDateTime::currentMSecsSinceEpoch() - m_processedtime;
+    sincenotify = qBound(qint64(0), sincenotify, qint64(NotifyIntervalMs)); // Do not run ahead if the device stalls
+    return (m_processedms + sincenotify)/1000.0;
+}
+
 void AudioEngine::audioNotify()
 {
 //    double t = QDateTime::currentMSecsSinceEpoch();
@@ -204,12 +402,19 @@ void AudioEngine::audioNotify()
 //    std::cout << "AudioEngine::audioNotify dt=" << (t-lastt) << " play_pos=" << 100*(m_audioOutput->processedUSecs()/1000000.0)/m_tobeplayed << "%" << endl;
 //    lastt = t;
 
+    int processedms = m_audioWorker->m_processedms.load();
+    if(processedms!=m_processedms){
+        m_processedms = processedms;
+        m_processedtime = QDateTime::currentMSecsSinceEpoch();
+    }
+
     // Add 0.5s in order to give time to the lowest level buffer to be played completely
-    if (m_audioOutput->processedUSecs()/1000000.0 > m_tobeplayed + 0.5){
+    // (a loop plays until it is stopped)
+    if (!isLooping() && m_processedms/1000.0 > m_tobeplayed + 0.5){
         // Stop everything
         // Do not move the following in stopPlayback();
         // Calling QCoreApplication::instance()->processEvents(); Crashes (extremely rarely)
-        m_audioOutput->stop();
+        callAudioWorker("stop");
         m_tobeplayed = 0.0;
         m_rtinfo_timer.stop();
         emit playPositionChanged(-1);
@@ -217,19 +422,23 @@ void AudioEngine::audioNotify()
     }
 }
 
-void AudioEngine::audioStateChanged(QAudio::State state)
+void AudioEngine::audioStateChanged(int state)
 {
     if (state==QAudio::StoppedState) {
 
         // Check error
-        QAudio::Error error = m_audioOutput->error();
+        QAudio::Error error = QAudio::Error(m_audioWorker->m_error.load());
+
+        // The output doesn't read the mixed sounds anymore
+        if(m_mixer->isOpen())
+            m_mixer->stopPlay();
 
         if (QAudio::NoError != error) {
             reset();
             return;
         }
     }
-    setState(state);
+    setState(QAudio::State(state));
 }
 
 void AudioEngine::reset() {
@@ -242,26 +451,51 @@ void AudioEngine::reset() {
 
 bool AudioEngine::initialize(int fs) {
     m_fs = fs;
-    m_audioOutput = NULL;
-    m_ftsound = NULL;
     stopPlayback();
+    m_ftsound = NULL;
+    callAudioWorker("destroy");
+    m_hasAudioOutput = false;
     setState(QAudio::StoppedState);
     setFormat(QAudioFormat());
 
     QAudioFormat prevformat = m_format;
 
-    // Force fs and channel count to that of the file
-    // TODO Try different audio output
+    // Prefer fs of the files, which avoids any resampling.
+    // Otherwise, use the rate preferred by the device and the mixer resamples
+    // the sounds on the fly (e.g. USB interfaces running at 48kHz only).
+    // Take the first sample type supported by the device
+    // (SoundsMixer::readData can write any of these)
     QAudioFormat format;
     format.setByteOrder(QAudioFormat::LittleEndian);
     format.setCodec("audio/pcm");
-    format.setSampleSize(16);
-    format.setSampleType(QAudioFormat::SignedInt);
-    format.setSampleRate(m_fs);
-    format.setChannelCount(1);
 
-    DLOG << "Try format: " << format;
-    if (!m_audioOutputDevice.isFormatSupported(format)){
+    const int nbrates = 4;
+    const int samplerates[nbrates] = {m_fs, m_audioOutputDevice.preferredFormat().sampleRate(), 48000, 44100};
+
+    // Stereo is preferred, for panning the mixed sounds
+    const int nbtypes = 4;
+    const int samplesizes[nbtypes] = {16, 32, 32, 24};
+    const QAudioFormat::SampleType sampletypes[nbtypes] = {QAudioFormat::SignedInt, QAudioFormat::Float, QAudioFormat::SignedInt, QAudioFormat::SignedInt};
+    bool supported = false;
+    for(int ri=0; ri<nbrates && !supported; ++ri) {
+        if(samplerates[ri]<=0)
+            continue;
+        format.setSampleRate(samplerates[ri]);
+        for(int nbchannels=2; nbchannels>=1 && !supported; --nbchannels) {
+            format.setChannelCount(nbchannels);
+            for(int ti=0; ti<nbtypes && !supported; ++ti) {
+                format.setSampleSize(samplesizes[ti]);
+                format.setSampleType(sampletypes[ti]);
+                DLOG << "Try format: " << format;
+                supported = m_audioOutputDevice.isFormatSupported(format);
+            }
+        }
+    }
+    if (!supported){
+        format.setSampleRate(m_fs);
+        format.setChannelCount(1);
+        format.setSampleSize(16);
+        format.setSampleType(QAudioFormat::SignedInt);
         QString formatstr = formatToString(format);
         DLOG << "Format "+formatstr+" not supported. There will be no audio output!";
         throw QString("Audio output format "+formatstr+" not supported.");
@@ -271,20 +505,11 @@ bool AudioEngine::initialize(int fs) {
 
     DLOG << "Format changed";
 
-    // Clear any previous audio output
-    if(m_audioOutput){
-        m_audioOutput->disconnect(this);
-        delete m_audioOutput;
-        m_audioOutput = NULL;
-    }
-
-    // Build the new audio output
-    m_audioOutput = new QAudioOutput(m_audioOutputDevice, m_format, this);
-    m_audioOutput->setNotifyInterval(NotifyIntervalMs); // Use 100ms notification intervals
-    if(m_audioOutput->notifyInterval()!=NotifyIntervalMs)
-        qDebug() << "AudioEngine::initialize: Chosen notification intervals not used!" << m_audioOutput->notifyInterval() << "is used instead of" << NotifyIntervalMs;
-    connect(m_audioOutput, SIGNAL(notify()), this, SLOT(audioNotify()));
-    connect(m_audioOutput, SIGNAL(stateChanged(QAudio::State)), this, SLOT(audioStateChanged(QAudio::State)));
+    // Build the new audio output (replaces any previous one)
+    m_audioWorker->m_device = m_audioOutputDevice;
+    m_audioWorker->m_format = m_format;
+    callAudioWorker("create");
+    m_hasAudioOutput = true;
 
     // qDebug() << "AudioEngine::initialize " << "format=" << m_format;
 
@@ -296,7 +521,7 @@ bool AudioEngine::initialize(int fs) {
 
 bool AudioEngine::isInitialized(){
     return !m_audioOutputDevice.isNull()
-            && m_audioOutput!=NULL
+            && m_hasAudioOutput
             && m_fs>0;
 }
 
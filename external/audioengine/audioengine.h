@@ -46,6 +46,7 @@ This example has been widely adapted for the purpose of DFasma.
 #define AUDIOENGINE_H
 
 #include <deque>
+#include <vector>
 using namespace std;
 
 #include <QAudioDeviceInfo>
@@ -56,13 +57,55 @@ using namespace std;
 #include <QObject>
 #include <QVector>
 #include <QTimer>
+#include <QThread>
+#include <QAtomicInt>
 
 class FTSound;
+class SoundsMixer;
 QT_BEGIN_NAMESPACE
 class QAudioInput;
 class QAudioOutput;
 QT_END_NAMESPACE
 
+// Owns the audio output in the playback thread, so that the device is fed
+// by this thread's event loop, even when the GUI thread is busy.
+// All the calls to the QAudioOutput are made from this thread.
+class AudioOutputWorker : public QObject
+{
+    Q_OBJECT
+
+    QAudioOutput* m_audioOutput;
+
+public:
+    AudioOutputWorker();
+
+    // Set by the GUI thread before calling the slots below
+    QAudioDeviceInfo m_device;
+    QAudioFormat m_format;
+    QIODevice* m_source;
+
+    // Published for the GUI thread
+    QAtomicInt m_state;       // QAudio::State
+    QAtomicInt m_error;       // QAudio::Error
+    QAtomicInt m_processedms; // [ms] Duration already played by the device
+
+public slots:
+    void create();
+    void destroy();
+    void start();
+    void stop();
+    void suspend();
+    void resume();
+
+private slots:
+    void audioNotify();
+    void audioStateChanged(QAudio::State state);
+
+signals:
+    void notify();
+    void stateChanged(int state);
+};
+
 /**
  * This class interfaces with the QtMultimedia audio classes, and also with
  * the SpectrumAnalyser class.  Its role is to manage the capture and playback
@@ -75,7 +118,14 @@ class AudioEngine : public QObject
 
     int m_fs;           // The sampling frequency of the output
 
-    qint64 m_starttime;
+    // Audio clock for the play cursor, interpolated between the device's notifications
+    double m_clockorigin;   // [s] Played duration when the cursor was at m_start
+    int m_processedms;      // [ms] Last duration played by the device
+    qint64 m_processedtime; // [ms since epoch] When it has been reported
+    int m_playedseq;        // Version of the loop bounds taken by the mixer
+    void startClock();
+    void playedBounds(qint64& start, qint64& end);
+    double playedDuration() const;
     QTimer m_rtinfo_timer;
 
     QAudio::State       m_state;
@@ -83,9 +133,13 @@ class AudioEngine : public QObject
     QAudioFormat        m_format; // The format of the audio output
 
     QAudioDeviceInfo    m_audioOutputDevice;
-    QAudioOutput*       m_audioOutput;
+    QThread             m_audioThread;
+    AudioOutputWorker*  m_audioWorker;
+    bool                m_hasAudioOutput;
+    void callAudioWorker(const char* method);
 
     FTSound* m_ftsound; // The selected sound to play
+    SoundsMixer* m_mixer; // When playing multiple sounds at once
     double m_tobeplayed;
 
     void setState(QAudio::State state);
@@ -93,7 +147,7 @@ class AudioEngine : public QObject
 
 private slots:
     void audioNotify();
-    void audioStateChanged(QAudio::State state);
+    void audioStateChanged(int state);
     void readChannelFinished();
     void sendRealTimeInfo();
 
@@ -110,11 +164,17 @@ public:
     const QAudioFormat& format() const { return m_format; }
     QAudio::State state() const { return m_state; }
 
+    void startPlayback(const std::vector<FTSound*>& sounds, double tstart=0.0, double tstop=0.0, double headroom=0.0);
+    bool switchPlayback(FTSound* sound);
+    bool isLooping() const;
+    void setLoopSelection(double tstart, double tstop);
+
 public slots:
     void selectAudioOutputDevice(const QString& devicename);
     void setAudioOutputDevice(const QAudioDeviceInfo &device);
     void startPlayback(FTSound* sound, double tstart=0.0, double tstop=0.0, double fstart=0.0, double fstop=0.0);
     void stopPlayback();
+    void setLoop(bool loop);
     void reset();
 
 signals:
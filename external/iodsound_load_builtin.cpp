@@ -91,3 +91,8 @@ void FTSound::load(int channelid){
 
     delete pfile;
 }
+
+bool FTSound::loadAppended(const FTSound& loaded){
+    Q_UNUSED(loaded)
+    return false; // Not supported by this file reader, the full file will be reloaded
+}
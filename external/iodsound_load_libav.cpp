@@ -176,3 +176,8 @@ void Generator::generateData(const QAudioFormat &format, qint64 durationUs, int
     }
 }
 */
+
+bool FTSound::loadAppended(const FTSound& loaded){
+    Q_UNUSED(loaded)
+    return false; // Not supported by this file reader, the full file will be reloaded
+}
@@ -25,6 +25,8 @@ file provided in the source code of DFasma. Another copy can be found at
 #include "../src/ftsound.h"
 
 #include <iostream>
+#include <cmath>
+#include <algorithm>
 using namespace std;
 
 #include "qaehelpers.h"
@@ -121,7 +123,7 @@ void FTSound::load(int channelid){
     /* This is a buffer of double precision floating point values
     ** which will hold our data while we process it.
     */
-    static double data [BUFFER_LEN] ;
+    double data [BUFFER_LEN] ; // Not static, files can be loaded in parallel
 
     /* A SNDFILE is very much like a FILE in the Standard C library. The
     ** sf_open_read and sf_open_write functions return an SNDFILE* pointer
@@ -199,6 +201,17 @@ void FTSound::load(int channelid){
     channelid--; // Move indices [1,N] to [0,N-1] to avoid computing -1 to often
     int nbchan = sfinfo.channels;
     int curchannelid = 0;
+    // Avoid the over-allocation of the vector's growth, which can double the memory used
+    // It also fails early, before decoding, if the file cannot fit in memory
+    if(sfinfo.frames>0 && sfinfo.frames<SF_COUNT_MAX){
+        try{
+            wav.reserve(sfinfo.frames);
+        }
+        catch(std::bad_alloc err){
+            sf_close(infile);
+            throw QString("There is not enough free memory to hold this file (")+QString::number(double(sfinfo.frames)*sizeof(WAVTYPE)/std::pow(2.0,20.0), 'f', 0)+"MB needed).";
+        }
+    }
     while((readcount = sf_read_double (infile, data, BUFFER_LEN))) {
         for(int n=0; n<readcount; n++){
 
@@ -219,3 +232,86 @@ void FTSound::load(int channelid){
     /* Close input and output files. */
     sf_close(infile);
 }
+
+// Read count frames of the channel(s) used by FTSound::load, from the current position
+static sf_count_t readFrames(SNDFILE* infile, int nbchan, int channelid, sf_count_t count, std::vector<WAVTYPE>& out) {
+    bool sumchannels = channelid==-2;
+    channelid--; // Move indices [1,N] to [0,N-1]
+    double data[BUFFER_LEN];
+    sf_count_t framesperbuffer = BUFFER_LEN/nbchan;
+    sf_count_t totalread = 0;
+    while(totalread<count) {
+        sf_count_t readcount = sf_readf_double(infile, data, std::min(framesperbuffer, count-totalread));
+        if(readcount<=0)
+            break;
+        for(sf_count_t n=0; n<readcount; n++){
+            if(sumchannels){
+                double sum = 0.0;
+                for(int c=0; c<nbchan; c++)
+                    sum += data[n*nbchan+c];
+                out.push_back(sum/nbchan);
+            }
+            else
+                out.push_back(data[n*nbchan+channelid]);
+        }
+        totalread += readcount;
+    }
+    return totalread;
+}
+
+// Check that the samples at [start,start+count[ in the file are those already loaded
+// (compared block by block, so that the whole span can be checked)
+static bool hasSameFrames(SNDFILE* infile, int nbchan, int channelid, sf_count_t start, sf_count_t count, const std::vector<WAVTYPE>& wav) {
+    if(sf_seek(infile, start, SEEK_SET)!=start)
+        return false;
+    std::vector<WAVTYPE> frames;
+    frames.reserve(BUFFER_LEN);
+    for(sf_count_t blockstart=0; blockstart<count; blockstart+=BUFFER_LEN){
+        sf_count_t blocklen = std::min(sf_count_t(BUFFER_LEN), count-blockstart);
+        frames.clear();
+        if(readFrames(infile, nbchan, channelid, blocklen, frames)!=blocklen)
+            return false;
+        for(sf_count_t n=0; n<blocklen; n++)
+            if(frames[n]!=wav[start+blockstart+n])
+                return false;
+    }
+    return true;
+}
+
+bool FTSound::loadAppended(const FTSound& loaded){
+
+    // The loaded samples have to be exactly those of the file
+    if(loaded.wav.empty() || loaded.isResampled())
+        return false;
+
+    SNDFILE* infile;
+    SF_INFO sfinfo;
+    if(!(infile = sf_open(fileFullPath.toLocal8Bit().constData(), SFM_READ, &sfinfo)))
+        return false;
+
+    sf_count_t nbloaded = sf_count_t(loaded.wav.size());
+
+    // Same format and more samples ...
+    bool appended = sfinfo.samplerate==loaded.fs
+                    && sfinfo.channels==loaded.m_fileaudioformat.channelCount()
+                    && sfinfo.seekable
+                    && sfinfo.frames>nbloaded;
+
+    // ... and none of the previous samples changed
+    // (a rewritten file can keep the same beginning and end, e.g. silences)
+    appended = appended
+               && hasSameFrames(infile, sfinfo.channels, m_channelid, 0, nbloaded, loaded.wav);
+
+    // Only the new samples are decoded here, they are added to the loaded ones in the GUI thread
+    if(appended){
+        wav.clear();
+        wav.reserve(sfinfo.frames-nbloaded);
+        readFrames(infile, sfinfo.channels, m_channelid, sfinfo.frames-nbloaded, wav);
+        fs = loaded.fs;
+        m_fileaudioformat = loaded.m_fileaudioformat;
+    }
+
+    sf_close(infile);
+
+    return appended;
+}
@@ -25,6 +25,7 @@ file provided in the source code of DFasma. Another copy can be found at
 #include "../src/ftsound.h"
 
 #include <iostream>
+#include <cmath>
 using namespace std;
 
 extern "C" {
@@ -121,6 +122,19 @@ void FTSound::load(int channelid){
     channelid--; // Move indices [1,N] to [0,N-1] to avoid computing -1 to often
     int nbchan = in->signal.channels;
     int curchannelid = 0;
+    // Avoid the over-allocation of the vector's growth, which can double the memory used
+    // It also fails early, before decoding, if the file cannot fit in memory
+    if(in->signal.length>0 && in->signal.length!=SOX_UNKNOWN_LEN){
+        try{
+            wav.reserve(in->signal.length/nbchan);
+        }
+        catch(std::bad_alloc err){
+            double neededmb = double(in->signal.length/nbchan)*sizeof(WAVTYPE)/std::pow(2.0,20.0); // Before closing the file
+            delete[] (char*)buf;
+            sox_close(in);
+            throw QString("There is not enough free memory to hold this file (")+QString::number(neededmb, 'f', 0)+"MB needed).";
+        }
+    }
     while((readcount=sox_read(in, buf, BUFFER_LEN))) {
 
         for(size_t i = 0; i < readcount; ++i) {
@@ -147,3 +161,8 @@ void FTSound::load(int channelid){
     free(buf);
     sox_close(in);
 }
+
+bool FTSound::loadAppended(const FTSound& loaded){
+    Q_UNUSED(loaded)
+    return false; // Not supported by this file reader, the full file will be reloaded
+}
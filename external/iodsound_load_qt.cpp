@@ -233,3 +233,8 @@ void FTSound::load(int channelid){
 
 //    delete decoder; // TODO should be done somewhere
 }
+
+bool FTSound::loadAppended(const FTSound& loaded){
+    Q_UNUSED(loaded)
+    return false; // Not supported by this file reader, the full file will be reloaded
+}
@@ -0,0 +1,215 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#include "binaryarrayreader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QSettings>
+#include <QRegExp>
+#include <QStringList>
+#include <QSysInfo>
+#include <qendian.h>
+
+static const bool s_machineisbig = (QSysInfo::ByteOrder==QSysInfo::BigEndian);
+
+BinaryArrayReader::BinaryArrayReader(const QString& filepath)
+    : m_file(filepath)
+    , m_mapping(NULL)
+    , m_array(NULL)
+    , m_itemsize(4)
+    , m_swap(false)
+    , m_fortranorder(false)
+    , m_nbrows(0)
+    , m_nbcolumns(1)
+    , m_timestep(0.0)
+    , m_timestart(0.0)
+{
+    if(!m_file.open(QIODevice::ReadOnly))
+        throw QString("BinaryArrayReader: Cannot open the file.");
+
+    bool isnpy = isFileNPY(filepath);
+    qint64 offset = 0;
+    if(isnpy)
+        parseNPYHeader(offset);
+    if(QFile::exists(sidecarHeaderPath(filepath)))
+        parseSidecarHeader(!isnpy, offset);
+    else if(!isnpy)
+        throw QString("BinaryArrayReader: The header of this raw file is missing: ")+sidecarHeaderPath(filepath);
+
+    if(offset<0 || offset>m_file.size())
+        throw QString("BinaryArrayReader: The offset of the array is outside of the file.");
+
+    // Compare in rows, so that the size of a huge shape is never computed
+    qint64 available = (m_file.size()-offset)/(qint64(m_itemsize)*m_nbcolumns);
+    if(isnpy){
+        if(m_nbrows>available)
+            throw QString("BinaryArrayReader: This NumPy file is truncated.");
+    }
+    else
+        m_nbrows = available;
+
+    if(m_nbrows>0){
+        m_mapping = m_file.map(0, m_file.size());
+        if(m_mapping==NULL)
+            throw QString("BinaryArrayReader: Cannot map the file in memory.");
+        m_array = m_mapping+offset;
+    }
+}
+
+BinaryArrayReader::~BinaryArrayReader() {
+    if(m_mapping)
+        m_file.unmap((uchar*)m_mapping);
+}
+
+bool BinaryArrayReader::isFileNPY(const QString& filepath) {
+    QFile file(filepath);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+    return file.read(6)==QByteArray("\x93NUMPY");
+}
+
+bool BinaryArrayReader::isFileBinary(const QString& filepath) {
+    return isFileNPY(filepath) || QFile::exists(sidecarHeaderPath(filepath));
+}
+
+// See https://numpy.org/doc/stable/reference/generated/numpy.lib.format.html
+void BinaryArrayReader::parseNPYHeader(qint64& offset) {
+    QByteArray preamble = m_file.read(10);
+    if(preamble.size()<10)
+        throw QString("BinaryArrayReader: This NumPy file is truncated.");
+
+    qint64 headerlen;
+    if(uchar(preamble[6])==1){
+        headerlen = qFromLittleEndian<quint16>((const uchar*)preamble.constData()+8);
+        offset = 10+headerlen;
+    }
+    else{
+        preamble += m_file.read(2);
+        if(preamble.size()<12)
+            throw QString("BinaryArrayReader: This NumPy file is truncated.");
+        headerlen = qFromLittleEndian<quint32>((const uchar*)preamble.constData()+8);
+        offset = 12+headerlen;
+    }
+    QString header = QString::fromLatin1(m_file.read(headerlen));
+
+    QRegExp rxdescr("'descr'\\s*:\\s*'([<>|=])f([48])'");
+    if(rxdescr.indexIn(header)==-1)
+        throw QString("BinaryArrayReader: Only float32 and float64 NumPy arrays are supported.");
+    bool fileisbig = (rxdescr.cap(1)==">") || (rxdescr.cap(1)=="=" && s_machineisbig);
+    m_swap = (fileisbig!=s_machineisbig);
+    m_itemsize = rxdescr.cap(2).toInt();
+
+    m_fortranorder = QRegExp("'fortran_order'\\s*:\\s*True").indexIn(header)!=-1;
+
+    QRegExp rxshape("'shape'\\s*:\\s*\\(([^)]*)\\)");
+    if(rxshape.indexIn(header)==-1)
+        throw QString("BinaryArrayReader: Cannot find the shape of this NumPy array.");
+    QStringList dims = rxshape.cap(1).split(',', QString::SkipEmptyParts);
+    if(dims.size()<1 || dims.size()>2)
+        throw QString("BinaryArrayReader: Only 1D and 2D NumPy arrays are supported.");
+    bool okrows = true, okcolumns = true;
+    m_nbrows = dims[0].trimmed().toLongLong(&okrows);
+    m_nbcolumns = (dims.size()==2)?dims[1].trimmed().toInt(&okcolumns):1;
+    if(!okrows || !okcolumns || m_nbrows<0)
+        throw QString("BinaryArrayReader: The shape of this NumPy array is invalid.");
+    if(m_nbcolumns<1)
+        throw QString("BinaryArrayReader: This NumPy array has no column.");
+}
+
+void BinaryArrayReader::parseSidecarHeader(bool israw, qint64& offset) {
+    QSettings header(sidecarHeaderPath(m_file.fileName()), QSettings::IniFormat);
+
+    if(israw){
+        QString type = header.value("type", "float32").toString();
+        if(type=="float32")
+            m_itemsize = 4;
+        else if(type=="float64")
+            m_itemsize = 8;
+        else
+            throw QString("BinaryArrayReader: Unsupported type in the header: ")+type;
+
+        QString byteorder = header.value("byteorder", "little").toString();
+        if(byteorder!="little" && byteorder!="big")
+            throw QString("BinaryArrayReader: Unsupported byte order in the header: ")+byteorder;
+        m_swap = ((byteorder=="big")!=s_machineisbig);
+
+        m_nbcolumns = header.value("columns", 1).toInt();
+        if(m_nbcolumns<1)
+            throw QString("BinaryArrayReader: The number of columns in the header has to be positive.");
+        bool ok = true;
+        offset = header.value("offset", 0).toLongLong(&ok);
+        if(!ok)
+            throw QString("BinaryArrayReader: The offset in the header has to be a number of bytes.");
+    }
+
+    m_timestep = header.value("timestep", 0.0).toDouble();
+    m_timestart = header.value("timestart", 0.0).toDouble();
+}
+
+void BinaryArrayReader::readTimes(std::vector<double>& ts, double defaultstep) const {
+    if(hasTimeColumn()){
+        readValues(0, ts);
+        return;
+    }
+
+    double step = (m_timestep>0.0)?m_timestep:defaultstep;
+    ts.resize(m_nbrows);
+    for(qint64 n=0; n<m_nbrows; ++n)
+        ts[n] = m_timestart+n*step;
+}
+
+void BinaryArrayReader::readValues(int column, std::vector<double>& values) const {
+    if(column==-1)
+        column = hasTimeColumn()?1:0;
+    if(column<0 || column>=m_nbcolumns)
+        throw QString("BinaryArrayReader: There is no column ")+QString::number(column+1)+" in this file.";
+
+    values.resize(m_nbrows);
+    if(m_nbrows==0)
+        return;
+
+    qint64 stride = (m_fortranorder?1:m_nbcolumns)*qint64(m_itemsize);
+    const uchar* p = m_array+(m_fortranorder?column*m_nbrows:qint64(column))*m_itemsize;
+    if(m_itemsize==4){
+        for(qint64 n=0; n<m_nbrows; ++n, p+=stride){
+            quint32 u;
+            memcpy(&u, p, 4); // The mapping might not be aligned
+            if(m_swap)
+                u = qbswap(u);
+            float value;
+            memcpy(&value, &u, 4);
+            values[n] = value;
+        }
+    }
+    else{
+        for(qint64 n=0; n<m_nbrows; ++n, p+=stride){
+            quint64 u;
+            memcpy(&u, p, 8);
+            if(m_swap)
+                u = qbswap(u);
+            double value;
+            memcpy(&value, &u, 8);
+            values[n] = value;
+        }
+    }
+}
@@ -0,0 +1,79 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BINARYARRAYREADER_H
+#define BINARYARRAYREADER_H
+
+#include <vector>
+#include <QFile>
+#include <QString>
+
+// Reader of binary arrays of float32 or float64 values, one row per frame,
+// either NumPy files (.npy) or raw files described by a sidecar header.
+// The file is memory-mapped and the columns are converted straight from the mapping.
+//
+// The sidecar header is the file path followed by ".hdr", in INI format:
+//  type=float32      (or float64)
+//  byteorder=little  (or big)
+//  columns=1         (raw files only)
+//  offset=0          [bytes] Before the array (raw files only)
+//  timestep=0.005    [s] Optional, for uniformly sampled values (no time column)
+//  timestart=0.0     [s] Optional, time of the first frame
+// NumPy files can also have a sidecar header, for the time step and start.
+// Without time step, the first column is the time, unless there is a single column.
+class BinaryArrayReader
+{
+    QFile m_file;
+    const uchar* m_mapping;
+    const uchar* m_array;
+    int m_itemsize;      // [bytes] 4 or 8
+    bool m_swap;         // If the byte order differs from the machine's
+    bool m_fortranorder; // Column-major
+    qint64 m_nbrows;
+    int m_nbcolumns;
+    double m_timestep;   // [s] 0 if the first column is the time
+    double m_timestart;  // [s]
+
+    void parseNPYHeader(qint64& offset);
+    void parseSidecarHeader(bool israw, qint64& offset);
+
+public:
+    BinaryArrayReader(const QString& filepath);
+    ~BinaryArrayReader();
+
+    static bool isFileNPY(const QString& filepath);
+    static QString sidecarHeaderPath(const QString& filepath) {return filepath+".hdr";}
+    static bool isFileBinary(const QString& filepath);
+
+    qint64 getNbRows() const {return m_nbrows;}
+    int getNbColumns() const {return m_nbcolumns;}
+    bool hasTimeColumn() const {return m_timestep<=0.0 && m_nbcolumns>1;}
+    double getTimeStep() const {return m_timestep;}   // [s] 0 if not given by the header
+    double getTimeStart() const {return m_timestart;} // [s]
+
+    // The times of the frames, from the time column or the time step
+    // (defaultstep is used if there is neither).
+    void readTimes(std::vector<double>& ts, double defaultstep) const;
+    // The values of a column (-1 for the default one: the first column after the time, if any)
+    void readValues(int column, std::vector<double>& values) const;
+};
+
+#endif // BINARYARRAYREADER_H
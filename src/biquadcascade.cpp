@@ -0,0 +1,137 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#include "biquadcascade.h"
+
+#include <algorithm>
+
+#define BIQUADCASCADE_BLOCKLEN 2048 // [samples] Fits in the L1 cache
+
+void BiquadCascade::addSections(const std::vector< std::vector<double> >& num, const std::vector< std::vector<double> >& den) {
+    for(size_t bi=0; bi<num.size() && bi<den.size(); bi++){
+        double a0 = den[bi][0];
+        m_coefs.push_back(num[bi][0]/a0);
+        m_coefs.push_back((num[bi].size()>1)?num[bi][1]/a0:0.0);
+        m_coefs.push_back((num[bi].size()>2)?num[bi][2]/a0:0.0);
+        m_coefs.push_back((den[bi].size()>1)?den[bi][1]/a0:0.0);
+        m_coefs.push_back((den[bi].size()>2)?den[bi][2]/a0:0.0);
+    }
+}
+
+// Run all the sections on one block (transposed direct form II)
+void BiquadCascade::filterBlock(WAVTYPE* x, size_t len, std::vector<double>& states, bool backward) const {
+    for(size_t si=0; si<nbSections(); si++){
+        const double* c = &(m_coefs[5*si]);
+        const double b0=c[0], b1=c[1], b2=c[2], a1=c[3], a2=c[4];
+        double z1 = states[2*si];
+        double z2 = states[2*si+1];
+        if(backward){
+            for(size_t n=len; n>0; n--){
+                double in = x[n-1];
+                double out = b0*in + z1;
+                z1 = b1*in - a1*out + z2;
+                z2 = b2*in - a2*out;
+                x[n-1] = WAVTYPE(out);
+            }
+        }
+        else{
+            for(size_t n=0; n<len; n++){
+                double in = x[n];
+                double out = b0*in + z1;
+                z1 = b1*in - a1*out + z2;
+                z2 = b2*in - a2*out;
+                x[n] = WAVTYPE(out);
+            }
+        }
+        states[2*si] = z1;
+        states[2*si+1] = z2;
+    }
+}
+
+// Run all the sections on x, block by block
+void BiquadCascade::filter(WAVTYPE* x, size_t len, std::vector<double>& states, bool backward) const {
+    if(backward){
+        for(size_t end=len; end>0; ){
+            size_t blocklen = std::min(size_t(BIQUADCASCADE_BLOCKLEN), end);
+            filterBlock(x+end-blocklen, blocklen, states, true);
+            end -= blocklen;
+        }
+    }
+    else{
+        for(size_t start=0; start<len; start+=BIQUADCASCADE_BLOCKLEN)
+            filterBlock(x+start, std::min(size_t(BIQUADCASCADE_BLOCKLEN), len-start), states, false);
+    }
+}
+
+// States of the cascade after a constant input of the given value (as scipy.signal.sosfilt_zi)
+void BiquadCascade::steadyStates(double value, std::vector<double>& states) const {
+    states.resize(2*nbSections());
+    for(size_t si=0; si<nbSections(); si++){
+        const double* c = &(m_coefs[5*si]);
+        double den = 1.0+c[3]+c[4];
+        double gain = (den!=0.0)?(c[0]+c[1]+c[2])/den:0.0;
+        states[2*si] = value*(gain-c[0]);
+        states[2*si+1] = value*(c[2]-c[4]*gain);
+        value *= gain; // Input of the next section
+    }
+}
+
+// Length of the odd extension at each end (as scipy.signal.sosfiltfilt)
+size_t BiquadCascade::padLength() const {
+    size_t nbzerob2 = 0;
+    size_t nbzeroa2 = 0;
+    for(size_t si=0; si<nbSections(); si++){
+        if(m_coefs[5*si+2]==0.0) nbzerob2++;
+        if(m_coefs[5*si+4]==0.0) nbzeroa2++;
+    }
+    return 3*(2*nbSections()+1-std::min(nbzerob2, nbzeroa2));
+}
+
+void BiquadCascade::filtfilt(WAVTYPE* x, size_t len) const {
+    if(len==0 || nbSections()==0)
+        return;
+
+    // Odd extensions at both ends: 2*x[0]-x[padlen..1] and 2*x[len-1]-x[len-2..len-1-padlen]
+    size_t padlen = std::min(padLength(), len-1);
+    std::vector<WAVTYPE> head(padlen), tail(padlen);
+    for(size_t n=0; n<padlen; n++){
+        head[n] = 2*x[0] - x[padlen-n];
+        tail[n] = 2*x[len-1] - x[len-2-n];
+    }
+
+    std::vector<double> states;
+
+    // Forward, starting from the steady state of the first extended sample
+    steadyStates(padlen>0?head[0]:x[0], states);
+    filter(head.data(), padlen, states, false);
+    filter(x, len, states, false);
+    filter(tail.data(), padlen, states, false);
+
+    // Backward, starting from the steady state of the last filtered sample
+    steadyStates(padlen>0?tail[padlen-1]:x[len-1], states);
+    filter(tail.data(), padlen, states, true);
+    filter(x, len, states, true);
+}
+
+void BiquadCascade::filtfilt(std::vector<WAVTYPE>& x) const {
+    if(!x.empty())
+        filtfilt(&(x[0]), x.size());
+}
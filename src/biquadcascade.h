@@ -0,0 +1,62 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BIQUADCASCADE_H
+#define BIQUADCASCADE_H
+
+#include <vector>
+#include <cstddef>
+
+#ifdef SIGPROC_FLOAT
+#define WAVTYPE float
+#else
+#define WAVTYPE double
+#endif
+
+// Zero-phase filtering through a cascade of biquad sections.
+// All the sections are run on one block of samples before moving to the next
+// block, so that the signal goes only once through the memory per direction,
+// instead of twice per section with one filtfilt call per section.
+// As with scipy.signal.sosfiltfilt, the signal is extended at both ends by odd
+// reflection and the states start from the steady state of the cascade, so
+// that the edges don't ring.
+class BiquadCascade
+{
+    std::vector<double> m_coefs; // 5 coefficients per section: b0 b1 b2 a1 a2 (normalized by a0)
+
+    void filterBlock(WAVTYPE* x, size_t len, std::vector<double>& states, bool backward) const;
+    void filter(WAVTYPE* x, size_t len, std::vector<double>& states, bool backward) const;
+    void steadyStates(double value, std::vector<double>& states) const;
+    size_t padLength() const;
+
+public:
+    BiquadCascade() {}
+
+    // Append the sections, as given by mkfilter::make_butterworth_filter_biquad
+    void addSections(const std::vector< std::vector<double> >& num, const std::vector< std::vector<double> >& den);
+    size_t nbSections() const {return m_coefs.size()/5;}
+
+    // Filter x[0..len-1] forward then backward, in place
+    void filtfilt(WAVTYPE* x, size_t len) const;
+    void filtfilt(std::vector<WAVTYPE>& x) const;
+};
+
+#endif // BIQUADCASCADE_H
@@ -33,6 +33,7 @@ using namespace std;
 #include "wmainwindow.h"
 #include "ui_wmainwindow.h"
 #include "gvspectrumamplitude.h"
+#include "binaryarrayreader.h"
 
 #ifdef SUPPORT_SDIF
 #include <easdif/easdif.h>
@@ -51,7 +52,7 @@ FileType::ClassConstructor::ClassConstructor(){
     if(FileType::s_types_name_and_extensions.empty()){
         FileType::s_types_name_and_extensions.push_back("All files (*)");
         FileType::s_types_name_and_extensions.push_back("Sound (*.wav *.aiff *.pcm *.snd *.flac *.ogg)");
-        FileType::s_types_name_and_extensions.push_back("F0 (*.f0.txt *.bpf *.sdif)");
+        FileType::s_types_name_and_extensions.push_back("F0 (*.f0.txt *.bpf *.sdif *.npy)");
         FileType::s_types_name_and_extensions.push_back("Label (*.lab *.sdif)");
         FileType::s_types_name_and_extensions.push_back("Generic Time/Value (*.*)");
     }
@@ -115,6 +116,8 @@ FileType::FileContainer FileType::guessContainer(const QString& filepath){
     int nchan = FTSound::getNumberOfChannels(filepath);
     if(nchan>0)
         return FCANYSOUND;
+    else if(BinaryArrayReader::isFileBinary(filepath))
+        return FCBINARY;
     #ifdef SUPPORT_SDIF
     else if(FileType::isFileSDIF(filepath))
         return FCSDIF;
@@ -290,6 +293,8 @@ void FileType::constructor_internal(){
 
 void FileType::constructor_external(){
     gFL->m_present_files.insert(make_pair(this,true));
+    if(!m_is_distant)
+        gFL->watchFile(fileFullPath);
 }
 
 FileType::FileType(FType _type, const QString& _fileName, QObject *parent, const QColor& _color)
@@ -309,6 +314,10 @@ FileType::FileType(FType _type, const QString& _fileName, QObject *parent, const
 //    QIODevice::open(QIODevice::ReadOnly);
 }
 void FileType::setFullPath(const QString& fp){
+    bool iswatched = !m_is_distant && gFL->m_present_files.find(this)!=gFL->m_present_files.end();
+    if(iswatched)
+        gFL->unwatchFile(fileFullPath);
+
     fileFullPath = fp;
     // Set properties common to all files
     QFileInfo fileInfo(fileFullPath);
@@ -316,6 +325,9 @@ void FileType::setFullPath(const QString& fp){
     setText(visibleName);
     setToolTip(fileInfo.absoluteFilePath());
     m_is_distant = fp.contains("/run/") && fp.contains("/gvfs/");
+
+    if(iswatched && !m_is_distant)
+        gFL->watchFile(fileFullPath);
 }
 
 QString FileType::info() const {
@@ -474,6 +486,8 @@ FileType::~FileType() {
     if(gFL->m_prevSelectedFile==this)
         gFL->m_prevSelectedFile = NULL;
 
+    if(!m_is_distant && gFL->m_present_files.find(this)!=gFL->m_present_files.end())
+        gFL->unwatchFile(fileFullPath);
     gFL->m_present_files.erase(this);
 
     s_colors.push_front(m_color);
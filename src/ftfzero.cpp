@@ -23,6 +23,7 @@ file provided in the source code of DFasma. Another copy can be found at
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <limits>
 using namespace std;
 
 #ifdef SUPPORT_SDIF
@@ -36,6 +37,10 @@ using namespace Easdif;
 #include <QDir>
 #include <QFileDialog>
 #include <QStatusBar>
+#include <QThread>
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QDataStream>
 #include <qmath.h>
 #include <qendian.h>
 
@@ -45,6 +50,8 @@ using namespace Easdif;
 #include "gvwaveform.h"
 #include "gvspectrumamplitude.h"
 #include "gvspectrogram.h"
+#include "textcolumnsreader.h"
+#include "binaryarrayreader.h"
 
 #include "qaegisampledsignal.h"
 #include "qaehelpers.h"
@@ -62,6 +69,10 @@ FTFZero::ClassConstructor::ClassConstructor(){
         FTFZero::s_formatstrings.push_back("Text - Time Value (*.f0.txt)");
         FTFZero::s_formatstrings.push_back("Text - Value (single column) (*.f0.txt)");
         FTFZero::s_formatstrings.push_back("SDIF - 1FQ0/1FQ0 (*.sdif)");
+        FTFZero::s_formatstrings.push_back("EST");
+        FTFZero::s_formatstrings.push_back("Binary - Auto");
+        FTFZero::s_formatstrings.push_back("Binary - NumPy (*.npy)");
+        FTFZero::s_formatstrings.push_back("Binary - Raw with header (*.hdr)");
     }
 }
 FTFZero::ClassConstructor FTFZero::s_class_constructor;
@@ -84,6 +95,8 @@ void FTFZero::constructor_internal(){
     m_src_snd = NULL;
     m_giF0ForSpectrogram = NULL;
     m_giHarmonicForSpectrogram = NULL;
+    m_estimationthread = NULL;
+    m_estimationpartial = false;
 
     connect(m_actionShow, SIGNAL(toggled(bool)), this, SLOT(setVisible(bool)));
 
@@ -101,6 +114,9 @@ void FTFZero::constructor_internal(){
     m_actionSetSource = new QAction("Set corresponding waveform...", this);
     m_actionSetSource->setStatusTip(tr("Set the waveform this F0 should correspond to."));
     connect(m_actionSetSource, SIGNAL(triggered()), gFL, SLOT(setSource()));
+    m_actionCancelEstimation = new QAction("Cancel the F0 estimation", this);
+    m_actionCancelEstimation->setStatusTip(tr("Stop the running F0 estimation and keep the values already tracked."));
+    connect(m_actionCancelEstimation, SIGNAL(triggered()), this, SLOT(cancelEstimation()));
 }
 
 void FTFZero::constructor_external(){
@@ -168,6 +184,8 @@ FTFZero::FTFZero(const QString& _fileName, QObject* parent, FileType::FileContai
         m_fileformat = FFSDIF;
     else if(container==FileType::FCASCII)
         m_fileformat = FFAsciiAutoDetect;
+    else if(container==FileType::FCBINARY)
+        m_fileformat = FFBinaryAutoDetect;
 
     if(!fileFullPath.isEmpty()){
         checkFileStatus(CFSMEXCEPTION);
@@ -211,6 +229,15 @@ void FTFZero::load() {
             m_fileformat = FFEST;
     }
     #endif
+    if(m_fileformat==FFAutoDetect)
+        if(BinaryArrayReader::isFileBinary(fileFullPath))
+            m_fileformat = FFBinaryAutoDetect;
+    if(m_fileformat==FFBinaryAutoDetect){
+        if(BinaryArrayReader::isFileNPY(fileFullPath))
+            m_fileformat = FFBinaryNPY;
+        else
+            m_fileformat = FFBinaryRaw;
+    }
 
     // Check for text/ascii formats
     if(m_fileformat==FFAutoDetect || m_fileformat==FFAsciiAutoDetect){
@@ -243,54 +270,43 @@ void FTFZero::load() {
 
     // Load the data given the format found or the one given
     if(m_fileformat==FFAsciiTimeValue){
-        ifstream fin(fileFullPath.toLatin1().constData());
-        if(!fin.is_open())
-            throw QString("FTFZero:FFAsciiTimeValue: Cannot open file");
-
-        double t, value;
-        string line;
-        while(std::getline(fin, line)) {
-            std::istringstream(line) >> t >> value;
-            ts.push_back(t);
-            f0s.push_back(value);
-        }
+        TextColumnsReader reader(fileFullPath);
+        std::vector<int> columns(2, 0);
+        columns[1] = 1;
+        std::vector< std::vector<double> > data;
+        reader.read(columns, data);
+        ts.swap(data[0]);
+        f0s.swap(data[1]);
     }
     else if(m_fileformat==FFAsciiValue){
-        ifstream fin(fileFullPath.toLatin1().constData());
-        if(!fin.is_open())
-            throw QString("FTFZero:FFAsciiValue: Cannot open file");
-
-        double t=0.0;
-        double value;
-        string line;
-        while(std::getline(fin, line)) {
-            std::istringstream(line) >> value;
-            ts.push_back(t);
-            f0s.push_back(value);
-            t += gMW->m_dlgSettings->ui->sbF0DefaultStepSize->value();
-        }
+        TextColumnsReader reader(fileFullPath);
+        std::vector< std::vector<double> > data;
+        reader.read(std::vector<int>(1, 0), data);
+        f0s.swap(data[0]);
+        double step = gMW->m_dlgSettings->ui->sbF0DefaultStepSize->value();
+        ts.resize(f0s.size());
+        for(size_t n=0; n<ts.size(); ++n)
+            ts[n] = n*step;
     }
     else if(m_fileformat==FFEST){
-        ifstream fin(fileFullPath.toLatin1().constData());
-        if(!fin.is_open())
-            throw QString("FTFZero:FFEST: Cannot open file");
-
-        double t = 0.0;
-        double voiced = false;
-        double value;
-        string line;
-        bool skippingheader = true;
-        while(skippingheader && std::getline(fin, line)) {
-            if(line.find("EST_Header_End")==0)
-                skippingheader = false;
-        }
-        while(std::getline(fin, line)) {
-            std::istringstream(line) >> t >> voiced >> value;
-            ts.push_back(t);
-            if(!voiced || value<0.0)
-                value = 0.0;
-            f0s.push_back(value);
-        }
+        TextColumnsReader reader(fileFullPath);
+        reader.skipHeader("EST_Header_End");
+        std::vector<int> columns(3, 0); // <time> <voicing> <f0>
+        columns[1] = 1;
+        columns[2] = 2;
+        std::vector< std::vector<double> > data;
+        reader.read(columns, data);
+        ts.swap(data[0]);
+        f0s.swap(data[2]);
+        for(size_t n=0; n<f0s.size(); ++n)
+            if(data[1][n]==0.0 || f0s[n]<0.0)
+                f0s[n] = 0.0;
+    }
+    else if(m_fileformat==FFBinaryNPY || m_fileformat==FFBinaryRaw){
+        // Converted straight from the memory mapping
+        BinaryArrayReader reader(fileFullPath);
+        reader.readTimes(ts, gMW->m_dlgSettings->ui->sbF0DefaultStepSize->value());
+        reader.readValues(-1, f0s);
     }
     else if(m_fileformat==FFSDIF){
         #ifdef SUPPORT_SDIF
@@ -430,7 +446,8 @@ void FTFZero::saveAs() {
                 m_fileformat = FFSDIF;
             #endif
 
-            if(m_fileformat==FFNotSpecified || m_fileformat==FFAutoDetect)
+            if(m_fileformat==FFNotSpecified || m_fileformat==FFAutoDetect
+               || m_fileformat==FFBinaryNPY || m_fileformat==FFBinaryRaw)
                 m_fileformat = FFAsciiTimeValue;
 
             save();
@@ -447,6 +464,12 @@ void FTFZero::save() {
         return;
     }
 
+    if(m_fileformat==FFBinaryNPY || m_fileformat==FFBinaryRaw){
+        // The binary files are read only, save in another file
+        saveAs();
+        return;
+    }
+
     if(m_fileformat==FFNotSpecified || m_fileformat==FFAutoDetect)
         m_fileformat = FFAsciiTimeValue;
 
@@ -585,6 +608,8 @@ void FTFZero::fillContextMenu(QMenu& contextmenu) {
     contextmenu.addAction(m_actionSaveAs);
     contextmenu.addSeparator();
     contextmenu.addAction(gMW->ui->actionEstimationF0);
+    if(m_estimationthread)
+        contextmenu.addAction(m_actionCancelEstimation);
     contextmenu.addAction(gMW->ui->actionEstimationVoicedUnvoicedMarkers);
     contextmenu.addAction(m_actionSetSource);
 }
@@ -736,6 +761,8 @@ void FTFZero::edit(double t, double f0){
 }
 
 FTFZero::~FTFZero() {
+    stopEstimation();
+
     delete m_giF0ForSpectrogram;
     delete m_giHarmonicForSpectrogram;
     delete m_aspec_txt;
@@ -745,6 +772,7 @@ FTFZero::~FTFZero() {
     delete m_actionSave;
     delete m_actionSaveAs;
     delete m_actionSetSource;
+    delete m_actionCancelEstimation;
 }
 
 // Drawing ---------------------------------------------------------------------
@@ -797,8 +825,6 @@ void FTFZero::draw_freq_amp(QPainter* painter, const QRectF& rect){
 
 // Analysis --------------------------------------------------------------------
 
-#include "../external/REAPER/epoch_tracker/epoch_tracker.h"
-
 FTFZero::FTFZero(QObject *parent, FTSound *ftsnd, double f0min, double f0max, double tstart, double tend, bool force)
     : QObject(parent)
     , FileType(FTFZERO, createFileNameFromSound(ftsnd->fileFullPath), this, ftsnd->getColor())
@@ -816,6 +842,25 @@ FTFZero::FTFZero(QObject *parent, FTSound *ftsnd, double f0min, double f0max, do
     FTFZero::constructor_external();
 }
 
+// Create the F0 of a sound from an estimation computed beforehand (e.g. by a worker)
+FTFZero::FTFZero(QObject *parent, FTSound *ftsnd, const Estimation& est)
+    : QObject(parent)
+    , FileType(FTFZERO, createFileNameFromSound(ftsnd->fileFullPath), this, ftsnd->getColor())
+{
+    FTFZero::constructor_internal();
+
+    if(gMW->m_dlgSettings->ui->cbF0DefaultFormat->currentIndex()+FFAsciiTimeValue==FFSDIF)
+        m_fileformat = FFSDIF;
+    else if(gMW->m_dlgSettings->ui->cbF0DefaultFormat->currentIndex()+FFAsciiTimeValue==FFAsciiAutoDetect
+            || gMW->m_dlgSettings->ui->cbF0DefaultFormat->currentIndex()+FFAsciiTimeValue==FFAsciiTimeValue)
+        m_fileformat = FFAsciiTimeValue;
+
+    m_src_snd = ftsnd;
+    applyEstimation(est);
+
+    FTFZero::constructor_external();
+}
+
 void FTFZero::estimate(FTSound *ftsnd, double f0min, double f0max, double tstart, double tend, bool force) {
 
     if(ftsnd)
@@ -826,97 +871,392 @@ void FTFZero::estimate(FTSound *ftsnd, double f0min, double f0max, double tstart
         return;
     }
 
-    double fs = gFL->getFs();
+    // Restart from scratch if an estimation is already running
+    stopEstimation();
 
-    f0min = std::max(f0min, gMW->m_dlgSettings->ui->dsbEstimationF0Min->minimum()); // Fix hard-coded minimum for f0
-    f0max = std::min(f0max, fs/2.0); // Fix hard-coded minimum for f0
-    if(tstart!=-1)
-        tstart = std::max(tstart, 0.0);
-    if(tend!=-1)
-        tend = std::min(tend, m_src_snd->getLastSampleTime());
+    Estimation est;
+    prepareEstimation(m_src_snd, f0min, f0max, tstart, tend, force, est);
 
-//    COUTD << "FTFZero::estimate src=" << m_src_snd->visibleName << " [" << f0min << "," << f0max << "]Hz [" << tstart << "," << tend << "]s " << force << endl;
+    if(est.fs<6000.0)
+        QMessageBox::warning(gMW, "Problem during estimation of F0", "Sampling rate is smaller than 6kHz, which may create substantial estimation errors.");
 
-//    if(_fileName==""){
-////        if(gMW->m_dlgSettings->ui->cbLabelsDefaultFormat->currentIndex()+FFTEXTTimeText==FFSDIF)
-////            setFullPath(QDir::currentPath()+QDir::separator()+"unnamed.sdif");
-////        m_fileformat = FFSDIF;
-////        else
-//        setFullPath(QDir::currentPath()+QDir::separator()+"unnamed.txt");
-//        m_fileformat = FFAsciiTimeValue;
-//    }
+    // If the whole file is estimated, the segments are shown as soon as they are tracked.
+    // Prepare the time grid, so that they can be filled in independently.
+    m_estimationpartial = (est.tstart==-1 && est.tend==-1);
+    if(m_estimationpartial){
+        size_t nbframes = size_t(est.data.size()/(est.timestepsize*est.fs))+1;
+        ts.resize(nbframes);
+        for (size_t i=0; i<ts.size(); ++i)
+            ts[i] = est.tiskipfirst + i*est.timestepsize;
+        f0s.assign(nbframes, 0.0);
+        if(m_giF0ForSpectrogram)
+            m_giF0ForSpectrogram->updateGeometry();
+    }
 
-    // Compute the f0 from the given sound file
-    QString msg = "Estimating F0 of "+fileFullPath+" in ["+QString::number(f0min)+","+QString::number(f0max)+"]Hz ";
+    // Compute the f0 from the given sound file, in the background
+    m_estimationthread = new FTFZeroEstimationThread(this, est);
+    connect(m_estimationthread, SIGNAL(segmentTracked()), this, SLOT(estimationSegmentTracked()));
+    connect(m_estimationthread, SIGNAL(finished()), this, SLOT(estimationFinished()));
+    m_estimationthread->start(QThread::LowPriority);
+
+    QString msg = "Estimating F0 of "+fileFullPath+" in ["+QString::number(est.f0min)+","+QString::number(est.f0max)+"]Hz";
     if(force)
-        msg += " without voiced/unvoiced decision ";
-    gMW->globalWaitingBarMessage(msg+"...", 8);
+        msg += " without voiced/unvoiced decision";
+    gMW->statusBar()->showMessage(msg+"...");
+    setStatus();
+}
 
-    double timestepsize = gMW->m_dlgSettings->ui->sbEstimationStepSize->value();
+// Cancel and wait for the running estimation, without using its results
+void FTFZero::stopEstimation() {
+    if(m_estimationthread==NULL)
+        return;
 
-    EpochTracker et; // TODO to put in FTSound because other features can be extracted from it (ex. GCIs, voicing)
-    et.set_external_frame_interval(timestepsize);
-    et.set_unvoiced_pulse_interval(timestepsize);
-    if(force) et.set_unvoiced_cost(100); // Set arbitray huge cost for avoiding unvoiced segments
+    m_estimationthread->disconnect(this);
+    m_estimationthread->m_canceled.store(1);
+    m_estimationthread->wait();
+    delete m_estimationthread;
+    m_estimationthread = NULL;
+}
+
+// Ask the running estimation to stop as soon as possible.
+// The values already tracked are kept.
+void FTFZero::cancelEstimation() {
+    if(m_estimationthread)
+        m_estimationthread->m_canceled.store(1);
+}
 
-    gMW->globalWaitingBarSetValue(1);
+void FTFZero::estimationSegmentTracked() {
+    if(m_estimationthread==NULL || sender()!=m_estimationthread)
+        return;
+
+    std::deque<std::pair<int64_t,std::vector<float> > > segments;
+    m_estimationthread->m_mutex_segments.lock();
+    segments.swap(m_estimationthread->m_segments);
+    m_estimationthread->m_mutex_segments.unlock();
+
+    if(!m_estimationpartial)
+        return;
+
+    float f0min = float(m_estimationthread->m_est.f0min);
+    float f0max = float(m_estimationthread->m_est.f0max);
+    for(size_t k=0; k<segments.size(); ++k){
+        const std::vector<float>& f0 = segments[k].second;
+        for(size_t i=0; i<f0.size() && segments[k].first+int64_t(i)<int64_t(f0s.size()); ++i)
+            f0s[segments[k].first+i] = (f0[i]>0.0f)?std::max(f0min,std::min(f0max,f0[i])):0.0f;
+    }
+
+    if(m_giF0ForSpectrogram){
+        m_giF0ForSpectrogram->updateGeometry();
+        gMW->m_gvSpectrogram->m_scene->update();
+    }
+}
+
+void FTFZero::estimationFinished() {
+    if(m_estimationthread==NULL || sender()!=m_estimationthread)
+        return;
+
+    FTFZeroEstimationThread* thread = m_estimationthread;
+    m_estimationthread = NULL;
+
+    const Estimation& est = thread->m_est;
+    bool canceled = thread->m_canceled.load();
+
+    if(est.computed){
+        applyEstimation(est);
+        gMW->m_gvSpectrumAmplitude->m_scene->update();
+    }
+    else if(canceled){
+        if(m_estimationpartial)
+            m_is_edited = true;
+        gMW->statusBar()->showMessage("Estimation of the F0 of "+visibleName+" canceled, the values already tracked are kept.", 3000);
+    }
+    else
+        QMessageBox::warning(gMW, "Error during F0 estimation", "Estimation of the F0 of "+visibleName+" failed for the following reason:\n"+est.error);
+
+    if(m_giF0ForSpectrogram)
+        m_giF0ForSpectrogram->updateGeometry();
+    gMW->m_gvSpectrogram->m_scene->update();
+    setStatus();
+    gMW->updateWindowTitle();
+
+    thread->deleteLater();
+}
+
+FTFZeroEstimationThread::FTFZeroEstimationThread(QObject* parent, const FTFZero::Estimation& est)
+    : QThread(parent)
+    , m_est(est)
+    , m_canceled(0)
+{
+    m_est.canceled = &m_canceled;
+    m_est.monitor = this;
+}
+
+void FTFZeroEstimationThread::publishSegment(int64_t start, const float* f0, size_t len) {
+    m_mutex_segments.lock();
+    m_segments.push_back(std::make_pair(start, std::vector<float>(f0, f0+len)));
+    m_mutex_segments.unlock();
+
+    emit segmentTracked();
+}
+
+void FTFZeroEstimationThread::run() {
+    try{
+        FTFZero::computeEstimation(m_est);
+    }
+    catch(QString err){
+        m_est.error = err;
+    }
+    // Free the copy of the signal as soon as possible
+    std::vector<int16_t>().swap(m_est.data);
+}
+
+// Cache of the estimations ---------------------------------------------------
+
+#define FTFZERO_CACHEVERSION 2 // To increase when the estimation or the keys change
+#define FTFZERO_CACHETOUCH 86400 // [s] A result used again is rewritten if older, so that it is evicted last
+
+// Everything, but the samples, that changes the result of an estimation
+static void hashEstimationParameters(QCryptographicHash& hash, const FTFZero::Estimation& est) {
+    QString params = QString("v%1 fs=%2 f0min=%3 f0max=%4 step=%5 force=%6 segment=%7")
+            .arg(FTFZERO_CACHEVERSION)
+            .arg(est.fs, 0, 'g', 17)
+            .arg(est.f0min, 0, 'g', 17)
+            .arg(est.f0max, 0, 'g', 17)
+            .arg(est.timestepsize, 0, 'g', 17)
+            .arg(int(est.force))
+            .arg(est.segmentduration, 0, 'g', 17);
+    hash.addData(params.toLatin1());
+}
+
+// The key of a result, from the digest of the analyzed samples
+static QByteArray cacheKey(const QByteArray& datadigest, const FTFZero::Estimation& est) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(datadigest);
+    hashEstimationParameters(hash, est);
+    return hash.result();
+}
+
+static QString cacheFilePath(const QString& cachedir, const QByteArray& key) {
+    return cachedir+"/"+QString(key.toHex())+".f0";
+}
+
+static void writeCachedF0(const QString& filepath, const std::vector<float>& f0);
+
+static bool loadCachedF0(const QString& filepath, std::vector<float>& f0) {
+    QFile file(filepath);
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    quint32 version;
+    quint64 size;
+    in >> version >> size;
+    if(in.status()!=QDataStream::Ok || version!=FTFZERO_CACHEVERSION || size*sizeof(float)>quint64(file.size()))
+        return false;
+    f0.resize(size);
+    for(size_t i=0; i<f0.size(); ++i)
+        in >> f0[i];
+    if(in.status()!=QDataStream::Ok)
+        return false;
+    file.close();
+
+    // The eviction goes by modification time
+    if(QFileInfo(filepath).lastModified().secsTo(QDateTime::currentDateTime())>FTFZERO_CACHETOUCH)
+        writeCachedF0(filepath, f0);
+
+    return true;
+}
+
+// Write aside and rename, so that a concurrent estimation never reads a partial file
+static void writeCachedF0(const QString& filepath, const std::vector<float>& f0) {
+    QFile file(filepath+".tmp"+QString::number(quintptr(QThread::currentThreadId())));
+    if(!file.open(QIODevice::WriteOnly))
+        return;
+    QDataStream out(&file);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    out << quint32(FTFZERO_CACHEVERSION) << quint64(f0.size());
+    for(size_t i=0; i<f0.size(); ++i)
+        out << f0[i];
+    file.close();
+    if(out.status()!=QDataStream::Ok)
+        file.remove();
+    else if(!file.rename(filepath)){
+        // The rename doesn't replace an existing file
+        QFile::remove(filepath);
+        if(!file.rename(filepath))
+            file.remove();
+    }
+}
+
+// Remove the least recently used results beyond maxsize
+static void evictCachedF0(const QString& cachedir, qint64 maxsize) {
+    QFileInfoList files = QDir(cachedir).entryInfoList(QStringList("*.f0"), QDir::Files, QDir::Time); // Most recent first
+    qint64 size = 0;
+    for(int i=0; i<files.size(); ++i){
+        size += files[i].size();
+        if(size>maxsize)
+            QFile::remove(files[i].filePath());
+    }
+}
+
+static void saveCachedF0(const QString& cachedir, const QByteArray& key, const std::vector<float>& f0, qint64 maxsize) {
+    if(!QDir().mkpath(cachedir))
+        return;
+
+    writeCachedF0(cacheFilePath(cachedir, key), f0);
+    evictCachedF0(cachedir, maxsize);
+}
+
+// Take the values of a time selection from the cached F0 of the whole sound
+static bool loadCachedSpan(FTFZero::Estimation& est) {
+    std::vector<float> full;
+    if(!loadCachedF0(cacheFilePath(est.cachedir, est.fullkey), full))
+        return false;
+
+    int64_t first = qRound64(est.tiskipfirst/est.timestepsize);
+    int64_t len = int64_t(est.data.size()/(est.timestepsize*est.fs))+1;
+    if(first>=int64_t(full.size()))
+        return false;
+    len = std::min(len, int64_t(full.size())-first);
+    est.f0.assign(full.begin()+first, full.begin()+first+len);
+    est.tiskipfirst = first*est.timestepsize; // The values are on the grid of the whole sound
+
+    return true;
+}
+
+// Copy the necessary part of the sound, so that the computation doesn't access the sound anymore
+void FTFZero::prepareEstimation(FTSound *snd, double f0min, double f0max, double tstart, double tend, bool force, Estimation& est) {
+
+    double fs = gFL->getFs();
+
+    f0min = std::max(f0min, gMW->m_dlgSettings->ui->dsbEstimationF0Min->minimum()); // Fix hard-coded minimum for f0
+    f0max = std::min(f0max, fs/2.0); // Fix hard-coded minimum for f0
+    if(tstart!=-1)
+        tstart = std::max(tstart, 0.0);
+    if(tend!=-1)
+        tend = std::min(tend, snd->getLastSampleTime());
+
+//    COUTD << "FTFZero::estimate src=" << snd->visibleName << " [" << f0min << "," << f0max << "]Hz [" << tstart << "," << tend << "]s " << force << endl;
+
+    est.fs = fs;
+    est.f0min = f0min;
+    est.f0max = f0max;
+    est.tstart = tstart;
+    est.tend = tend;
+    est.force = force;
+    est.timestepsize = gMW->m_dlgSettings->ui->sbEstimationStepSize->value();
+    est.segmentduration = gMW->m_dlgSettings->ui->dsbEstimationF0SegmentDuration->value();
+    est.nbsegments = 0;
+    est.maxmismatch = 0.0;
+    est.fromcache = false;
+    est.computed = false;
+    est.error.clear();
+    est.cachedir.clear();
+    est.fullkey.clear();
+    est.cachemaxsize = qint64(gMW->m_dlgSettings->ui->sbEstimationF0CacheSize->value())*1024*1024;
+    if(gMW->m_dlgSettings->ui->cbEstimationF0Cache->isChecked())
+        est.cachedir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)+"/f0";
 
     // Initialize with the given input
     // Start with a dirty copy in the necessary format
     // #388: Compute only the necessary values (and not all of the file)
     //       Doing so, the dynamic prog result is not the same.
-    int64_t iskipfirst = std::min(int64_t(m_src_snd->wav.size()),std::max(int64_t(0),int64_t(fs*(tstart-10*timestepsize))));
+    int64_t iskipfirst = std::min(int64_t(snd->wav.size()),std::max(int64_t(0),int64_t(fs*(tstart-10*est.timestepsize))));
     int64_t iskiplast;
     if(tend!=-1)
-        iskiplast = std::min(int64_t(m_src_snd->wav.size()),std::max(int64_t(0),int64_t(fs*(tend+10*timestepsize))));
+        iskiplast = std::min(int64_t(snd->wav.size()),std::max(int64_t(0),int64_t(fs*(tend+10*est.timestepsize))));
     else
-        iskiplast = m_src_snd->wav.size()-1;
-    double tiskipfirst = iskipfirst/fs; // First index of signal's segment which is analyzed.
-    vector<int16_t> data(iskiplast-iskipfirst+1);
-    for(size_t i=0; i<data.size(); ++i){
-        int64_t idx = i+iskipfirst-m_src_snd->m_giWavForWaveform->delay();
-        if(idx>=0 && idx<int64_t(m_src_snd->wav.size()))
-            data[i] = 32768*m_src_snd->wav[idx];
+        iskiplast = snd->wav.size()-1;
+    est.tiskipfirst = iskipfirst/fs; // First index of signal's segment which is analyzed.
+    est.data.resize(iskiplast-iskipfirst+1);
+    for(size_t i=0; i<est.data.size(); ++i){
+        int64_t idx = i+iskipfirst-snd->m_giWavForWaveform->delay();
+        if(idx>=0 && idx<int64_t(snd->wav.size()))
+            est.data[i] = 32768*snd->wav[idx];
         else{
-            data[i] = 0.0;
+            est.data[i] = 0.0;
         }
     }
-//    COUTD << iskipfirst << " " << data.size() << endl;
-    if(fs<6000.0)
-        QMessageBox::warning(gMW, "Problem during estimation of F0", "Sampling rate is smaller than 6kHz, which may create substantial estimation errors.");
-
-    gMW->globalWaitingBarSetValue(2);
-
-    if (!et.Init(data.data(), data.size(), fs, f0min, f0max, true, true))
-        throw QString("EpochTracker initialisation failed");
+//    COUTD << iskipfirst << " " << est.data.size() << endl;
+
+    // For a time selection, the F0 of the whole sound might be in the cache already
+    if(!est.cachedir.isEmpty() && (tstart!=-1 || tend!=-1)){
+        // The whole sound is hashed only once per change of its samples or delay
+        qreal delay = snd->m_giWavForWaveform->delay();
+        if(snd->m_wavdigest.isEmpty() || snd->m_wavdigestdelay!=delay){
+            QCryptographicHash hash(QCryptographicHash::Sha1);
+            std::vector<int16_t> block(65536);
+            for(int64_t first=0; first<int64_t(snd->wav.size()); first+=block.size()){
+                int64_t len = std::min(int64_t(block.size()), int64_t(snd->wav.size())-first);
+                for(int64_t i=0; i<len; ++i){
+                    int64_t idx = first+i-delay;
+                    if(idx>=0 && idx<int64_t(snd->wav.size()))
+                        block[i] = 32768*snd->wav[idx];
+                    else
+                        block[i] = 0.0;
+                }
+                hash.addData((const char*)block.data(), int(len*sizeof(int16_t)));
+            }
+            snd->m_wavdigest = hash.result();
+            snd->m_wavdigestdelay = delay;
+        }
+        est.fullkey = cacheKey(snd->m_wavdigest, est);
+    }
+}
 
-    gMW->globalWaitingBarSetValue(3);
+// Run REAPER on the prepared data
+// It doesn't access anything else, so that it can run in any thread.
+void FTFZero::computeEstimation(Estimation& est) {
+
+    QByteArray key;
+    if(!est.cachedir.isEmpty()){
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        for(size_t first=0; first<est.data.size(); first+=1048576)
+            hash.addData((const char*)(est.data.data()+first), int(std::min(size_t(1048576), est.data.size()-first)*sizeof(int16_t)));
+        key = cacheKey(hash.result(), est);
+
+        if(loadCachedF0(cacheFilePath(est.cachedir, key), est.f0)
+           || (!est.fullkey.isEmpty() && loadCachedSpan(est))){
+            if(est.monitor && !est.f0.empty())
+                est.monitor->publishSegment(0, est.f0.data(), est.f0.size());
+            est.nbsegments = 1;
+            est.maxmismatch = 0.0;
+            est.fromcache = true;
+            est.computed = true;
+            return;
+        }
+    }
 
-    // Compute f0 and pitchmarks.
-    if (!et.ComputeFeatures())
-        throw QString("Failed to compute features");
+    if(est.segmentduration>0.0 && est.data.size()>2*est.segmentduration*est.fs){
+        trackF0Segmented(est);
+    }
+    else{
+        trackF0(est.data.data(), est.data.size(), est, est.f0);
+        if(est.monitor && !est.f0.empty())
+            est.monitor->publishSegment(0, est.f0.data(), est.f0.size());
+        est.nbsegments = 1;
+        est.maxmismatch = 0.0;
+    }
 
-    gMW->globalWaitingBarSetValue(4);
+    // Force clip the f0 values
+    for (size_t i=0; i<est.f0.size(); ++i)
+        if(est.f0[i]>0.0)
+            est.f0[i] = std::max(float(est.f0min),std::min(float(est.f0max),est.f0[i]));
 
-    // et.TrackEpochs()
-    et.CreatePeriodLattice();
-    gMW->globalWaitingBarSetValue(5);
-    et.DoDynamicProgramming();
-    gMW->globalWaitingBarSetValue(6);
-    if (!et.BacktrackAndSaveOutput())
-        throw QString("Failed to track epochs");
+    est.computed = true;
 
-    gMW->globalWaitingBarSetValue(7);
+    if(!key.isEmpty())
+        saveCachedF0(est.cachedir, key, est.f0, est.cachemaxsize);
+}
 
-    std::vector<float> f0; // TODO Drop this temporary variable
-    std::vector<float> corr; // Currently unused
-    if (!et.ResampleAndReturnResults(timestepsize, &f0, &corr))
-        throw QString("Cannot resample the results");
+void FTFZero::applyEstimation(const Estimation& est) {
 
-    // Force clip the f0 values
-    for (size_t i=0; i<f0.size(); ++i)
-        if(f0[i]>0.0)
-            f0[i] = std::max(float(f0min),std::min(float(f0max),f0[i]));
+    const std::vector<float>& f0 = est.f0;
+    double tstart = est.tstart;
+    double tend = est.tend;
+    double timestepsize = est.timestepsize;
+    double tiskipfirst = est.tiskipfirst;
 
     // Estimation is done, let's fill/replace the f0 curve
     if(tstart==-1 && tend==-1){
@@ -944,6 +1284,7 @@ void FTFZero::estimate(FTSound *ftsnd, double f0min, double f0max, double tstart
         // Find the elements in the new values
         int nitlb = std::ceil((tstart-tiskipfirst)/timestepsize);
         int nithb = std::floor((tend-tiskipfirst)/timestepsize);
+        nithb = std::max(nitlb-1, std::min(nithb, int(f0.size())-1));
 
         // Add the new times ...
         std::vector<double> nts(nithb-nitlb+1);
@@ -957,8 +1298,6 @@ void FTFZero::estimate(FTSound *ftsnd, double f0min, double f0max, double tstart
 //        f0s.clear(); f0s.insert(f0s.end(), f0.begin()+nitlb, f0.begin()+nithb+1);
     }
 
-    gMW->globalWaitingBarDone();
-
     if(m_giF0ForSpectrogram)
         m_giF0ForSpectrogram->updateGeometry();
     updateTextsGeometry();
@@ -966,5 +1305,10 @@ void FTFZero::estimate(FTSound *ftsnd, double f0min, double f0max, double tstart
     m_is_edited = true;
     setStatus();
 
+    if(est.fromcache)
+        gMW->statusBar()->showMessage(visibleName+": F0 taken from the cache of the estimations", 3000);
+    else if(est.nbsegments>1)
+        gMW->statusBar()->showMessage(visibleName+": F0 tracked in "+QString::number(est.nbsegments)+" segments (maximum difference in their overlaps: "+QString::number(est.maxmismatch)+"Hz)", 10000);
+
 //    COUTD << ts.size() << " " << f0s.size() << endl;
 }
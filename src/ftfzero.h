@@ -23,23 +23,29 @@ file provided in the source code of DFasma. Another copy can be found at
 
 #include <deque>
 #include <vector>
+#include <stdint.h>
 
 #include <QString>
 #include <QColor>
 #include <QAction>
+#include <QThread>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QByteArray>
 class QGraphicsSimpleTextItem;
 
 class QAEGISampledSignal;
 
 #include "filetype.h"
 class FTSound;
+class FTFZeroEstimationThread;
 
 class FTFZero : public QObject, public FileType
 {
     Q_OBJECT
 
 public:
-    enum FileFormat {FFNotSpecified=0, FFAutoDetect, FFAsciiAutoDetect, FFAsciiTimeValue, FFAsciiValue, FFSDIF, FFEST};
+    enum FileFormat {FFNotSpecified=0, FFAutoDetect, FFAsciiAutoDetect, FFAsciiTimeValue, FFAsciiValue, FFSDIF, FFEST, FFBinaryAutoDetect, FFBinaryNPY, FFBinaryRaw};
     static std::deque<QString> s_formatstrings;
 
 private:
@@ -51,9 +57,14 @@ private:
     QAction* m_actionSave;
     QAction* m_actionSaveAs;
     QAction* m_actionSetSource;
+    QAction* m_actionCancelEstimation;
 
     FileFormat m_fileformat;
 
+    FTFZeroEstimationThread* m_estimationthread; // Running estimation (NULL if none)
+    bool m_estimationpartial; // Show the tracked segments while the estimation is running
+    void stopEstimation();
+
 public:
     FTFZero(QObject* parent);
     FTFZero(const QString& _fileName, QObject* parent, FileType::FileContainer container=FileType::FCUNSET, FileFormat fileformat=FFNotSpecified);
@@ -83,8 +94,45 @@ public:
     void draw_freq_amp(QPainter* painter, const QRectF& rect);
 
     // Estimation
+    // Split in three steps, so that the computation can run in worker threads:
+    // prepareEstimation and applyEstimation have to be called from the GUI thread,
+    // computeEstimation can be called from any thread (throws QString on failure).
+    class Estimation {
+    public:
+        std::vector<int16_t> data; // The analyzed segment of the sound
+        double fs;          // [Hz]
+        double f0min;       // [Hz]
+        double f0max;       // [Hz]
+        double tstart;      // [s] -1 if undefined
+        double tend;        // [s] -1 if undefined
+        double tiskipfirst; // [s] Time of data[0]
+        double timestepsize;// [s]
+        bool force;         // Without voiced/unvoiced decision
+        double segmentduration; // [s] Long recordings are tracked in segments of about this duration (0 to disable)
+        int maxthreads;     // Number of segments tracked in parallel (0 for QThread::idealThreadCount())
+        std::vector<float> f0; // The result
+        int nbsegments;     // Number of segments actually tracked
+        double maxmismatch; // [Hz] Maximum difference between overlapping segments
+        QString cachedir;   // Where the results are cached (empty to disable the cache)
+        QByteArray fullkey; // Cache key of the whole sound (for time selections only)
+        qint64 cachemaxsize;// [bytes] Beyond which the least recently used results are removed
+        bool fromcache;     // The result has been found in the cache
+        bool computed;
+        QString error;
+        QAtomicInt* canceled;  // Cancellation token (can be NULL)
+        FTFZeroEstimationThread* monitor; // Receives the segments as soon as they are tracked (can be NULL)
+        Estimation() : fs(0.0), f0min(0.0), f0max(0.0), tstart(-1.0), tend(-1.0), tiskipfirst(0.0), timestepsize(0.0), force(false), segmentduration(0.0), maxthreads(0), nbsegments(0), maxmismatch(0.0), cachemaxsize(0), fromcache(false), computed(false), canceled(NULL), monitor(NULL) {}
+    };
+    static void prepareEstimation(FTSound *snd, double f0min, double f0max, double tstart, double tend, bool force, Estimation& est);
+    static void computeEstimation(Estimation& est);
+    static void trackF0(const int16_t* data, size_t len, const Estimation& est, std::vector<float>& f0); // In ftfzerotracking.cpp
+    static void trackF0Segmented(Estimation& est); // In ftfzerotracking.cpp
+    void applyEstimation(const Estimation& est);
+
     FTFZero(QObject* parent, FTSound *ftsnd, double f0min, double f0max, double tstart=-1.0, double tend=-1.0, bool force=false);
+    FTFZero(QObject* parent, FTSound *ftsnd, const Estimation& est);
     void estimate(FTSound *ftsnd, double f0min, double f0max, double tstart=-1.0, double tend=-1.0, bool force=false);
+    bool isEstimating() const {return m_estimationthread!=NULL;}
     static QString createFileNameFromSound(const QString& sndfilename);
     FTSound* m_src_snd;
 
@@ -94,6 +142,34 @@ public slots:
     void saveAs();
     void setVisible(bool shown);
     void setSource(FileType* src);
+    void cancelEstimation();
+
+private slots:
+    void estimationSegmentTracked();
+    void estimationFinished();
+};
+
+// Run an estimation in the background.
+// The tracked segments are queued so that the GUI thread can show them before the end.
+class FTFZeroEstimationThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    FTFZero::Estimation m_est;
+    QAtomicInt m_canceled;
+
+    QMutex m_mutex_segments;
+    std::deque<std::pair<int64_t,std::vector<float> > > m_segments; // [frame index] of the first value, values
+
+    FTFZeroEstimationThread(QObject* parent, const FTFZero::Estimation& est);
+
+    void publishSegment(int64_t start, const float* f0, size_t len); // Called from the workers
+
+    void run(); //Q_DECL_OVERRIDE
+
+signals:
+    void segmentTracked();
 };
 
 #endif // FTFZERO_H
@@ -0,0 +1,194 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+// F0 tracking of the prepared data with REAPER
+// Kept apart from the GUI side of FTFZero, so that it can be tested alone.
+
+#include "ftfzero.h"
+
+#include <limits>
+#include <algorithm>
+
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "../external/REAPER/epoch_tracker/epoch_tracker.h"
+
+#define FTFZERO_SEGMENTOVERLAP 2.0 // [s] Tracked on both sides of each cut
+#define FTFZERO_SEGMENTSEARCH 5.0  // [s] Range around the nominal cut where the lowest energy is searched
+#define FTFZERO_SEGMENTENERGYWIN 0.02 // [s] Smoothing of the energy for finding the cuts
+
+static void checkCanceled(const FTFZero::Estimation& est) {
+    if(est.canceled && est.canceled->load())
+        throw QString("Canceled");
+}
+
+// Run REAPER on a part of the prepared data
+// The cancellation is checked between its stages.
+void FTFZero::trackF0(const int16_t* data, size_t len, const Estimation& est, std::vector<float>& f0) {
+
+    EpochTracker et; // TODO to put in FTSound because other features can be extracted from it (ex. GCIs, voicing)
+    et.set_external_frame_interval(est.timestepsize);
+    et.set_unvoiced_pulse_interval(est.timestepsize);
+    if(est.force) et.set_unvoiced_cost(100); // Set arbitray huge cost for avoiding unvoiced segments
+
+    if (!et.Init(data, len, est.fs, est.f0min, est.f0max, true, true))
+        throw QString("EpochTracker initialisation failed");
+
+    checkCanceled(est);
+
+    // Compute f0 and pitchmarks.
+    if (!et.ComputeFeatures())
+        throw QString("Failed to compute features");
+
+    checkCanceled(est);
+
+    // et.TrackEpochs()
+    et.CreatePeriodLattice();
+    checkCanceled(est);
+    et.DoDynamicProgramming();
+    checkCanceled(est);
+    if (!et.BacktrackAndSaveOutput())
+        throw QString("Failed to track epochs");
+
+    std::vector<float> corr; // Currently unused
+    f0.clear();
+    if (!et.ResampleAndReturnResults(est.timestepsize, &f0, &corr))
+        throw QString("Cannot resample the results");
+}
+
+// Track one segment of a long recording
+// Its core frames [corestart,coreend) are published as soon as they are tracked.
+class F0SegmentTask : public QRunnable {
+    const int16_t* m_data;
+    size_t m_len;
+    const FTFZero::Estimation* m_est;
+    int64_t m_segstart;  // [frame index]
+    int64_t m_corestart; // [frame index]
+    int64_t m_coreend;   // [frame index]
+    std::vector<float>* m_f0;
+    QString* m_error;
+
+public:
+    F0SegmentTask(const int16_t* data, size_t len, const FTFZero::Estimation* est, int64_t segstart, int64_t corestart, int64_t coreend, std::vector<float>* f0, QString* error)
+        : m_data(data), m_len(len), m_est(est), m_segstart(segstart), m_corestart(corestart), m_coreend(coreend), m_f0(f0), m_error(error)
+    {}
+    void run() {
+        try{
+            checkCanceled(*m_est);
+            FTFZero::trackF0(m_data, m_len, *m_est, *m_f0);
+            int64_t end = std::min(m_coreend, m_segstart+int64_t(m_f0->size()));
+            if(m_est->monitor && end>m_corestart)
+                m_est->monitor->publishSegment(m_corestart, m_f0->data()+(m_corestart-m_segstart), size_t(end-m_corestart));
+        }
+        catch(QString err){
+            *m_error = err;
+        }
+    }
+};
+
+// Split the recording at low-energy frames into overlapping segments,
+// track them in parallel and stitch them where they agree the most.
+void FTFZero::trackF0Segmented(Estimation& est) {
+    const double stepsamples = est.timestepsize*est.fs;
+    const int64_t nbframes = int64_t(est.data.size()/stepsamples);
+    const int64_t segframes = std::max(int64_t(1), int64_t(est.segmentduration/est.timestepsize+0.5));
+    const int64_t overlapframes = std::max(int64_t(1), int64_t(FTFZERO_SEGMENTOVERLAP/est.timestepsize+0.5));
+    const int64_t searchframes = int64_t(FTFZERO_SEGMENTSEARCH/est.timestepsize+0.5);
+    const int64_t energywin = std::max(int64_t(1), int64_t(FTFZERO_SEGMENTENERGYWIN/est.timestepsize+0.5));
+
+    // Cuts [frame index] at the lowest energy around each nominal cut
+    std::vector<int64_t> cuts(1, 0);
+    for(int64_t nominal=segframes; nominal+segframes/2<nbframes; nominal+=segframes){
+        int64_t searchstart = std::max(cuts.back()+2*overlapframes, nominal-searchframes);
+        int64_t searchend = std::min(nbframes-2*overlapframes, nominal+searchframes);
+        int64_t cut = std::max(nominal, cuts.back()+2*overlapframes);
+        if(cut>=nbframes-2*overlapframes)
+            break;
+        double cutenergy = std::numeric_limits<double>::infinity();
+        for(int64_t j=searchstart; j<=searchend; ++j){
+            size_t first = size_t(std::max(0.0, (j-energywin/2)*stepsamples));
+            size_t last = std::min(est.data.size(), size_t((j+energywin/2+1)*stepsamples));
+            double energy = 0.0;
+            for(size_t n=first; n<last; ++n)
+                energy += double(est.data[n])*est.data[n];
+            if(energy<cutenergy){
+                cutenergy = energy;
+                cut = j;
+            }
+        }
+        cuts.push_back(cut);
+    }
+    cuts.push_back(nbframes);
+    const size_t nbsegments = cuts.size()-1;
+
+    // Track the segments, with their overlaps, in parallel
+    std::vector<int64_t> segstarts(nbsegments); // [frame index]
+    std::vector< std::vector<float> > segf0s(nbsegments);
+    std::vector<QString> errors(nbsegments);
+    QThreadPool pool;
+    pool.setMaxThreadCount((est.maxthreads>0)?est.maxthreads:QThread::idealThreadCount());
+    for(size_t k=0; k<nbsegments; ++k){
+        segstarts[k] = std::max(int64_t(0), cuts[k]-overlapframes);
+        int64_t segend = std::min(nbframes, cuts[k+1]+overlapframes);
+        size_t first = size_t(segstarts[k]*stepsamples+0.5);
+        size_t last = (segend==nbframes)?est.data.size():std::min(est.data.size(), size_t(segend*stepsamples+0.5));
+        pool.start(new F0SegmentTask(est.data.data()+first, last-first, &est, segstarts[k], cuts[k], cuts[k+1], &(segf0s[k]), &(errors[k])));
+    }
+    pool.waitForDone();
+    for(size_t k=0; k<nbsegments; ++k)
+        if(!errors[k].isEmpty())
+            throw errors[k];
+
+    // Stitch the segments
+    size_t len = 0;
+    for(size_t k=0; k<nbsegments; ++k)
+        len = std::max(len, size_t(segstarts[k]+segf0s[k].size()));
+    est.f0.assign(len, 0.0f);
+    est.maxmismatch = 0.0;
+    int64_t from = 0; // First frame taken from the current segment
+    for(size_t k=0; k<nbsegments; ++k){
+        int64_t to = int64_t(len); // Last frame (excluded) taken from the current segment
+        if(k+1<nbsegments){
+            // Splice where both segments agree the most, in the middle of the overlap
+            // (away from the edges of the segments, which are less reliable)
+            const std::vector<float>& a = segf0s[k];
+            const std::vector<float>& b = segf0s[k+1];
+            int64_t start = std::max(segstarts[k+1], cuts[k+1]-overlapframes/2);
+            int64_t end = std::min(segstarts[k]+int64_t(a.size()), cuts[k+1]+overlapframes/2+1);
+            end = std::min(end, segstarts[k+1]+int64_t(b.size()));
+            to = cuts[k+1];
+            float mindiff = std::numeric_limits<float>::infinity();
+            for(int64_t j=start; j<end; ++j){
+                float diff = qAbs(a[j-segstarts[k]]-b[j-segstarts[k+1]]);
+                est.maxmismatch = std::max(est.maxmismatch, double(diff));
+                if(diff<mindiff || (diff==mindiff && qAbs(j-cuts[k+1])<qAbs(to-cuts[k+1]))){
+                    mindiff = diff;
+                    to = j;
+                }
+            }
+        }
+        const std::vector<float>& f0 = segf0s[k];
+        for(int64_t j=from; j<to && j-segstarts[k]<int64_t(f0.size()); ++j)
+            est.f0[j] = f0[j-segstarts[k]];
+        from = to;
+    }
+    est.nbsegments = int(nbsegments);
+}
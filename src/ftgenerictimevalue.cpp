@@ -47,8 +47,11 @@ using namespace Easdif;
 #include "gvspectrogram.h"
 #include "gvgenerictimevalue.h"
 #include "wgenerictimevalue.h"
+#include "textcolumnsreader.h"
+#include "binaryarrayreader.h"
 
 #include "qaegisampledsignal.h"
+#include "qaegiuniformlysampledsignal.h"
 #include "qaehelpers.h"
 
 std::deque<QString> FTGenericTimeValue::s_formatstrings;
@@ -60,7 +63,11 @@ FTGenericTimeValue::ClassConstructor::ClassConstructor(){
         FTGenericTimeValue::s_formatstrings.push_back("Auto");
         FTGenericTimeValue::s_formatstrings.push_back("Text - Auto");
         FTGenericTimeValue::s_formatstrings.push_back("Text - Time Value (*.txt)");
+        FTGenericTimeValue::s_formatstrings.push_back("Text - Value (single column) (*.txt)");
         FTGenericTimeValue::s_formatstrings.push_back("SDIF - 1FQ0/1FQ0 (*.sdif)"); // TODO
+        FTGenericTimeValue::s_formatstrings.push_back("Binary - Auto");
+        FTGenericTimeValue::s_formatstrings.push_back("Binary - NumPy (*.npy)");
+        FTGenericTimeValue::s_formatstrings.push_back("Binary - Raw with header (*.hdr)");
     }
 }
 FTGenericTimeValue::ClassConstructor FTGenericTimeValue::s_class_constructor;
@@ -81,6 +88,9 @@ void FTGenericTimeValue::constructor_internal(GVGenericTimeValue* view){
     m_fileformat = FFNotSpecified;
     m_view = view;
     m_giGenericTimeValue = NULL;
+    m_giGenericTimeValueUniform = NULL;
+    m_timestep = 0.0;
+    m_timestart = 0.0;
     m_values_min = -1000;
     m_values_max = +1000;
 
@@ -108,19 +118,37 @@ void FTGenericTimeValue::constructor_external(){
 
     gFL->ftgenerictimevalues.push_back(this);
 
-    QPen pen(getColor());
-    pen.setWidth(0);
+    createGraphicsItem();
+
+    m_view->m_ftgenerictimevalues.append(this);
+    m_view->updateSceneRect();
+    m_view->viewSet();
+}
+
+// Uniformly sampled values are drawn without any time vector
+void FTGenericTimeValue::createGraphicsItem(){
+    delete m_giGenericTimeValue;
+    m_giGenericTimeValue = NULL;
+    delete m_giGenericTimeValueUniform;
+    m_giGenericTimeValueUniform = NULL;
 
-    m_giGenericTimeValue = new QAEGISampledSignal(&ts, &values, m_view);
     QPen spectro_pen(getColor());
     spectro_pen.setCosmetic(true);
     spectro_pen.setWidth(1);
-    m_giGenericTimeValue->setPen(spectro_pen);
 
-    m_view->m_scene->addItem(m_giGenericTimeValue);
-    m_view->m_ftgenerictimevalues.append(this);
-    m_view->updateSceneRect();
-    m_view->viewSet();
+    if(m_timestep>0.0){
+        m_giGenericTimeValueUniform = new QAEGIUniformlySampledSignal(&values, 1.0/m_timestep, m_view);
+        m_giGenericTimeValueUniform->setDelay(m_timestart/m_timestep);
+        m_giGenericTimeValueUniform->setPen(spectro_pen);
+        m_giGenericTimeValueUniform->setVisible(m_actionShow->isChecked());
+        m_view->m_scene->addItem(m_giGenericTimeValueUniform);
+    }
+    else{
+        m_giGenericTimeValue = new QAEGISampledSignal(&ts, &values, m_view);
+        m_giGenericTimeValue->setPen(spectro_pen);
+        m_giGenericTimeValue->setVisible(m_actionShow->isChecked());
+        m_view->m_scene->addItem(m_giGenericTimeValue);
+    }
 }
 
 FTGenericTimeValue::FTGenericTimeValue(const QString& _fileName, WidgetGenericTimeValue *parent, FileType::FileContainer container, FileFormat fileformat)
@@ -140,6 +168,8 @@ FTGenericTimeValue::FTGenericTimeValue(const QString& _fileName, WidgetGenericTi
         m_fileformat = FFSDIF;
     else if(container==FileType::FCASCII)
         m_fileformat = FFAsciiAutoDetect;
+    else if(container==FileType::FCBINARY)
+        m_fileformat = FFBinaryAutoDetect;
 
     if(!fileFullPath.isEmpty()){
         checkFileStatus(CFSMEXCEPTION);
@@ -157,6 +187,8 @@ FTGenericTimeValue::FTGenericTimeValue(const FTGenericTimeValue& ft)
 
     ts = ft.ts;
     values = ft.values;
+    m_timestep = ft.m_timestep;
+    m_timestart = ft.m_timestart;
     m_values_min = ft.m_values_min;
     m_values_max = ft.m_values_max;
 
@@ -170,6 +202,17 @@ FileType* FTGenericTimeValue::duplicate(){
     return new FTGenericTimeValue(*this);
 }
 
+void FTGenericTimeValue::updateValuesMinMax(){
+    m_values_min = +std::numeric_limits<double>::infinity();
+    m_values_max = -std::numeric_limits<double>::infinity();
+    for(size_t n=0; n<values.size(); ++n){
+        if(!std::isinf(values[n])){
+            m_values_min = std::min(m_values_min, values[n]);
+            m_values_max = std::max(m_values_max, values[n]);
+        }
+    }
+}
+
 void FTGenericTimeValue::load(){
 
     if(m_fileformat==FFNotSpecified)
@@ -181,6 +224,15 @@ void FTGenericTimeValue::load(){
         if(FileType::isFileSDIF(fileFullPath))
             m_fileformat = FFSDIF;
     #endif
+    if(m_fileformat==FFAutoDetect)
+        if(BinaryArrayReader::isFileBinary(fileFullPath))
+            m_fileformat = FFBinaryAutoDetect;
+    if(m_fileformat==FFBinaryAutoDetect){
+        if(BinaryArrayReader::isFileNPY(fileFullPath))
+            m_fileformat = FFBinaryNPY;
+        else
+            m_fileformat = FFBinaryRaw;
+    }
     // Check for text/ascii formats
     if(m_fileformat==FFAutoDetect || m_fileformat==FFAsciiAutoDetect){
         // Find the format using grammar check
@@ -188,66 +240,61 @@ void FTGenericTimeValue::load(){
         std::ifstream fin(fileFullPath.toLatin1().constData());
         if(!fin.is_open())
             throw QString("FTGenericTimeValue:FFAutoDetect: Cannot open the file.");
-        double t;
-        string line, text;
+        string line;
         // Check the first line only (Assuming it is enough)
         if(!std::getline(fin, line))
             throw QString("FTGenericTimeValue:FFAutoDetect: There is not a single line in this file.");
 
-        // Check: <number> <number>
-        std::istringstream iss(line);
-        if((iss >> t >> t) && iss.eof())
-            m_fileformat = FFAsciiTimeValue;        
-        else{
-            std::istringstream iss(line);
-            if((iss >> t) && iss.eof())
-                m_fileformat = FFAsciiValue;
-        }
+        // Check: <number> <number> (or more numbers if a column is selected)
+        int nbnumbers = TextColumnsReader::countNumbers(line.c_str(), line.c_str()+line.size());
+        if(nbnumbers==2 || (nbnumbers>2 && TextColumnsReader::selectedColumn(m_dataselectors)!=-1))
+            m_fileformat = FFAsciiTimeValue;
+        // Check: <number>
+        else if(nbnumbers==1)
+            m_fileformat = FFAsciiValue;
     }
 
     if(m_fileformat==FFAutoDetect)
         throw QString("Cannot detect the file format of this F0 file");
 
     // Load the data given the format found or the one given
-    if(m_fileformat==FFAsciiTimeValue){
-        ifstream fin(fileFullPath.toLatin1().constData());
-        if(!fin.is_open())
-            throw QString("FTGenericTimeValue:FFAsciiTimeValue: Cannot open file");
-
-        double t, value;
-        m_values_min = +std::numeric_limits<double>::infinity();
-        m_values_max = -std::numeric_limits<double>::infinity();
-        string line, text;
-        while(std::getline(fin, line)) {
-            std::istringstream(line) >> t >> value;
-            ts.push_back(t);
-            if(!std::isinf(value)){
-                m_values_min = std::min(m_values_min, value);
-                m_values_max = std::max(m_values_max, value);
-            }
-            values.push_back(value);
-        }
+    if(m_fileformat==FFAsciiTimeValue || m_fileformat==FFAsciiValue){
+        TextColumnsReader reader(fileFullPath);
+
+        // Convert only the time and the selected column (the values follow the time by default)
+        int column = TextColumnsReader::selectedColumn(m_dataselectors);
+        std::vector<int> columns;
+        if(m_fileformat==FFAsciiTimeValue)
+            columns.push_back(0);
+        if(column!=-1)
+            columns.push_back(column);
+        else
+            columns.push_back((m_fileformat==FFAsciiTimeValue)?1:0);
+
+        std::vector< std::vector<double> > data;
+        reader.read(columns, data);
+        values.swap(data.back());
+        if(m_fileformat==FFAsciiTimeValue)
+            ts.swap(data[0]);
+        else
+            m_timestep = gMW->m_dlgSettings->ui->sbF0DefaultStepSize->value();
+
+        updateValuesMinMax();
     }
-    else if(m_fileformat==FFAsciiValue){
-        ifstream fin(fileFullPath.toLatin1().constData());
-        if(!fin.is_open())
-            throw QString("FTGenericTimeValue:FFAsciiValue: Cannot open file");
-
-        double t=0.0;
-        double value;
-        m_values_min = +std::numeric_limits<double>::infinity();
-        m_values_max = -std::numeric_limits<double>::infinity();
-        string line, text;
-        while(std::getline(fin, line)) {
-            std::istringstream(line) >> value;
-            ts.push_back(t);
-            if(!std::isinf(value)){
-                m_values_min = std::min(m_values_min, value);
-                m_values_max = std::max(m_values_max, value);
-            }
-            values.push_back(value);
-            t += gMW->m_dlgSettings->ui->sbF0DefaultStepSize->value();
+    else if(m_fileformat==FFBinaryNPY || m_fileformat==FFBinaryRaw){
+        // Converted straight from the memory mapping
+        BinaryArrayReader reader(fileFullPath);
+        if(reader.hasTimeColumn())
+            reader.readTimes(ts, 0.0);
+        else{
+            m_timestep = reader.getTimeStep();
+            if(m_timestep<=0.0)
+                m_timestep = gMW->m_dlgSettings->ui->sbF0DefaultStepSize->value();
+            m_timestart = reader.getTimeStart();
         }
+        reader.readValues(TextColumnsReader::selectedColumn(m_dataselectors), values);
+
+        updateValuesMinMax();
     }
     else if(m_fileformat==FFSDIF){
         #ifdef SUPPORT_SDIF
@@ -356,11 +403,23 @@ bool FTGenericTimeValue::reload() {
     // Reset everything ...
     ts.clear();
     values.clear();
+    double timestep = m_timestep;
+    m_timestep = 0.0;
+    m_timestart = 0.0;
 
     // ... and reload the data from the file
     load();
 
-    m_giGenericTimeValue->update();
+    if((m_timestep>0.0)!=(timestep>0.0) || (m_giGenericTimeValueUniform && m_timestep!=timestep))
+        createGraphicsItem();
+    else if(m_giGenericTimeValueUniform){
+        m_giGenericTimeValueUniform->setDelay(m_timestart/m_timestep);
+        m_giGenericTimeValueUniform->updateMinMaxValues();
+        m_giGenericTimeValueUniform->clearCache();
+        m_giGenericTimeValueUniform->update();
+    }
+    else
+        m_giGenericTimeValue->update();
 
     return true;
 }
@@ -515,8 +574,8 @@ void FTGenericTimeValue::updateStatistics(){
     m_valuemin = std::numeric_limits<double>::infinity();
     m_valuemax = -std::numeric_limits<double>::infinity();
 //        DCOUT << ts.size() << " " << values.size() << std::endl;
-    for(size_t i=0; i<ts.size(); ++i){
-        if(i>0)
+    for(size_t i=0; i<values.size(); ++i){
+        if(i>0 && m_timestep<=0.0)
             m_meandts += ts[i]-ts[i-1];
         double value = values[i];
         m_valuemin = std::min(m_valuemin, value);
@@ -526,7 +585,10 @@ void FTGenericTimeValue::updateStatistics(){
             nbnoninfvalues++;
         }
     }
-    m_meandts /= ts.size();
+    if(m_timestep>0.0)
+        m_meandts = m_timestep;
+    else
+        m_meandts /= ts.size();
     m_meanvalue /= nbnoninfvalues;
 
     gFL->fileInfoUpdate();
@@ -534,8 +596,8 @@ void FTGenericTimeValue::updateStatistics(){
 
 QString FTGenericTimeValue::info() const {
     QString str = FileType::info();
-    str += "Number of values: " + QString::number(ts.size()) + "<br/>";
-    if(ts.size()>0){
+    str += "Number of values: " + QString::number(values.size()) + "<br/>";
+    if(values.size()>0){
         str += "Average sampling: " + QString("%1").arg(m_meandts, 0,'f',gMW->m_dlgSettings->ui->sbViewsTimeDecimals->value()) + "s<br/>";
         str += QString("Values in [%1, %2]").arg(m_valuemin, 0,'g',3).arg(m_valuemax, 0,'g',5);
         str += QString("<br/>Mean Value=%1").arg(m_meanvalue, 0,'g',5);
@@ -571,7 +633,10 @@ void FTGenericTimeValue::setVisible(bool shown){
         updateTextsGeometry();
 
 //    m_aspec_txt->setVisible(shown);
-    m_giGenericTimeValue->setVisible(shown);
+    if(m_giGenericTimeValue)
+        m_giGenericTimeValue->setVisible(shown);
+    if(m_giGenericTimeValueUniform)
+        m_giGenericTimeValueUniform->setVisible(shown);
 }
 
 void FTGenericTimeValue::setColor(const QColor& color){
@@ -587,21 +652,33 @@ void FTGenericTimeValue::setColor(const QColor& color){
 //    m_aspec_txt->setPen(pen);
 //    m_aspec_txt->setBrush(brush);
 
-    pen = m_giGenericTimeValue->getPen();
-    pen.setColor(color);
-    m_giGenericTimeValue->setPen(pen);
+    QPen spectro_pen(color);
+    spectro_pen.setCosmetic(true);
+    spectro_pen.setWidth(1);
+    if(m_giGenericTimeValue)
+        m_giGenericTimeValue->setPen(spectro_pen);
+    if(m_giGenericTimeValueUniform)
+        m_giGenericTimeValueUniform->setPen(spectro_pen);
 }
 
 void FTGenericTimeValue::zposReset(){
-    m_giGenericTimeValue->setZValue(0.0);
+    if(m_giGenericTimeValue)
+        m_giGenericTimeValue->setZValue(0.0);
+    if(m_giGenericTimeValueUniform)
+        m_giGenericTimeValueUniform->setZValue(0.0);
 }
 
 void FTGenericTimeValue::zposBringForward(){
-    m_giGenericTimeValue->setZValue(1.0);
+    if(m_giGenericTimeValue)
+        m_giGenericTimeValue->setZValue(1.0);
+    if(m_giGenericTimeValueUniform)
+        m_giGenericTimeValueUniform->setZValue(1.0);
 }
 
 double FTGenericTimeValue::getLastSampleTime() const {
-    if(ts.empty())
+    if(m_timestep>0.0)
+        return values.empty()?0.0:m_timestart+(values.size()-1)*m_timestep;
+    else if(ts.empty())
         return 0.0;
     else
         return *((ts.end()-1));
@@ -631,6 +708,7 @@ double FTGenericTimeValue::getLastSampleTime() const {
 FTGenericTimeValue::~FTGenericTimeValue() {
 
     delete m_giGenericTimeValue;
+    delete m_giGenericTimeValueUniform;
 //    delete m_aspec_txt;
 
     if(m_view){
@@ -29,6 +29,7 @@ class QColor;
 class QAction;
 class QGraphicsSimpleTextItem;
 class QAEGISampledSignal;
+class QAEGIUniformlySampledSignal;
 class WidgetGenericTimeValue;
 
 #include "filetype.h"
@@ -47,7 +48,7 @@ class FTGenericTimeValue : public QObject, public FileType
     QString m_dataselectors;
 
 public:
-    enum FileFormat {FFNotSpecified=0, FFAutoDetect, FFAsciiAutoDetect, FFAsciiTimeValue, FFAsciiValue, FFSDIF};
+    enum FileFormat {FFNotSpecified=0, FFAutoDetect, FFAsciiAutoDetect, FFAsciiTimeValue, FFAsciiValue, FFSDIF, FFBinaryAutoDetect, FFBinaryNPY, FFBinaryRaw};
     static std::deque<QString> s_formatstrings;
 
 private:
@@ -55,6 +56,8 @@ private:
     void constructor_internal(GVGenericTimeValue* view);
     void constructor_external();
     void load();
+    void updateValuesMinMax();
+    void createGraphicsItem();
 
     FileFormat m_fileformat;
 
@@ -67,9 +70,12 @@ public:
     GVGenericTimeValue* m_view;
     GVGenericTimeValue* gview() const {return m_view;}
 
-    std::vector<double> ts;
+    std::vector<double> ts; // Empty if the values are uniformly sampled
     std::vector<double> values;
-    QAEGISampledSignal* m_giGenericTimeValue;
+    double m_timestep;  // [s] Step of the uniformly sampled values (0 if the times are in ts)
+    double m_timestart; // [s] Time of the first uniformly sampled value
+    QAEGISampledSignal* m_giGenericTimeValue;                 // If the times are in ts
+    QAEGIUniformlySampledSignal* m_giGenericTimeValueUniform; // If the values are uniformly sampled
     double m_values_min;
     double m_values_max;
 
@@ -24,6 +24,7 @@ file provided in the source code of DFasma. Another copy can be found at
 #include <numeric>
 #include <algorithm>
 #include <vector>
+#include <map>
 using namespace std;
 
 #ifdef SUPPORT_SDIF
@@ -43,12 +44,14 @@ using namespace Easdif;
 #include <QGraphicsSimpleTextItem>
 #include <QGraphicsObject>
 #include <QGraphicsTextItem>
+#include <QGraphicsView>
 #include <QTextCursor>
 #include <QTextStream>
 #include <QTextCodec>
 #include <QRegularExpressionMatch>
 
 #include "qaehelpers.h"
+#include "sortedmove.h"
 
 #include "wmainwindow.h"
 #include "ui_wmainwindow.h"
@@ -56,6 +59,7 @@ using namespace Easdif;
 #include "gvwaveform.h"
 #include "gvspectrogram.h"
 #include "ftfzero.h"
+#include "textcolumnsreader.h"
 
 extern QString DFasmaVersion();
 
@@ -64,12 +68,14 @@ bool FTGraphicsLabelItem::s_isEditing = false;
 FTGraphicsLabelItem::FTGraphicsLabelItem(FTLabels* ftl, const QString & text)
     : QGraphicsTextItem(text)
     , m_ftl(ftl)
+    , m_index(-1)
 {
 }
 
 FTGraphicsLabelItem::FTGraphicsLabelItem(FTGraphicsLabelItem* ftgi, FTLabels* ftl)
     : QGraphicsTextItem(ftgi->toPlainText())
     , m_ftl(ftl)
+    , m_index(-1)
 {
 }
 
@@ -86,11 +92,10 @@ void FTGraphicsLabelItem::focusOutEvent(QFocusEvent * event){
 //    COUTD << "FTGraphicsLabelItem::focusOutEvent " << endl;
     s_isEditing = false;
 
-    // Replace the text in the spectrogram
-    std::deque<double>::iterator p = std::find(m_ftl->starts.begin(), m_ftl->starts.end(), pos().x());
-    if(p!=m_ftl->starts.end()){
-        int index = std::distance(m_ftl->starts.begin(), p);
-        m_ftl->spectrogram_labels[index]->setText(toPlainText());
+    // Store the new text (which also replaces it in the spectrogram)
+    if(m_index>=0 && m_index<m_ftl->getNbLabels()){
+        if(toPlainText()!=m_ftl->labels[m_index])
+            m_ftl->changeText(m_index, toPlainText());
     }
     else
         qWarning("FTGraphicsLabelItem::focusOutEvent Cannot replace the text in the spectrogram");
@@ -140,6 +145,7 @@ FTLabels::ClassConstructor FTLabels::s_class_constructor;
 void FTLabels::constructor_internal(){
     m_fileformat = FFNotSpecified;
     m_src_fzero = NULL;
+    m_offset = 0.0;
 
     connect(m_actionShow, SIGNAL(toggled(bool)), this, SLOT(setVisible(bool)));
 
@@ -208,9 +214,10 @@ FTLabels::FTLabels(const FTLabels& ft)
 {
     FTLabels::constructor_internal();
 
-    int starti=0;
-    for(std::deque<FTGraphicsLabelItem*>::const_iterator it=ft.waveform_labels.begin(); it!=ft.waveform_labels.end(); ++it, ++starti)
-        addLabel(ft.starts[starti], (*it)->toolTip(), (*it)->toPlainText());
+    m_starts = ft.m_starts;
+    m_offset = ft.m_offset;
+    labels = ft.labels;
+    fulltexts = ft.fulltexts;
 
     m_lastreadtime = ft.m_lastreadtime;
     m_modifiedtime = ft.m_modifiedtime;
@@ -237,6 +244,21 @@ QString FTLabels::createFileNameFromFZero(const QString& fzerofilename){
     return fileName+".vuv.txt";
 }
 
+// Read the times (nbtimes columns) and the text (following column) of each line of a label file
+static void readLabelColumns(const QString& filepath, int nbtimes, std::vector< std::vector<double> >& times, std::vector<QString>& texts) {
+    TextColumnsReader reader(filepath);
+    std::vector<int> columns(nbtimes);
+    for(int c=0; c<nbtimes; ++c)
+        columns[c] = c;
+    std::vector<QByteArray> rawtexts;
+    reader.read(columns, times, nbtimes, &rawtexts);
+
+    QTextCodec* codec = QTextCodec::codecForName(gMW->m_dlgSettings->ui->cbLabelsDefaultTextEncoding->currentText().toLatin1());
+    texts.resize(rawtexts.size());
+    for(size_t n=0; n<rawtexts.size(); ++n)
+        texts[n] = codec?codec->toUnicode(rawtexts[n]):QString::fromLocal8Bit(rawtexts[n]);
+}
+
 void FTLabels::load() {
 //    COUTD << "FTLabels::load " << m_fileformat << " m_fileformat=" << m_fileformat << endl;
 
@@ -320,92 +342,29 @@ void FTLabels::load() {
 
     // Load the data given the format found or the one given
     if(m_fileformat==FFTEXTTimeText){
-        QFile data(fileFullPath);
-        if(!data.open(QFile::ReadOnly))
-            throw QString("FTLabel: Cannot open file");
-
-        double t;
-        QString line, text;
-        QTextStream stream(&data);
-        stream.setCodec(gMW->m_dlgSettings->ui->cbLabelsDefaultTextEncoding->currentText().toLatin1().constData());
-        line = stream.readLine();
-        do {
-            QTextStream(&line) >> t >> text;
-            addLabel(t, text, extractCenterLabel(text));
-
-            line = stream.readLine();
-        } while (!line.isNull());
-    }
-    else if(m_fileformat==FFTEXTSegmentsFloat){
-        QFile data(fileFullPath);
-        if(!data.open(QFile::ReadOnly))
-            throw QString("FTLabel: Cannot open file");
-
-        double startt, endt;
-        QString line, text;
-        QTextStream stream(&data);
-        stream.setCodec(gMW->m_dlgSettings->ui->cbLabelsDefaultTextEncoding->currentText().toLatin1().constData());
-        line = stream.readLine();
-        do {
-            QTextStream(&line) >> startt >> endt >> text;
-            addLabel(startt, text, extractCenterLabel(text));
-
-            line = stream.readLine();
-        } while (!line.isNull());
-
-        if(text.size()>0 && (char)(text.toLatin1()[0])!=char(31))
-            addLabel(endt, "");
-    }
-    else if(m_fileformat==FFTEXTSegmentsSample){
-        QFile data(fileFullPath);
-        if(!data.open(QFile::ReadOnly))
-            throw QString("FTLabel: Cannot open file");
+        std::vector< std::vector<double> > times;
+        std::vector<QString> texts;
+        readLabelColumns(fileFullPath, 1, times, texts);
 
-        double fs = gFL->getFs(); // Use the sampling frequency from the loaded files
-        double startt, endt;
-        QString line, text;
-        QTextStream stream(&data);
-        stream.setCodec(gMW->m_dlgSettings->ui->cbLabelsDefaultTextEncoding->currentText().toLatin1().constData());
-        line = stream.readLine();
-        do {
-//                COUTD << '"' << line << '"' << endl;
-            QTextStream(&line) >> startt >> endt >> text;
-            startt /= fs;
-            endt /= fs;
-//                COUTD << startt << " " << '"' << text << '"' << endl;
-            addLabel(startt, text, extractCenterLabel(text));
-
-            line = stream.readLine();
-        } while (!line.isNull());
-
-//            QByteArray ba = text.toLatin1();
-//            for(size_t ci=0; ci<ba.size(); ++ci)
-//                std::cout << int((unsigned char)(ba[ci])) << std::endl;
-
-        if(text.size()>0 && (char)(text.toLatin1()[0])!=char(31))
-            addLabel(endt, "");
+        for(size_t n=0; n<texts.size(); ++n)
+            appendLabel(times[0][n], texts[n], extractCenterLabel(texts[n]));
     }
-    else if(m_fileformat==FFTEXTSegmentsHTK){
-        QFile data(fileFullPath);
-        if(!data.open(QFile::ReadOnly))
-            throw QString("FTLabel: Cannot open file");
-
-        double startt, endt;
-        QString line, text;
-        QTextStream stream(&data);
-        stream.setCodec(gMW->m_dlgSettings->ui->cbLabelsDefaultTextEncoding->currentText().toLatin1().constData());
-        line = stream.readLine();
-        do {
-            QTextStream(&line) >> startt >> endt >> text;
-            startt *= 1e-7;
-            endt *= 1e-7;
-            addLabel(startt, text, extractCenterLabel(text));
-
-            line = stream.readLine();
-        } while (!line.isNull());
-
-        if(text.size()>0 && (char)(text.toLatin1()[0])!=char(31))
-            addLabel(endt, "");
+    else if(m_fileformat==FFTEXTSegmentsFloat || m_fileformat==FFTEXTSegmentsSample || m_fileformat==FFTEXTSegmentsHTK){
+        std::vector< std::vector<double> > times;
+        std::vector<QString> texts;
+        readLabelColumns(fileFullPath, 2, times, texts);
+
+        double unit = 1.0;                  // [s]
+        if(m_fileformat==FFTEXTSegmentsSample)
+            unit = gFL->getFs();            // Use the sampling frequency from the loaded files
+        else if(m_fileformat==FFTEXTSegmentsHTK)
+            unit = 1e7;                     // 100[ns]
+
+        for(size_t n=0; n<texts.size(); ++n)
+            appendLabel(times[0][n]/unit, texts[n], extractCenterLabel(texts[n]));
+
+        if(!texts.empty() && texts.back().size()>0 && (char)(texts.back().toLatin1()[0])!=char(31))
+            appendLabel(times[1].back()/unit, "", "");
     }
     else if(m_fileformat==FFSDIF){
         #ifdef SUPPORT_SDIF
@@ -464,7 +423,7 @@ void FTLabels::load() {
                                 // ends.push_back(t);
                             }
                             else{
-                                addLabel(position, str, extractCenterLabel(str));
+                                appendLabel(position, str, extractCenterLabel(str));
                             }
                         }
                     }
@@ -509,6 +468,8 @@ void FTLabels::load() {
         throw QString("File format not recognized for loading this label file.");
     }
 
+    sort();
+    invalidateItems();
     updateTextsGeometryWaveform();
     updateTextsGeometrySpectrogram();
 
@@ -520,19 +481,11 @@ void FTLabels::load() {
 void FTLabels::clear() {
 //    COUTD << "FTLabels::clear" << endl;
     if(getNbLabels()>0) {
-        starts.clear();
-        for(size_t li=0; li<waveform_labels.size(); li++)
-            delete waveform_labels[li];
-        waveform_labels.clear();
-        for(size_t li=0; li<spectrogram_labels.size(); li++)
-            delete spectrogram_labels[li];
-        spectrogram_labels.clear();
-        for(size_t li=0; li<waveform_lines.size(); li++)
-            delete waveform_lines[li];
-        waveform_lines.clear();
-        for(size_t li=0; li<spectrogram_lines.size(); li++)
-            delete spectrogram_lines[li];
-        spectrogram_lines.clear();
+        m_starts.clear();
+        m_offset = 0.0;
+        labels.clear();
+        fulltexts.clear();
+        invalidateItems();
 
         m_is_edited = true;
         setStatus();
@@ -553,7 +506,7 @@ bool FTLabels::reload() {
 }
 
 void FTLabels::saveAs() {
-    if(starts.size()==0){
+    if(m_starts.size()==0){
         QMessageBox::warning(NULL, "Nothing to save!", "There is no content to save from this file. No file will be saved.");
         return;
     }
@@ -607,13 +560,11 @@ void FTLabels::saveAs() {
 }
 
 void FTLabels::save() {
-    if(starts.size()==0){
+    if(m_starts.size()==0){
         QMessageBox::warning(NULL, "Nothing to save!", "There is no content to save from this file. No file will be saved.");
         return;
     }
 
-    sort(); // In the file, we want the labels' time in ascending order
-
     if(m_fileformat==FFNotSpecified || m_fileformat==FFAutoDetect)
         m_fileformat = FFTEXTTimeText;
 
@@ -626,8 +577,8 @@ void FTLabels::save() {
         stream.setRealNumberPrecision(12);
         stream.setRealNumberNotation(QTextStream::ScientificNotation);
         stream.setCodec(gMW->m_dlgSettings->ui->cbLabelsDefaultTextEncoding->currentText().toLatin1().constData());
-        for(size_t li=0; li<starts.size(); li++)
-            stream << starts[li] << " " << waveform_labels[li]->toPlainText() << endl;
+        for(size_t li=0; li<m_starts.size(); li++)
+            stream << getStart(li) << " " << labels[li] << endl;
     }
     else if(m_fileformat==FFTEXTSegmentsFloat){
         QFile data(fileFullPath);
@@ -638,20 +589,20 @@ void FTLabels::save() {
         stream.setRealNumberPrecision(12);
         stream.setRealNumberNotation(QTextStream::ScientificNotation);
         stream.setCodec(gMW->m_dlgSettings->ui->cbLabelsDefaultTextEncoding->currentText().toLatin1().constData());
-        for(size_t li=0; li<starts.size(); li++) {
+        for(size_t li=0; li<m_starts.size(); li++) {
             // If this is the last one AND its text is empty, skip it.
             // (thus, manage the read/write of segments files)
-            if(li==starts.size()-1 && waveform_labels[li]->toPlainText()=="")
+            if(li==m_starts.size()-1 && labels[li]=="")
                 continue;
 
-            double last = starts[li] + 1.0/gFL->getFs(); // If not end, add a single sample to start
-            if(li<starts.size()-1)
-                last = starts[li+1]; // Otherwise use next start, if not the last label
+            double last = getStart(li) + 1.0/gFL->getFs(); // If not end, add a single sample to start
+            if(li<m_starts.size()-1)
+                last = getStart(li+1); // Otherwise use next start, if not the last label
             else {
                 if(gFL->ftsnds.size()>0)
                     last = gFL->getCurrentFTSound(true)->getLastSampleTime(); // Or last wav's sample time
             }
-            stream << starts[li] << " " << last << " " << waveform_labels[li]->toPlainText() << endl;
+            stream << getStart(li) << " " << last << " " << labels[li] << endl;
         }
     }
     else if(m_fileformat==FFTEXTSegmentsSample){
@@ -663,20 +614,20 @@ void FTLabels::save() {
 
         QTextStream stream(&data);
         stream.setCodec(gMW->m_dlgSettings->ui->cbLabelsDefaultTextEncoding->currentText().toLatin1().constData());
-        for(size_t li=0; li<starts.size(); li++) {
+        for(size_t li=0; li<m_starts.size(); li++) {
             // If this is the last one AND its text is empty, skip it.
             // (thus, manage the read/write of segments files)
-            if(li==starts.size()-1 && waveform_labels[li]->toPlainText()=="")
+            if(li==m_starts.size()-1 && labels[li]=="")
                 continue;
 
-            double last = starts[li] + 1.0/gFL->getFs(); // If not end, add a single sample to start
-            if(li<starts.size()-1)
-                last = starts[li+1]; // Otherwise use next start, if not the last label
+            double last = getStart(li) + 1.0/gFL->getFs(); // If not end, add a single sample to start
+            if(li<m_starts.size()-1)
+                last = getStart(li+1); // Otherwise use next start, if not the last label
             else {
                 if(gFL->ftsnds.size()>0)
                     last = gFL->getCurrentFTSound(true)->getLastSampleTime(); // Or last wav's sample time
             }
-            stream << int(fs*starts[li]) << " " << int(fs*last) << " " << waveform_labels[li]->toPlainText() << endl;
+            stream << int(fs*getStart(li)) << " " << int(fs*last) << " " << labels[li] << endl;
         }
     }
     else if(m_fileformat==FFTEXTSegmentsHTK){
@@ -686,20 +637,20 @@ void FTLabels::save() {
 
         QTextStream stream(&data);
         stream.setCodec(gMW->m_dlgSettings->ui->cbLabelsDefaultTextEncoding->currentText().toLatin1().constData());
-        for(size_t li=0; li<starts.size(); li++) {
+        for(size_t li=0; li<m_starts.size(); li++) {
             // If this is the last one AND its text is empty, skip it.
             // (thus, manage the read/write of segments files)
-            if(li==starts.size()-1 && waveform_labels[li]->toPlainText()=="")
+            if(li==m_starts.size()-1 && labels[li]=="")
                 continue;
 
-            double last = starts[li] + 1.0/gFL->getFs(); // If not end, add a single sample to start
-            if(li<starts.size()-1)
-                last = starts[li+1]; // Otherwise use next start, if not the last label
+            double last = getStart(li) + 1.0/gFL->getFs(); // If not end, add a single sample to start
+            if(li<m_starts.size()-1)
+                last = getStart(li+1); // Otherwise use next start, if not the last label
             else {
                 if(gFL->ftsnds.size()>0)
                     last = gFL->getCurrentFTSound(true)->getLastSampleTime(); // Or last wav's sample time
             }
-            stream << int(0.5+1e7*starts[li]) << " " << int(0.5+1e7*last) << " " << waveform_labels[li]->toPlainText() << endl;
+            stream << int(0.5+1e7*getStart(li)) << " " << int(0.5+1e7*last) << " " << labels[li] << endl;
         }
     }
     else if(m_fileformat==FFSDIF){
@@ -731,19 +682,19 @@ void FTLabels::save() {
             frameToWrite.AddMatrix(tmpMatrix);
             frameToWrite.Write(filew);
 
-            for(size_t li=0; li<starts.size(); li++) {
-                // cout << labels[li].toLatin1().constData() << ": " << starts[li] << ":" << ends[li] << endl;
+            for(size_t li=0; li<m_starts.size(); li++) {
+                // cout << labels[li].toLatin1().constData() << ": " << getStart(li) << ":" << ends[li] << endl;
 
                 // Prepare the frame
                 SDIFFrame frameToWrite;
                 /*set the header of the frame*/
                 frameToWrite.SetStreamID(0); // TODO Ok ??
-                frameToWrite.SetTime(starts[li]);
+                frameToWrite.SetTime(getStart(li));
                 frameToWrite.SetSignature("1MRK");
 
                 // Fill the matrix
                 SDIFMatrix tmpMatrix("1LAB");
-                tmpMatrix.Set(std::string(waveform_labels[li]->toPlainText().toLatin1().constData()));
+                tmpMatrix.Set(std::string(labels[li].toLatin1().constData()));
                 frameToWrite.AddMatrix(tmpMatrix);
 
                 frameToWrite.Write(filew);
@@ -778,7 +729,7 @@ void FTLabels::save() {
 
 QString FTLabels::info() const {
     QString str = FileType::info();
-    str += "Number of labels: " + QString::number(starts.size()) + "<br/>";
+    str += "Number of labels: " + QString::number(m_starts.size()) + "<br/>";
     return str;
 }
 
@@ -793,10 +744,97 @@ void FTLabels::fillContextMenu(QMenu& contextmenu) {
 
 double FTLabels::getLastSampleTime() const {
 
-    if(starts.empty())
+    if(m_starts.empty())
         return 0.0;
     else
-        return starts.back();
+        return m_starts.back()+m_offset;
+}
+
+// Indices of the labels to show in a view, at most one per pixel
+void FTLabels::visibleLabels(QGraphicsView* view, std::vector<int>& indices) const {
+    indices.clear();
+    if(m_starts.empty() || view->viewport()->width()<1)
+        return;
+
+    QRectF viewrect = view->mapToScene(view->viewport()->rect()).boundingRect();
+    double pixelwidth = viewrect.width()/view->viewport()->width();
+
+    // Start with the label preceding the view, since its text can overlap the view
+    std::vector<double>::const_iterator it = std::upper_bound(m_starts.begin(), m_starts.end(), viewrect.left()-m_offset);
+    if(it!=m_starts.begin())
+        --it;
+    while(it!=m_starts.end() && *it<=viewrect.right()-m_offset){
+        indices.push_back(int(it-m_starts.begin()));
+        // Skip the labels falling on the same pixel
+        it = std::lower_bound(it+1, m_starts.end(), *it+pixelwidth);
+    }
+}
+
+// Assign the items of a pool to the labels to show.
+// The items already showing one of these labels keep it (their text is up to date),
+// the others are free for the labels without item (-1 in items).
+static void recycleItems(const std::vector<int>& shown, const std::vector<int>& indices, std::vector<int>& items, std::deque<int>& freeitems) {
+    std::map<int,int> itemoflabel;
+    for(size_t k=0; k<shown.size(); ++k)
+        if(shown[k]>=0)
+            itemoflabel[shown[k]] = int(k);
+
+    items.assign(indices.size(), -1);
+    std::vector<bool> kept(shown.size(), false);
+    for(size_t n=0; n<indices.size(); ++n){
+        std::map<int,int>::iterator it = itemoflabel.find(indices[n]);
+        if(it!=itemoflabel.end()){
+            items[n] = it->second;
+            kept[it->second] = true;
+        }
+    }
+
+    freeitems.clear();
+    for(size_t k=0; k<shown.size(); ++k)
+        if(!kept[k])
+            freeitems.push_back(int(k));
+}
+
+// To call when all the labels' indices or texts have changed
+void FTLabels::invalidateItems(){
+    for(size_t k=0; k<m_waveform_labels.size(); ++k){
+        m_waveform_shown[k] = -1;
+        m_waveform_labels[k]->m_index = -1;
+        m_waveform_labels[k]->hide();
+        m_waveform_lines[k]->hide();
+    }
+    for(size_t k=0; k<m_spectrogram_labels.size(); ++k){
+        m_spectrogram_shown[k] = -1;
+        m_spectrogram_labels[k]->hide();
+        m_spectrogram_lines[k]->hide();
+    }
+}
+
+// Shift by delta the indices of the items showing the labels in [first,last]
+void FTLabels::shiftItems(int first, int last, int delta){
+    for(size_t k=0; k<m_waveform_labels.size(); ++k){
+        if(m_waveform_shown[k]>=first && m_waveform_shown[k]<=last){
+            m_waveform_shown[k] += delta;
+            m_waveform_labels[k]->m_index = m_waveform_shown[k];
+        }
+    }
+    for(size_t k=0; k<m_spectrogram_labels.size(); ++k)
+        if(m_spectrogram_shown[k]>=first && m_spectrogram_shown[k]<=last)
+            m_spectrogram_shown[k] += delta;
+}
+
+// Give the items showing the label index to the label newindex
+// (-1 frees them, the next update hides them)
+void FTLabels::reassignItems(int index, int newindex){
+    for(size_t k=0; k<m_waveform_labels.size(); ++k){
+        if(m_waveform_shown[k]==index){
+            m_waveform_shown[k] = newindex;
+            m_waveform_labels[k]->m_index = newindex;
+        }
+    }
+    for(size_t k=0; k<m_spectrogram_labels.size(); ++k)
+        if(m_spectrogram_shown[k]==index)
+            m_spectrogram_shown[k] = newindex;
 }
 
 void FTLabels::updateTextsGeometryWaveform(){
@@ -804,20 +842,75 @@ void FTLabels::updateTextsGeometryWaveform(){
 
     if(!m_actionShow->isChecked())
         return;
+    if(FTGraphicsLabelItem::isEditing())
+        return; // Do not recycle the item under edition
 
     QRectF waveform_viewrect = gMW->m_gvWaveform->mapToScene(gMW->m_gvWaveform->viewport()->rect()).boundingRect();
     QTransform waveform_trans = gMW->m_gvWaveform->transform();
 
-    for(size_t u=0; u<starts.size(); ++u){
+    std::vector<int> indices, items;
+    std::deque<int> freeitems;
+    visibleLabels(gMW->m_gvWaveform, indices);
+    recycleItems(m_waveform_shown, indices, items, freeitems);
+
+    double lastsampletime = gFL->getMaxLastSampleTime();
+
+    for(size_t n=0; n<indices.size(); ++n){
+        int u = indices[n];
+        int k = items[n];
+
+        if(k==-1){
+            if(freeitems.empty()){
+                // Grow the pool
+                QPen pen(getColor());
+                pen.setWidth(0);
+                FTGraphicsLabelItem* label = new FTGraphicsLabelItem(this, "");
+                label->setDefaultTextColor(getColor());
+                if(gMW->ui->actionEditMode->isChecked())
+                    label->setTextInteractionFlags(Qt::TextEditorInteraction);
+                else
+                    label->setTextInteractionFlags(Qt::NoTextInteraction);
+                gMW->m_gvWaveform->m_scene->addItem(label);
+                m_waveform_labels.push_back(label);
+                QGraphicsLineItem* line = new QGraphicsLineItem(0, -1, 0, 1);
+                line->setPen(pen);
+                gMW->m_gvWaveform->m_scene->addItem(line);
+                m_waveform_lines.push_back(line);
+                m_waveform_shown.push_back(-1);
+                k = int(m_waveform_labels.size())-1;
+            }
+            else{
+                k = freeitems.front();
+                freeitems.pop_front();
+            }
+            m_waveform_shown[k] = u;
+            m_waveform_labels[k]->m_index = u;
+            m_waveform_labels[k]->setPlainText(labels[u]);
+            m_waveform_labels[k]->setToolTip(fulltexts[u]);
+        }
+
+        FTGraphicsLabelItem* label = m_waveform_labels[k];
+        label->setPos(getStart(u), 0);
+        m_waveform_lines[k]->setPos(getStart(u), 0);
 
         double x = 0.0;
-        if(starts[u]>gFL->getMaxLastSampleTime()-24.0/waveform_trans.m11())
-            x = -(waveform_labels[u]->boundingRect().width()-4)/waveform_trans.m11();
+        if(getStart(u)>lastsampletime-24.0/waveform_trans.m11())
+            x = -(label->boundingRect().width()-4)/waveform_trans.m11();
 
         QTransform mat1;
         mat1.translate(x-2.0/waveform_trans.m11(), waveform_viewrect.top()+10.0/waveform_trans.m22());
         mat1.scale(1.0/waveform_trans.m11(), 1.0/waveform_trans.m22());
-        waveform_labels[u]->setTransform(mat1);
+        label->setTransform(mat1);
+        label->show();
+        m_waveform_lines[k]->show();
+    }
+
+    // Hide the items left
+    for(size_t f=0; f<freeitems.size(); ++f){
+        m_waveform_shown[freeitems[f]] = -1;
+        m_waveform_labels[freeitems[f]]->m_index = -1;
+        m_waveform_labels[freeitems[f]]->hide();
+        m_waveform_lines[freeitems[f]]->hide();
     }
 }
 
@@ -830,89 +923,154 @@ void FTLabels::updateTextsGeometrySpectrogram(){
     QRectF spectrogram_viewrect = gMW->m_gvSpectrogram->mapToScene(gMW->m_gvSpectrogram->viewport()->rect()).boundingRect();
     QTransform spectrogram_trans = gMW->m_gvSpectrogram->transform();
 
-    for(size_t u=0; u<starts.size(); ++u){
+    std::vector<int> indices, items;
+    std::deque<int> freeitems;
+    visibleLabels(gMW->m_gvSpectrogram, indices);
+    recycleItems(m_spectrogram_shown, indices, items, freeitems);
+
+    double lastsampletime = gFL->getMaxLastSampleTime();
+
+    for(size_t n=0; n<indices.size(); ++n){
+        int u = indices[n];
+        int k = items[n];
+
+        if(k==-1){
+            if(freeitems.empty()){
+                // Grow the pool
+                QPen pen(getColor());
+                pen.setWidth(0);
+                QGraphicsSimpleTextItem* label = new QGraphicsSimpleTextItem();
+                label->setBrush(QBrush(getColor()));
+                gMW->m_gvSpectrogram->m_scene->addItem(label);
+                m_spectrogram_labels.push_back(label);
+                QGraphicsLineItem* line = new QGraphicsLineItem(0, 0, 0, -0.5*gFL->getFs());
+                line->setPen(pen);
+                gMW->m_gvSpectrogram->m_scene->addItem(line);
+                m_spectrogram_lines.push_back(line);
+                m_spectrogram_shown.push_back(-1);
+                k = int(m_spectrogram_labels.size())-1;
+            }
+            else{
+                k = freeitems.front();
+                freeitems.pop_front();
+            }
+            m_spectrogram_shown[k] = u;
+            m_spectrogram_labels[k]->setText(labels[u]);
+            m_spectrogram_labels[k]->setToolTip(fulltexts[u]);
+        }
+
+        QGraphicsSimpleTextItem* label = m_spectrogram_labels[k];
+        label->setPos(getStart(u), 0);
+        m_spectrogram_lines[k]->setPos(getStart(u), 0);
 
         double x = 0.0;
-        if(starts[u]>gFL->getMaxLastSampleTime()-24.0/spectrogram_trans.m11())
-            x = -(spectrogram_labels[u]->boundingRect().width()-4)/spectrogram_trans.m11();
+        if(getStart(u)>lastsampletime-24.0/spectrogram_trans.m11())
+            x = -(label->boundingRect().width()-4)/spectrogram_trans.m11();
 
         QTransform mat2;
         mat2.translate(x+2.0/spectrogram_trans.m11(), spectrogram_viewrect.top()+10.0/spectrogram_trans.m22());
         mat2.scale(1.0/spectrogram_trans.m11(), 1.0/spectrogram_trans.m22());
-        spectrogram_labels[u]->setTransform(mat2);
+        label->setTransform(mat2);
+        label->show();
+        m_spectrogram_lines[k]->show();
+    }
+
+    // Hide the items left
+    for(size_t f=0; f<freeitems.size(); ++f){
+        m_spectrogram_shown[freeitems[f]] = -1;
+        m_spectrogram_labels[freeitems[f]]->hide();
+        m_spectrogram_lines[freeitems[f]]->hide();
     }
 }
 
-void FTLabels::addLabel(double position, const QString& text, QString showntxt){
-    if(showntxt.isEmpty())
-        showntxt = text;
+int FTLabels::findLabel(double t) const {
+    return int(std::upper_bound(m_starts.begin(), m_starts.end(), t-m_offset)-m_starts.begin())-1;
+}
 
-    QPen pen(getColor());
-    pen.setWidth(0);
-    QBrush brush(getColor());
+void FTLabels::appendLabel(double position, const QString& text, const QString& showntxt){
+    m_starts.push_back(position-m_offset);
+    labels.push_back(showntxt.isEmpty()?text:showntxt);
+    fulltexts.push_back(text);
+}
 
-    starts.push_back(position);
+// Returns the index of the new label
+int FTLabels::addLabel(double position, const QString& text, QString showntxt){
+    if(showntxt.isEmpty())
+        showntxt = text;
 
-    waveform_labels.push_back(new FTGraphicsLabelItem(this, showntxt));
-    waveform_labels.back()->setPos(position, 0);
-    waveform_labels.back()->setDefaultTextColor(getColor());
-    waveform_labels.back()->setToolTip(text);
-    if(gMW->ui->actionEditMode->isChecked())
-        waveform_labels.back()->setTextInteractionFlags(Qt::TextEditable);
-    else
-        waveform_labels.back()->setTextInteractionFlags(Qt::NoTextInteraction);
-    gMW->m_gvWaveform->m_scene->addItem(waveform_labels.back());
-
-    spectrogram_labels.push_back(new QGraphicsSimpleTextItem(showntxt));
-    spectrogram_labels.back()->setPos(position, 0);
-    spectrogram_labels.back()->setBrush(brush);
-    spectrogram_labels.back()->setToolTip(text);
-    gMW->m_gvSpectrogram->m_scene->addItem(spectrogram_labels.back());
-    // TODO set Brush and pen for the outline!
-
-    waveform_lines.push_back(new QGraphicsLineItem(0, -1, 0, 1));
-    waveform_lines.back()->setPos(position, 0);
-    waveform_lines.back()->setPen(pen);
-    gMW->m_gvWaveform->m_scene->addItem(waveform_lines.back());
-
-    spectrogram_lines.push_back(new QGraphicsLineItem(0, 0, 0, -0.5*gFL->getFs()));
-    spectrogram_lines.back()->setPos(position, 0);
-    spectrogram_lines.back()->setPen(pen);
-    gMW->m_gvSpectrogram->m_scene->addItem(spectrogram_lines.back());    
+    // Insert it in place, after the labels at the same position
+    int index = findLabel(position)+1;
+    m_starts.insert(m_starts.begin()+index, position-m_offset);
+    labels.insert(labels.begin()+index, showntxt);
+    fulltexts.insert(fulltexts.begin()+index, text);
+    shiftItems(index, getNbLabels(), +1);
 
-    sort();
+    updateTextsGeometryWaveform();
+    updateTextsGeometrySpectrogram();
 
     m_is_edited = true;
     setStatus();
+
+    return index;
 }
 
-void FTLabels::moveLabel(int index, double position){
-    starts[index] = position;
-    waveform_lines[index]->setPos(position, 0);
-    waveform_labels[index]->setPos(position, 0);
-    spectrogram_lines[index]->setPos(position, 0);
-    spectrogram_labels[index]->setPos(position, 0);
+// Keeps the labels sorted, by moving the label among its new neighbors.
+// Returns the new index of the label.
+int FTLabels::moveLabel(int index, double position){
+    double t = position-m_offset;
+
+    int newindex = sortedMoveIndex(m_starts, index, t);
+    sortedMove(m_starts, index, newindex);
+    sortedMove(labels, index, newindex);
+    sortedMove(fulltexts, index, newindex);
+
+    if(newindex<index){
+        reassignItems(index, -2);
+        shiftItems(newindex, index-1, +1);
+        reassignItems(-2, newindex);
+    }
+    else if(newindex>index){
+        reassignItems(index, -2);
+        shiftItems(index+1, newindex, -1);
+        reassignItems(-2, newindex);
+    }
+    m_starts[newindex] = t;
+
+    updateTextsGeometryWaveform();
+    updateTextsGeometrySpectrogram();
 
     m_is_edited = true;
     setStatus();
+
+    return newindex;
 }
+
+// The labels keep their times, only the offset applied when showing and saving them changes
 void FTLabels::moveAllLabel(double delay){
 //    COUTD << "FTLabels::moveAllLabel " << delay << endl;
-    for(size_t u=0; u<starts.size(); ++u){
-        starts[u] += delay;
-        waveform_lines[u]->setPos(waveform_lines[u]->pos().x()+delay, 0);
-        waveform_labels[u]->setPos(waveform_labels[u]->pos().x()+delay, 0);
-        spectrogram_lines[u]->setPos(spectrogram_lines[u]->pos().x()+delay, 0);
-        spectrogram_labels[u]->setPos(spectrogram_labels[u]->pos().x()+delay, 0);
-    }
+    m_offset += delay;
+
+    updateTextsGeometryWaveform();
+    updateTextsGeometrySpectrogram();
+
     m_is_edited = true;
     setStatus();
 }
 
 
 void FTLabels::changeText(int index, const QString& text){
-    waveform_labels[index]->setPlainText(text);
-    spectrogram_labels[index]->setText(text);
+    labels[index] = text;
+
+    // Only the items showing this label need the new text
+    for(size_t k=0; k<m_waveform_labels.size(); ++k)
+        if(m_waveform_shown[k]==index && m_waveform_labels[k]->toPlainText()!=text)
+            m_waveform_labels[k]->setPlainText(text);
+    for(size_t k=0; k<m_spectrogram_labels.size(); ++k)
+        if(m_spectrogram_shown[k]==index)
+            m_spectrogram_labels[k]->setText(text);
+
+    updateTextsGeometryWaveform();
+    updateTextsGeometrySpectrogram();
 
     m_is_edited = true;
     setStatus();
@@ -926,13 +1084,8 @@ void FTLabels::setVisible(bool shown){
         updateTextsGeometryWaveform();
         updateTextsGeometrySpectrogram();
     }
-
-    for(size_t u=0; u<starts.size(); ++u){
-        waveform_labels[u]->setVisible(shown);
-        spectrogram_labels[u]->setVisible(shown);
-        waveform_lines[u]->setVisible(shown);
-        spectrogram_lines[u]->setVisible(shown);
-    }
+    else
+        invalidateItems();
 }
 void FTLabels::setColor(const QColor& color) {
     FileType::setColor(color);
@@ -941,31 +1094,35 @@ void FTLabels::setColor(const QColor& color) {
     pen.setWidth(0);
     QBrush brush(getColor());
 
-    for(size_t u=0; u<starts.size(); ++u){
-        waveform_labels[u]->setDefaultTextColor(getColor());
-        spectrogram_labels[u]->setBrush(brush);
-        waveform_lines[u]->setPen(pen);
-        spectrogram_lines[u]->setPen(pen);
+    for(size_t k=0; k<m_waveform_labels.size(); ++k){
+        m_waveform_labels[k]->setDefaultTextColor(getColor());
+        m_waveform_lines[k]->setPen(pen);
+    }
+    for(size_t k=0; k<m_spectrogram_labels.size(); ++k){
+        m_spectrogram_labels[k]->setBrush(brush);
+        m_spectrogram_lines[k]->setPen(pen);
     }
 }
 
-void FTLabels::removeLabel(int index){
+void FTLabels::setEditable(bool editable){
+    for(size_t k=0; k<m_waveform_labels.size(); ++k){
+        if(editable)
+            m_waveform_labels[k]->setTextInteractionFlags(Qt::TextEditorInteraction);
+        else
+            m_waveform_labels[k]->setTextInteractionFlags(Qt::NoTextInteraction);
+    }
+}
 
-    starts.erase(starts.begin()+index);
+void FTLabels::removeLabel(int index){
 
-    QGraphicsTextItem* labeltoremove = *(waveform_labels.begin()+index);
-    waveform_labels.erase(waveform_labels.begin()+index);
-    delete labeltoremove;
-    QGraphicsSimpleTextItem* labelsimpletoremove = *(spectrogram_labels.begin()+index);
-    spectrogram_labels.erase(spectrogram_labels.begin()+index);
-    delete labelsimpletoremove;
+    m_starts.erase(m_starts.begin()+index);
+    labels.erase(labels.begin()+index);
+    fulltexts.erase(fulltexts.begin()+index);
+    reassignItems(index, -1);
+    shiftItems(index+1, getNbLabels(), -1);
 
-    QGraphicsLineItem* linetoremove = *(waveform_lines.begin()+index);
-    waveform_lines.erase(waveform_lines.begin()+index);
-    delete linetoremove;
-    linetoremove = *(spectrogram_lines.begin()+index);
-    spectrogram_lines.erase(spectrogram_lines.begin()+index);
-    delete linetoremove;
+    updateTextsGeometryWaveform();
+    updateTextsGeometrySpectrogram();
 
     m_is_edited = true;
     setStatus();
@@ -973,7 +1130,7 @@ void FTLabels::removeLabel(int index){
 
 
 // Sorting functions
-// (used for writing the files with ascending times)
+// (used once after loading, the edits keep the labels sorted)
 
 template <typename Container>
 struct compare_indirect_index
@@ -988,40 +1145,27 @@ struct compare_indirect_index
 void FTLabels::sort(){
 //    cout << "FTLabels::sort" << endl;
 
-//    cout << "unsorted starts: ";
-//    for(size_t u=0; u<starts.size(); ++u)
-//        cout << starts[u] << " ";
-//    cout << endl;
-
-    vector<size_t> indices(starts.size(), 0);
+    vector<size_t> indices(m_starts.size(), 0);
     for(size_t u=0; u<indices.size(); ++u)
         indices[u] = u;
 
-    std::sort(indices.begin(), indices.end(), compare_indirect_index < std::deque<double> >(starts));
-
-    std::deque<double> sorted_starts(starts.size());
-    std::deque<FTGraphicsLabelItem*> sorted_waveform_labels(waveform_labels.size());
-    std::deque<QGraphicsSimpleTextItem*> sorted_spectrogram_labels(spectrogram_labels.size());
-    std::deque<QGraphicsLineItem*> sorted_waveform_lines(starts.size());
-    std::deque<QGraphicsLineItem*> sorted_spectrogram_lines(starts.size());
-    for(size_t u=0; u<starts.size(); ++u){
-        sorted_starts[u] = starts[indices[u]];
-        sorted_waveform_labels[u] = waveform_labels[indices[u]];
-        sorted_spectrogram_labels[u] = spectrogram_labels[indices[u]];
-        sorted_waveform_lines[u] = waveform_lines[indices[u]];
-        sorted_spectrogram_lines[u] = spectrogram_lines[indices[u]];
+    // Stable, so that labels at the same time keep their order
+    std::stable_sort(indices.begin(), indices.end(), compare_indirect_index < std::vector<double> >(m_starts));
+
+    std::vector<double> sorted_starts(m_starts.size());
+    std::vector<QString> sorted_labels(m_starts.size());
+    std::vector<QString> sorted_fulltexts(m_starts.size());
+    for(size_t u=0; u<m_starts.size(); ++u){
+        sorted_starts[u] = m_starts[indices[u]];
+        sorted_labels[u] = labels[indices[u]];
+        sorted_fulltexts[u] = fulltexts[indices[u]];
     }
 
-    starts = sorted_starts;
-    waveform_labels = sorted_waveform_labels;
-    spectrogram_labels = sorted_spectrogram_labels;
-    waveform_lines = sorted_waveform_lines;
-    spectrogram_lines = sorted_spectrogram_lines;
+    m_starts.swap(sorted_starts);
+    labels.swap(sorted_labels);
+    fulltexts.swap(sorted_fulltexts);
 
-//    cout << "sorted starts: ";
-//    for(size_t u=0; u<starts.size(); ++u)
-//        cout << starts[u] << " ";
-//    cout << endl;
+    invalidateItems();
 
     //    cout << "FTLabels::~sort" << endl;
 }
@@ -1039,14 +1183,14 @@ QString FTLabels::extractCenterLabel(const QString &txt) {
 FTLabels::~FTLabels() {
     clear();
 
-    for(size_t li=0; li<waveform_labels.size(); ++li)
-        delete waveform_labels[li];
-    for(size_t li=0; li<spectrogram_labels.size(); ++li)
-        delete spectrogram_labels[li];
-    for(size_t li=0; li<waveform_lines.size(); ++li)
-        delete waveform_lines[li];
-    for(size_t li=0; li<spectrogram_lines.size(); ++li)
-        delete spectrogram_lines[li];
+    for(size_t k=0; k<m_waveform_labels.size(); ++k)
+        delete m_waveform_labels[k];
+    for(size_t k=0; k<m_waveform_lines.size(); ++k)
+        delete m_waveform_lines[k];
+    for(size_t k=0; k<m_spectrogram_labels.size(); ++k)
+        delete m_spectrogram_labels[k];
+    for(size_t k=0; k<m_spectrogram_lines.size(); ++k)
+        delete m_spectrogram_lines[k];
 
     gFL->ftlabels.erase(std::find(gFL->ftlabels.begin(), gFL->ftlabels.end(), this));
 
@@ -1101,21 +1245,22 @@ void FTLabels::estimate(FTFZero *ftfzero, double tstart, double tend) {
 
         bool voiced = m_src_fzero->f0s[0]>0;
         if(voiced)
-            addLabel(m_src_fzero->ts[0], "V");
+            appendLabel(m_src_fzero->ts[0], "V", "V");
         else
-            addLabel(m_src_fzero->ts[0], "U");
+            appendLabel(m_src_fzero->ts[0], "U", "U");
 
         for(size_t n=1; n<m_src_fzero->ts.size(); ++n){
 //            COUTD << m_src_fzero->ts[n] << ": " << m_src_fzero->f0s[n] << std::endl;
             bool curvoiced = m_src_fzero->f0s[n]>0;
             if(!voiced && curvoiced)
-                addLabel(0.5*(m_src_fzero->ts[n-1]+m_src_fzero->ts[n]), "V");
+                appendLabel(0.5*(m_src_fzero->ts[n-1]+m_src_fzero->ts[n]), "V", "V");
             if(voiced && !curvoiced)
-                addLabel(0.5*(m_src_fzero->ts[n-1]+m_src_fzero->ts[n]), "U");
+                appendLabel(0.5*(m_src_fzero->ts[n-1]+m_src_fzero->ts[n]), "U", "U");
             voiced = curvoiced;
         }
     }
 
+    sort();
     updateTextsGeometryWaveform();
     updateTextsGeometrySpectrogram();
 
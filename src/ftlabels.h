@@ -34,6 +34,7 @@ file provided in the source code of DFasma. Another copy can be found at
 
 class QGraphicsSimpleTextItem;
 class QGraphicsLineItem;
+class QGraphicsView;
 class FTLabels;
 class FTFZero;
 
@@ -44,6 +45,8 @@ class FTGraphicsLabelItem : public QGraphicsTextItem
     QString m_prevText;
 
 public:
+    int m_index; // Index of the label currently shown by this item
+
     FTGraphicsLabelItem(FTLabels* ftl, const QString & text);
     FTGraphicsLabelItem(FTGraphicsLabelItem* ftgi, FTLabels* ftl); // copy ctor
 
@@ -72,6 +75,24 @@ private:
     void load();
     void sort(); // For keeping files in ascending order
     QString extractCenterLabel(const QString& txt);
+    void appendLabel(double position, const QString& text, const QString& showntxt); // For loading, sort() afterwards
+
+    // The times of the labels, sorted, without the offset of moveAllLabel
+    std::vector<double> m_starts;
+    double m_offset;
+
+    // Only the labels visible in the views have graphics items,
+    // which are taken from pools and recycled when the views change.
+    std::vector<FTGraphicsLabelItem*> m_waveform_labels;
+    std::vector<QGraphicsLineItem*> m_waveform_lines;
+    std::vector<int> m_waveform_shown;    // Label shown by each item of the pool (-1 if unused)
+    std::vector<QGraphicsSimpleTextItem*> m_spectrogram_labels;
+    std::vector<QGraphicsLineItem*> m_spectrogram_lines;
+    std::vector<int> m_spectrogram_shown; // Label shown by each item of the pool (-1 if unused)
+    void visibleLabels(QGraphicsView* view, std::vector<int>& indices) const;
+    void invalidateItems();
+    void shiftItems(int first, int last, int delta);
+    void reassignItems(int index, int newindex);
 
     QAction* m_actionSave;
     QAction* m_actionSaveAs;
@@ -84,11 +105,11 @@ public:
     FTLabels(const QString& _fileName, QObject* parent, FileType::FileContainer container=FileType::FCUNSET, FileFormat fileformat=FFNotSpecified);
     virtual FileType* duplicate();
 
-    std::deque<double> starts; // TODO Get ride of ?
-    std::deque<FTGraphicsLabelItem*> waveform_labels;
-    std::deque<QGraphicsSimpleTextItem*> spectrogram_labels;
-    std::deque<QGraphicsLineItem*> waveform_lines;
-    std::deque<QGraphicsLineItem*> spectrogram_lines;
+    // The labels, sorted by time
+    double getStart(int index) const             {return m_starts[index]+m_offset;}
+    std::vector<QString> labels;    // The shown texts (the ones saved)
+    std::vector<QString> fulltexts; // The texts as read (shown as tool tips)
+    int findLabel(double t) const; // Index of the last label starting before or at t (-1 if none)
 
     virtual QString info() const;
     virtual double getLastSampleTime() const;
@@ -96,12 +117,12 @@ public:
     void updateTextsGeometryWaveform();
     void updateTextsGeometrySpectrogram();
 
-    int getNbLabels() const                      {return int(starts.size());}
-    void moveLabel(int index, double position);
+    int getNbLabels() const                      {return int(m_starts.size());}
+    int moveLabel(int index, double position);
     void moveAllLabel(double delay);
-    void finishEditing()                         {sort();}
     void changeText(int index, const QString& text);
     void setColor(const QColor& _color);
+    void setEditable(bool editable);
 
     ~FTLabels();
 
@@ -117,7 +138,7 @@ public slots:
     void saveAs();
     void clear();
     void removeLabel(int index);
-    void addLabel(double position, const QString& text, QString showntxt="");
+    int addLabel(double position, const QString& text, QString showntxt="");
     void setVisible(bool shown);
 };
 
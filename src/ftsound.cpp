@@ -27,11 +27,13 @@ using namespace std;
 
 #include <qmath.h>
 #include <qendian.h>
+#include <cstring>
 #include <QMenu>
 #include <QMessageBox>
 #include <QFileInfo>
 #include <QGraphicsRectItem>
 #include <QProgressDialog>
+#include <QThread>
 #include "wmainwindow.h"
 #include "ui_wmainwindow.h"
 #include "gvspectrumamplitude.h"
@@ -40,20 +42,25 @@ using namespace std;
 #include "gvwaveform.h"
 #include "qaesigproc.h"
 #include "qaehelpers.h"
+#include "polyphaseresampler.h"
+#include "biquadcascade.h"
+#include "stftmasking.h"
 
 #include "../external/libqaudioextra/external/mkfilter/mkfilter.h"
 
 #include "ui_wdialogsettings.h"
 #include "gvspectrogram.h"
+#include "../external/audioengine/audioengine.h"
 #include "gvspectrogramwdialogsettings.h"
 #include "ui_gvspectrogramwdialogsettings.h"
 
 bool FTSound::s_playwin_use = false;
+QAtomicInt FTSound::s_playloop(0);
 std::vector<WAVTYPE> FTSound::s_avoidclickswindow;
 
 double FTSound::s_fs_common = 0; // Initially, fs is undefined
 WAVTYPE FTSound::s_play_power = 0;
-std::deque<WAVTYPE> FTSound::s_play_power_values;
+SlidingWindowMaximum FTSound::s_play_power_values;
 
 FTSound::DFTParameters::DFTParameters(unsigned int _nl, unsigned int _nr, int _winlen, int _wintype, int _normtype, const std::vector<FFTTYPE>& _win, int _dftlen, std::vector<FFTTYPE>*_wav, qreal _ampscale, qint64 _delay){
     clear();
@@ -124,16 +131,30 @@ void FTSound::constructor_internal() {
     m_imgSTFT.fill(Qt::white);
 
     m_giWavForWaveform = NULL;
+    m_giWavFilteredForWaveform = NULL;
+    m_giWavForSpectrumAmplitude = NULL;
+    m_giWavForSpectrumPhase = NULL;
+    m_giWavForSpectrumGroupDelay = NULL;
     m_channelid = 0;
     m_isclipped = false;
+    m_isloadingdeferred = false;
     m_isfiltered = false;
     m_isplaying = false;
-    wavtoplay  = &wav;
+    m_reloadsnd = NULL;
+    m_reloadthread = NULL;
+    fsoriginal = 0.0;
+    m_wavdigestdelay = 0.0;
     m_filteredmaxamp = 0.0;
+    m_filteredstart = 0;
+    m_filteredend = -1;
     m_start = 0;
     m_pos = 0;
     m_end = 0;
+    m_playgain = 1.0;
+    m_playdelay = 0;
     m_avoidclickswinpos = 0;
+    m_looptailpos = 0;
+    m_looptailfadepos = std::numeric_limits<qint64>::max();
 
     m_stftpa = NULL;
     m_stft_min = std::numeric_limits<FFTTYPE>::infinity();
@@ -150,6 +171,18 @@ void FTSound::constructor_internal() {
     m_actionInvPolarity->setChecked(false);
     connect(m_actionInvPolarity, SIGNAL(triggered()), this, SLOT(inversePolarity()));
 
+    m_actionsPan = new QActionGroup(this);
+    m_actionPanLeft = new QAction("Left", m_actionsPan);
+    m_actionPanLeft->setStatusTip(tr("Play the sound in the left channel when mixing sounds"));
+    m_actionPanLeft->setCheckable(true);
+    m_actionPanCenter = new QAction("Center", m_actionsPan);
+    m_actionPanCenter->setStatusTip(tr("Play the sound in both channels when mixing sounds"));
+    m_actionPanCenter->setCheckable(true);
+    m_actionPanCenter->setChecked(true);
+    m_actionPanRight = new QAction("Right", m_actionsPan);
+    m_actionPanRight->setStatusTip(tr("Play the sound in the right channel when mixing sounds"));
+    m_actionPanRight->setCheckable(true);
+
     m_actionResetAmpScale = new QAction("Reset amplitude", this);
     m_actionResetAmpScale->setStatusTip(tr("Reset the amplitude scaling to 1"));
     connect(m_actionResetAmpScale, SIGNAL(triggered()), this, SLOT(needDFTUpdate()));
@@ -178,11 +211,17 @@ void FTSound::constructor_external() {
     QPen pen(getColor());
     pen.setWidth(0);
 
-    m_giWavForWaveform = new QAEGIUniformlySampledSignal(wavtoplay, fs, gMW->m_gvWaveform);
+    m_giWavForWaveform = new QAEGIUniformlySampledSignal(&wav, fs, gMW->m_gvWaveform);
     m_giWavForWaveform->setPen(pen);
     m_giWavForWaveform->setClip(-1.0, 1.0);
     gMW->m_gvWaveform->m_scene->addItem(m_giWavForWaveform);
 
+    m_giWavFilteredForWaveform = new QAEGIUniformlySampledSignal(&wavfiltered, fs, gMW->m_gvWaveform);
+    m_giWavFilteredForWaveform->setPen(pen);
+    m_giWavFilteredForWaveform->setClip(-1.0, 1.0);
+    m_giWavFilteredForWaveform->setVisible(false);
+    gMW->m_gvWaveform->m_scene->addItem(m_giWavFilteredForWaveform);
+
     m_giWavForSpectrumAmplitude = new QAEGIUniformlySampledSignal(&m_dftamp, 1.0, gMW->m_gvSpectrumAmplitude);
     m_giWavForSpectrumAmplitude->setPen(pen);
     gMW->m_gvSpectrumAmplitude->m_scene->addItem(m_giWavForSpectrumAmplitude);
@@ -198,12 +237,20 @@ void FTSound::constructor_external() {
     gMW->m_gvSpectrumGroupDelay->m_scene->addItem(m_giWavForSpectrumGroupDelay);
 }
 
-FTSound::FTSound(const QString& _fileName, QObject *parent, int channelid)
+FTSound::FTSound(const QString& _fileName, QObject *parent, int channelid, bool deferload)
     : QIODevice(parent)
     , FileType(FTSOUND, _fileName, this)
 {
     FTSound::constructor_internal();
 
+    if(deferload){
+        // The data will be loaded by loadDeferred() and the sound attached by attachDeferred()
+        m_isloadingdeferred = true;
+        m_channelid = channelid;
+        checkFileStatus(CFSMEXCEPTION);
+        return;
+    }
+
     if(!fileFullPath.isEmpty()){
         checkFileStatus(CFSMEXCEPTION);
         try{
@@ -231,6 +278,7 @@ FTSound::FTSound(const FTSound& ft)
 
     wav = ft.wav;
     fs = ft.fs;
+    fsoriginal = ft.fsoriginal;
     m_fileaudioformat.setSampleRate(fs);
     m_fileaudioformat.setSampleType(QAudioFormat::Float);
     m_fileaudioformat.setSampleSize(8*sizeof(WAVTYPE));
@@ -243,12 +291,32 @@ FTSound::FTSound(const FTSound& ft)
     FTSound::constructor_external();
 }
 
+void FTSound::loadDeferred() {
+    try{
+        load(m_channelid);
+    }
+    catch(std::bad_alloc err){
+        wav.clear();
+        throw QString("There is not enough free memory to hold this file!");
+    }
+}
+
+void FTSound::attachDeferred() {
+    m_isloadingdeferred = false;
+    setSamplingRate(fs); // The common sampling rate couldn't be accessed in the workers
+    load_finalize();
+    FTSound::constructor_external();
+}
+
 void FTSound::load_finalize() {
     if(s_avoidclickswindow.size()==0)
         FTSound::setAvoidClicksWindowDuration(gMW->m_dlgSettings->ui->sbPlaybackAvoidClicksWindowDuration->value());
 
 //    std::cout << "INFO: " << wav.size() << " samples loaded (" << wav.size()/fs << "s max amplitude=" << m_wavmaxamp << ")" << endl;
 
+    if(fs!=s_fs_common)
+        resampleToCommonRate();
+
     m_giSQNRForSpectrumAmplitude->setPos(0.0, 20*std::log10(std::pow(2.0,m_fileaudioformat.sampleSize())));
 
     m_lastreadtime = QDateTime::currentDateTime();
@@ -259,6 +327,7 @@ void FTSound::load_finalize() {
 void FTSound::setVisible(bool shown){
     FileType::setVisible(shown);
     m_giWavForWaveform->setVisible(shown);
+    m_giWavFilteredForWaveform->setVisible(shown && m_isfiltered);
     m_giWavForSpectrumAmplitude->setVisible(shown);
     m_giWavForSpectrumPhase->setVisible(shown);
     m_giWavForSpectrumGroupDelay->setVisible(shown);
@@ -287,6 +356,7 @@ void FTSound::setColor(const QColor &_color){
     QPen pen(getColor());
     pen.setWidth(0);
     m_giWavForWaveform->setPen(pen);
+    m_giWavFilteredForWaveform->setPen(pen);
     m_giWavForSpectrumAmplitude->setPen(pen);
     m_giWavForSpectrumPhase->setPen(pen);
     m_giWavForSpectrumGroupDelay->setPen(pen);
@@ -295,6 +365,7 @@ void FTSound::setColor(const QColor &_color){
 
 void FTSound::zposReset(){
     m_giWavForWaveform->setZValue(0.0);
+    m_giWavFilteredForWaveform->setZValue(0.0);
     m_giWavForSpectrumAmplitude->setZValue(0.0);
     m_giWavForSpectrumPhase->setZValue(0.0);
     m_giWavForSpectrumGroupDelay->setZValue(0.0);
@@ -302,61 +373,149 @@ void FTSound::zposReset(){
 }
 void FTSound::zposBringForward(){
     m_giWavForWaveform->setZValue(1.0);
+    m_giWavFilteredForWaveform->setZValue(1.0);
     m_giWavForSpectrumAmplitude->setZValue(1.0);
     m_giWavForSpectrumPhase->setZValue(1.0);
     m_giWavForSpectrumGroupDelay->setZValue(1.0);
     m_giSQNRForSpectrumAmplitude->setZValue(1.0);
 }
 
+// Decode the file in the background, in a temporary sound
+class FTSoundReloadThread : public QThread
+{
+    FTSound* m_tmpsnd;
+    const FTSound* m_loadedsnd; // Not modified until the thread finishes
+
+    void run() {
+        try{
+            // If samples have only been appended to the file, decode only these ones
+            m_appended = m_tmpsnd->loadAppended(*m_loadedsnd);
+            if(!m_appended)
+                m_tmpsnd->loadDeferred();
+        }
+        catch(std::bad_alloc err){
+            m_error = "There is not enough free memory for re-loading this file!";
+        }
+        catch(QString err){
+            m_error = err;
+        }
+    }
+
+public:
+    FTSoundReloadThread(FTSound* tmpsnd, const FTSound* loadedsnd, QObject* parent)
+        : QThread(parent)
+        , m_tmpsnd(tmpsnd)
+        , m_loadedsnd(loadedsnd)
+        , m_appended(false)
+    {}
+
+    QString m_error;
+    bool m_appended; // The temporary sound holds only the samples appended to the loaded ones
+};
+
 bool FTSound::reload() {
 //    COUTD << "FTSound::reload" << endl;
 
+    if(m_reloadthread) // Already reloading
+        return false;
+
+    // The playback thread reads the samples
+    if(m_isplaying)
+        gMW->m_audioengine->stopPlayback();
     stopPlay();
     gMW->m_gvSpectrogram->m_stftcomputethread->cancelComputation(this);
 
     if(!checkFileStatus(CFSMMESSAGEBOX))
         return false;
 
-    // Reset everything ...
-    wavtoplay = &wav;
-    m_giWavForWaveform->setSignal(wavtoplay);
-//    m_ampscale = 1.0;
-//    m_delay = 0;
-    m_start = 0;
-    m_pos = 0;
-    m_end = 0;
-    m_avoidclickswinpos = 0;
-    wav.clear();
-    wavfiltered.clear();
-    setFiltered(false);
-    gMW->m_gvSpectrogram->m_stftcomputethread->m_mutex_changingstft.lock();
-//    m_stft.clear();
-    if(m_stftpa){
-        delete m_stftpa;
-        m_stftpa = NULL;
-    }
-    m_stftts.clear();
-    gMW->m_gvSpectrogram->m_stftcomputethread->m_mutex_changingstft.unlock();
-    m_imgSTFTParams.clear();
-    m_stftparams.clear();
+    // Decode the file in the background and keep showing the current data meanwhile
+    // (the samples are checked there too, for decoding only the appended ones)
+    m_reloadsnd = new FTSound(fileFullPath, NULL, m_channelid, true);
+    m_reloadthread = new FTSoundReloadThread(m_reloadsnd, this, this);
+    connect(m_reloadthread, SIGNAL(finished()), this, SLOT(reloadFinished()));
+    gMW->globalWaitingBarMessage(QString("Reloading ")+visibleName+" ...");
+    m_reloadthread->start();
 
-    // ... and reload the data from the file
-    try{
-        load();
-        load_finalize();
-        m_giWavForWaveform->updateMinMaxValues();
-        gMW->m_gvWaveform->updateSceneRect();
-    }
-    catch(std::bad_alloc err){
-        QMessageBox::critical(NULL, "Memory full!", "There is not enough free memory for re-loading this file.");
+//    COUTD << "FTSound::~reload" << endl;
+    return false; // The views will be updated in reloadFinished()
+}
 
-        throw QString("The is not enough free memory for re-loading this file!");
+void FTSound::reloadFinished() {
+    FTSoundReloadThread* thread = static_cast<FTSoundReloadThread*>(m_reloadthread);
+    QString err = thread->m_error;
+    bool appended = thread->m_appended;
+    thread->deleteLater();
+    m_reloadthread = NULL;
+    gMW->globalWaitingBarDone();
+
+    if(err.isEmpty()){
+        // The playback may have started during the decoding, and the playback thread reads the samples
+        if(m_isplaying)
+            gMW->m_audioengine->stopPlayback();
+        stopPlay();
+        gMW->m_gvSpectrogram->m_stftcomputethread->cancelComputation(this);
+
+        if(appended){
+            // Keep the loaded samples and add the new ones
+            try{
+                wav.insert(wav.end(), m_reloadsnd->wav.begin(), m_reloadsnd->wav.end());
+                setFiltered(false); // The filtered signal doesn't cover the new samples
+                load_finalize();
+                reload_finalize();
+            }
+            catch(std::bad_alloc){
+                err = "There is not enough free memory for re-loading this file!";
+            }
+        }
+        else{
+            // Reset everything ...
+//            m_ampscale = 1.0;
+//            m_delay = 0;
+            m_start = 0;
+            m_pos = 0;
+            m_end = 0;
+            m_avoidclickswinpos = 0;
+            fsoriginal = 0.0;
+            std::vector<WAVTYPE>().swap(wavfiltered);
+            setFiltered(false);
+            gMW->m_gvSpectrogram->m_stftcomputethread->m_mutex_changingstft.lock();
+//            m_stft.clear();
+            if(m_stftpa){
+                delete m_stftpa;
+                m_stftpa = NULL;
+            }
+            m_stftts.clear();
+            gMW->m_gvSpectrogram->m_stftcomputethread->m_mutex_changingstft.unlock();
+            m_imgSTFTParams.clear();
+            m_stftparams.clear();
+
+            // ... and take the freshly decoded data
+            wav.swap(m_reloadsnd->wav);
+            m_fileaudioformat = m_reloadsnd->m_fileaudioformat;
+            setSamplingRate(m_reloadsnd->fs);
+            load_finalize();
+            reload_finalize();
+        }
     }
 
+    delete m_reloadsnd;
+    m_reloadsnd = NULL;
+
+    if(!err.isEmpty())
+        QMessageBox::warning(gFL, "Failed to re-load file ...", "Data from the following file can't be re-loaded:\n"+fileFullPath+"'\n\nReason:\n"+err);
+}
+
+void FTSound::reload_finalize() {
+    m_wavdigest.clear();
+    m_giWavForWaveform->updateMinMaxValues();
+    gMW->m_gvWaveform->updateSceneRect();
     m_giWavForWaveform->clearCache();
 
-//    COUTD << "FTSound::~reload" << endl;
-    return true;
+    gFL->fileInfoUpdate();
+    gMW->m_gvWaveform->m_scene->update();
+    gMW->m_gvSpectrumAmplitude->updateAmplitudeExtent();
+    gMW->m_gvSpectrumAmplitude->updateDFTs();
+    gMW->m_gvSpectrogram->updateSTFTPlot(true); // Force the STFT computation
 }
 
 FileType* FTSound::duplicate(){
@@ -375,7 +534,10 @@ QString FTSound::info() const {
         if(m_channelid>0)         str += "Channel: "+QString::number(m_channelid)+"/"+QString::number(m_fileaudioformat.channelCount())+"<br/>";
         else if(m_channelid==-2)  str += "Channel: "+QString::number(m_fileaudioformat.channelCount())+" summed<br/>";
     }
-    str += "Sampling: "+QString::number(fs)+"Hz<br/>";
+    str += "Sampling: "+QString::number(fs)+"Hz";
+    if(isResampled())
+        str += " (resampled from "+QString::number(fsoriginal)+"Hz)";
+    str += "<br/>";
     if(m_fileaudioformat.sampleSize()!=-1) {
         str += "Sample type: "+QString::number(m_fileaudioformat.sampleSize())+"b ";
         QAudioFormat::SampleType sampletype = m_fileaudioformat.sampleType();
@@ -425,6 +587,14 @@ void FTSound::setAvoidClicksWindowDuration(double halfduration) {
         s_avoidclickswindow[n] /= winmax;
 }
 
+double FTSound::pan() const {
+    if(m_actionPanLeft->isChecked())
+        return -1.0;
+    else if(m_actionPanRight->isChecked())
+        return 1.0;
+    return 0.0;
+}
+
 void FTSound::fillContextMenu(QMenu& contextmenu) {
 
     FileType::fillContextMenu(contextmenu);
@@ -432,8 +602,11 @@ void FTSound::fillContextMenu(QMenu& contextmenu) {
     contextmenu.setTitle("Sound");
 
     contextmenu.addAction(gMW->ui->actionPlay);
+    contextmenu.addAction(gMW->ui->actionPlayMixed);
     contextmenu.addAction(m_actionResetFiltering);
     contextmenu.addAction(m_actionInvPolarity);
+    QMenu* panmenu = contextmenu.addMenu("Pan when mixing");
+    panmenu->addActions(m_actionsPan->actions());
     m_actionResetAmpScale->setText(QString("Reset amplitude scaling (%1dB) to 0dB").arg(20*log10(std::abs(m_giWavForWaveform->gain())), 0, 'g', 3));
     m_actionResetAmpScale->setDisabled(std::abs(m_giWavForWaveform->gain())==1.0);
     contextmenu.addAction(m_actionResetAmpScale);
@@ -451,22 +624,36 @@ void FTSound::needDFTUpdate() {
 
 void FTSound::setFiltered(bool filtered){
     if(filtered!=m_isfiltered){
-        if(filtered){
-            wavtoplay = &wavfiltered;
-            m_giWavForWaveform->setSignal(wavtoplay);
-        }
-        else{
-            wavtoplay = &wav;
-            m_giWavForWaveform->setSignal(wavtoplay);
+        if(!filtered){
+            // The playback thread reads the filtered samples, so stop it before releasing them
+            if(m_isplaying)
+                gMW->m_audioengine->stopPlayback();
+            std::vector<WAVTYPE>().swap(wavfiltered); // Release the memory of the filtered span
+            m_giWavFilteredForWaveform->setSignal(&wavfiltered);
             m_filteredmaxamp = 0.0;
+            m_filteredstart = 0;
+            m_filteredend = -1;
             needDFTUpdate();
         }
+        m_dftparams.clear();
         m_isfiltered = filtered;
     }
     setStatus();
     gFL->fileInfoUpdate();
 }
 
+// The filtered span is drawn by its own item, placed and scaled as the whole waveform
+void FTSound::updateFilteredWaveform(){
+    if(m_giWavFilteredForWaveform==NULL)
+        return;
+
+    m_giWavFilteredForWaveform->setVisible(m_isfiltered && m_actionShow->isChecked());
+    if(m_isfiltered){
+        m_giWavFilteredForWaveform->setGain(m_giWavForWaveform->gain());
+        m_giWavFilteredForWaveform->setDelay(m_giWavForWaveform->delay()+m_filteredstart);
+    }
+}
+
 void FTSound::resetAmpScale(){
     if(m_giWavForWaveform->gain()!=1.0){
         m_giWavForWaveform->setGain(1.0);
@@ -497,6 +684,7 @@ void FTSound::resetDelay(){
 void FTSound::inversePolarity(){
     m_giWavForWaveform->setGain(-m_giWavForWaveform->gain());
     m_giWavForWaveform->clearCache();
+    updateFilteredWaveform();
     gMW->m_gvSpectrumAmplitude->updateDFTs();
     gMW->m_gvSpectrumPhase->m_scene->update();
     gMW->m_gvSpectrumGroupDelay->m_scene->update();
@@ -515,6 +703,7 @@ bool FTSound::isModified() {
 void FTSound::setStatus(){
     FileType::setStatus();
 
+    updateFilteredWaveform();
     updateClippedState();
 }
 void FTSound::updateClippedState(){
@@ -535,18 +724,46 @@ void FTSound::setSamplingRate(double _fs){
 
     fs = _fs;
 
-    // Check if fs is the same for all files
+    // Can't access the common sampling rate outside of the GUI thread
+    if(m_isloadingdeferred)
+        return;
+
+    // The first file defines the common sampling rate.
+    // The next files with a different one are resampled in load_finalize()
     if(s_fs_common==0) {
         // The system has no defined sampling rate
         s_fs_common = fs;
         FTSound::setAvoidClicksWindowDuration(gMW->m_dlgSettings->ui->sbPlaybackAvoidClicksWindowDuration->value());
     }
-    else {
-        // Check if fs is the same as that of the other files
-        if(s_fs_common!=fs){
-            throw QString("The sampling rate of this file ("+QString::number(fs)+"Hz) is not the same as that of the files already loaded. DFasma manages only one sampling rate per instance. Please use another instance of DFasma.");
-        }
+}
+
+void FTSound::resampleToCommonRate() {
+    gMW->globalWaitingBarMessage(QString("Resampling ")+visibleName+" from "+QString::number(fs)+"Hz to "+QString::number(s_fs_common)+"Hz");
+
+    // Only the resampled samples are kept in memory, the original ones are decoded again when needed (see loadOriginal())
+    fsoriginal = fs;
+    std::vector<WAVTYPE> wavoriginal;
+    wavoriginal.swap(wav);
+
+    PolyphaseResampler resampler(fsoriginal, s_fs_common);
+    resampler.resample(wavoriginal, wav);
+    fs = s_fs_common;
+
+    gMW->globalWaitingBarDone();
+}
+
+// For exact analysis at the sampling rate of the file (fsoriginal if resampled, fs otherwise)
+void FTSound::loadOriginal(std::vector<WAVTYPE>& original) const {
+    if(!isResampled()){
+        original = wav;
+        return;
     }
+
+    FTSound snd(fileFullPath, NULL, m_channelid, true);
+    snd.loadDeferred();
+    if(snd.fs!=fsoriginal)
+        throw QString("The sampling rate of the file has changed since it was loaded. It has to be reloaded first.");
+    original.swap(snd.wav);
 }
 
 double FTSound::setPlay(const QAudioFormat& format, double tstart, double tstop, double fstart, double fstop) {
@@ -564,8 +781,17 @@ double FTSound::setPlay(const QAudioFormat& format, double tstart, double tstop,
     updateIcon();
 
     s_play_power = 0;
-    s_play_power_values.clear();
+    s_play_power_values.reset(qint64(fs)); // Level meter over the last second
+
+    // Polarity apparently matters in very particular cases
+    // so take it into account when playing.
+    m_playgain = m_giWavForWaveform->gain();
+    if(m_actionInvPolarity->isChecked())
+        m_playgain *= -1;
+    m_playdelay = qint64(m_giWavForWaveform->delay());
+    m_playbuffer.resize(FTSOUND_PLAYBUFFERLEN*std::max(1, format.channelCount()));
     m_avoidclickswinpos = 0;
+    m_looptailfadepos = std::numeric_limits<qint64>::max(); // No loop cross-fade
 
     // Fix and make time selection
     if(tstart>tstop){
@@ -592,10 +818,10 @@ double FTSound::setPlay(const QAudioFormat& format, double tstart, double tstop,
 
     int delayedstart = m_start-m_giWavForWaveform->delay();
     if(delayedstart<0) delayedstart=0;
-    if(delayedstart>int(wavtoplay->size())-1) delayedstart=int(wavtoplay->size())-1;
+    if(delayedstart>int(wav.size())-1) delayedstart=int(wav.size())-1;
     int delayedend = m_end-m_giWavForWaveform->delay();
     if(delayedend<0) delayedend=0;
-    if(delayedend>int(wavtoplay->size())-1) delayedend=int(wavtoplay->size())-1;
+    if(delayedend>int(wav.size())-1) delayedend=int(wav.size())-1;
 
     // Fix frequency cutoffs
     if(fstart>fstop){
@@ -617,8 +843,6 @@ double FTSound::setPlay(const QAudioFormat& format, double tstart, double tstop,
     if ((fstart<fstop) && (doLowPass || doHighPass)) {
         // Filtered play
         try{
-            wavfiltered = wav; // Is it acceptable for big files ? Reason of issue #117 also ?
-
             // Compute the energy of the non-filtered signal
             double enerwav = 0.0;
             if(gMW->m_dlgSettings->ui->cbPlaybackFilteringCompensateEnergy->isChecked()){
@@ -628,64 +852,99 @@ double FTSound::setPlay(const QAudioFormat& format, double tstart, double tstop,
             }
 
             int butterworth_order = gMW->m_dlgSettings->ui->sbPlaybackButterworthOrder->value();
+
+            bool stftmasking = gMW->m_dlgSettings->ui->cbPlaybackFilteringMethod->currentIndex()==1;
+
+            // Filter only the selection, plus a margin for the transients of the filter
+            int margin = 0;
+            if(stftmasking) {
+                margin = STFTMasking::windowLength(fs);
+            }
+            else {
+                double fmin = fs/2;
+                if(doLowPass)  fmin = std::min(fmin, fstop);
+                if(doHighPass) fmin = std::min(fmin, fstart);
+                margin = int(2*butterworth_order*fs/fmin);
+            }
+            int spanstart = std::max(0, delayedstart-margin);
+            int spanend = std::min(int(wav.size())-1, delayedend+margin);
+            std::vector<WAVTYPE> span(wav.begin()+spanstart, wav.begin()+spanend+1);
+
             gMW->m_gvSpectrumAmplitude->m_filterresponse = std::vector<FFTTYPE>(BUTTERRESPONSEDFTLEN/2+1,1.0);
             std::vector< std::vector<double> > num, den;
             std::vector<double> filterresponse;
+            BiquadCascade cascade;
 
-            if (doLowPass) {
-                // Compute the Butterworth filter coefficients
-                mkfilter::make_butterworth_filter_biquad(butterworth_order, fstop/fs, true, num, den, &filterresponse, BUTTERRESPONSEDFTLEN);
+            if(stftmasking) {
+                double fbandstart = doHighPass?fstart:0.0;
+                double fbandstop = doLowPass?fstop:fs/2;
 
-                // Update the filter response
-                for(size_t k=0; k<filterresponse.size(); k++){
-                    if(filterresponse[k] < 2*std::numeric_limits<FFTTYPE>::min())
-                        filterresponse[k] = std::numeric_limits<FFTTYPE>::min();
-                    gMW->m_gvSpectrumAmplitude->m_filterresponse[k] *= filterresponse[k];
+                // The filter response is the mask itself
+                for(size_t k=0; k<gMW->m_gvSpectrumAmplitude->m_filterresponse.size(); k++){
+                    double f = double(k)*fs/BUTTERRESPONSEDFTLEN;
+                    if(f<fbandstart || f>fbandstop)
+                        gMW->m_gvSpectrumAmplitude->m_filterresponse[k] = std::numeric_limits<FFTTYPE>::min();
                 }
 
-                gMW->globalWaitingBarMessage(QString("Low-pass filtering (cutoff=")+QString::number(fstop)+"Hz)");
-
-                cout << "LP-filtering (cutoff=" << fstop << ", size=" << wavfiltered.size() << ")" << endl;
-                // Filter the signal
-                for(size_t bi=0; bi<num.size(); bi++)
-                    qae::filtfilt<WAVTYPE>(wavfiltered, num[bi], den[bi], wavfiltered, delayedstart, delayedend);
-
+                gMW->globalWaitingBarMessage(QString("Filtering by STFT masking (")+QString::number(fstart)+"Hz to "+QString::number(fstop)+"Hz)");
+                cout << "STFT masking (dftlen=" << STFTMasking::windowLength(fs) << ", size=" << span.size() << ")" << endl;
+                STFTMasking masking(fs);
+                masking.bandPass(span, fbandstart, fbandstop);
                 gMW->globalWaitingBarClear();
             }
-
-            if (doHighPass) {
-                // Compute the Butterworth filter coefficients
-                mkfilter::make_butterworth_filter_biquad(butterworth_order, fstart/fs, false, num, den, &filterresponse, BUTTERRESPONSEDFTLEN);
-
-                // Update the filter response
-                for(size_t k=0; k<filterresponse.size(); k++){
-                    if(filterresponse[k] < 2*std::numeric_limits<FFTTYPE>::min())
-                        filterresponse[k] = std::numeric_limits<FFTTYPE>::min();
-                    gMW->m_gvSpectrumAmplitude->m_filterresponse[k] *= filterresponse[k];
+            else {
+                if (doLowPass) {
+                    // Compute the Butterworth filter coefficients
+                    mkfilter::make_butterworth_filter_biquad(butterworth_order, fstop/fs, true, num, den, &filterresponse, BUTTERRESPONSEDFTLEN);
+
+                    // Update the filter response
+                    for(size_t k=0; k<filterresponse.size(); k++){
+                        if(filterresponse[k] < 2*std::numeric_limits<FFTTYPE>::min())
+                            filterresponse[k] = std::numeric_limits<FFTTYPE>::min();
+                        gMW->m_gvSpectrumAmplitude->m_filterresponse[k] *= filterresponse[k];
+                    }
+
+                    cascade.addSections(num, den);
                 }
 
-                gMW->globalWaitingBarMessage(QString("Low-pass filtering (cutoff=")+QString::number(fstop)+"Hz)");
+                if (doHighPass) {
+                    // Compute the Butterworth filter coefficients
+                    mkfilter::make_butterworth_filter_biquad(butterworth_order, fstart/fs, false, num, den, &filterresponse, BUTTERRESPONSEDFTLEN);
 
-                cout << "HP-filtering (cutoff=" << fstart << ", size=" << wavfiltered.size() << ")" << endl;
+                    // Update the filter response
+                    for(size_t k=0; k<filterresponse.size(); k++){
+                        if(filterresponse[k] < 2*std::numeric_limits<FFTTYPE>::min())
+                            filterresponse[k] = std::numeric_limits<FFTTYPE>::min();
+                        gMW->m_gvSpectrumAmplitude->m_filterresponse[k] *= filterresponse[k];
+                    }
 
-                // Filter the signal
-                for(size_t bi=0; bi<num.size(); bi++)
-                    qae::filtfilt<WAVTYPE>(wavfiltered, num[bi], den[bi], wavfiltered, delayedstart, delayedend);
+                    cascade.addSections(num, den);
+                }
 
+                // Filter the signal, with all the sections at once
+                gMW->globalWaitingBarMessage(QString("Filtering (")+QString::number(fstart)+"Hz to "+QString::number(fstop)+"Hz)");
+                cout << "Filtering (" << cascade.nbSections() << " sections, size=" << span.size() << ")" << endl;
+                cascade.filtfilt(span);
                 gMW->globalWaitingBarClear();
             }
 
+            // Keep only the filtered selection, the rest is played from wav
+            std::vector<WAVTYPE>(span.begin()+(delayedstart-spanstart), span.begin()+(delayedend-spanstart)+1).swap(wavfiltered);
+            std::vector<WAVTYPE>().swap(span);
+            m_filteredstart = delayedstart;
+            m_filteredend = delayedend;
+
             if(gMW->m_dlgSettings->ui->cbPlaybackFilteringCompensateEnergy->isChecked()){
                 // Compute the energy of the filtered signal ...
                 double enerfilt = 0.0;
-                for(int n=delayedstart; n<=delayedend; n++)
+                for(size_t n=0; n<wavfiltered.size(); n++)
                     enerfilt += wavfiltered[n]*wavfiltered[n];
                 enerfilt = std::sqrt(enerfilt);
 
                 // ... and equalize the energy with the non-filtered signal
                 enerwav = enerwav/enerfilt; // Pre-compute the ratio
                 m_filteredmaxamp = 0.0;
-                for(int n=delayedstart; n<=delayedend; n++){
+                for(size_t n=0; n<wavfiltered.size(); n++){
                     wavfiltered[n] *= enerwav;
                     m_filteredmaxamp = std::max(m_filteredmaxamp, std::abs(wavfiltered[n]));
                 }
@@ -693,7 +952,10 @@ double FTSound::setPlay(const QAudioFormat& format, double tstart, double tstop,
 
             // It seems the filtering went well, we can use the filtered sound and update the views
 
-            m_giWavForWaveform->updateMinMaxValues();
+            m_giWavFilteredForWaveform->setSignal(&wavfiltered);
+            m_giWavFilteredForWaveform->updateMinMaxValues();
+            m_giWavFilteredForWaveform->clearCache();
+            m_dftparams.clear();
             setFiltered(true);
 
             // The filter response has been computed
@@ -702,7 +964,6 @@ double FTSound::setPlay(const QAudioFormat& format, double tstart, double tstop,
                 gMW->m_gvSpectrumAmplitude->m_filterresponse[k] = 2*20*log10(gMW->m_gvSpectrumAmplitude->m_filterresponse[k]);
             gMW->m_gvSpectrumAmplitude->m_scene->update();
 
-            m_giWavForWaveform->clearCache(); // TODO clear only the previous and current selection
             gMW->m_gvWaveform->m_scene->invalidate(gMW->m_gvWaveform->m_giFilteredSelection->rect());
         }
         catch(QString err){
@@ -733,8 +994,6 @@ double FTSound::setPlay(const QAudioFormat& format, double tstart, double tstop,
         else
             gMW->m_gvWaveform->m_giFilteredSelection->setRect(-0.5/gFL->getFs(), -1.0, getLastSampleTime()+1.0/gFL->getFs(), 2.0);
         gMW->m_gvWaveform->m_giFilteredSelection->show();
-        // SPEEDUP Could clear/update/invalidate only the concerned time selection
-        m_giWavForWaveform->clearCache();
         gMW->m_gvWaveform->m_scene->update();
         gMW->m_lastFilteredSound = this;
     }
@@ -759,6 +1018,29 @@ double FTSound::setPlay(const QAudioFormat& format, double tstart, double tstop,
     return tobeplayed;
 }
 
+// Prepare the sound to take over the playback of another one
+// (the positions are set by the playback thread, see SoundsMixer::switchTo,
+// which never prepares a sound twice during a playback)
+void FTSound::setPlaySwitched(const QAudioFormat& format) {
+    if(format.sampleRate()!=fs)
+        throw QString("The sampling frequency of the file is different from that of the audio engine. They have to be the same.");
+
+    setFiltered(false);
+
+    m_outputaudioformat = format;
+    m_playgain = m_giWavForWaveform->gain();
+    if(m_actionInvPolarity->isChecked())
+        m_playgain *= -1;
+    m_playdelay = qint64(m_giWavForWaveform->delay());
+    m_playbuffer.resize(FTSOUND_PLAYBUFFERLEN*std::max(1, format.channelCount()));
+    m_looptailfadepos = std::numeric_limits<qint64>::max();
+
+    m_isplaying = true;
+    updateIcon();
+
+    QIODevice::open(QIODevice::ReadOnly);
+}
+
 void FTSound::stopPlay()
 {
     m_start = 0;
@@ -770,84 +1052,176 @@ void FTSound::stopPlay()
     updateIcon();
 }
 
-qint64 FTSound::readData(char *data, qint64 askedlen)
-{
-//    std::cout << "DSSound::readData requested=" << askedlen << endl;
-
-    qint64 writtenbytes = 0; // [bytes]
+// Write the samples of buffer in the given output format
+// Assuming a little-endian output, as opened by the AudioEngine
+// (len counts the values, i.e. frames times channels)
+void FTSound::writeOutputSamples(const QAudioFormat& format, const WAVTYPE* buffer, qint64 len, unsigned char* ptr) {
+    if(format.sampleType()==QAudioFormat::Float && format.sampleSize()==32){
+        for(qint64 n=0; n<len; ++n, ptr+=4){
+            float value = float(buffer[n]);
+            quint32 bits;
+            memcpy(&bits, &value, 4);
+            qToLittleEndian<quint32>(bits, ptr);
+        }
+    }
+    else if(format.sampleSize()==32){
+        for(qint64 n=0; n<len; ++n, ptr+=4)
+            qToLittleEndian<qint32>(qint32(buffer[n]*2147483647.0), ptr);
+    }
+    else if(format.sampleSize()==24){
+        for(qint64 n=0; n<len; ++n, ptr+=3){
+            qint32 value = qint32(buffer[n]*8388607.0);
+            ptr[0] = value & 0xFF;
+            ptr[1] = (value>>8) & 0xFF;
+            ptr[2] = (value>>16) & 0xFF;
+        }
+    }
+    else{
+        for(qint64 n=0; n<len; ++n, ptr+=2)
+            qToLittleEndian<qint16>(qint16(buffer[n]*32767), ptr);
+    }
+}
 
-    const int channelBytes = m_outputaudioformat.sampleSize() / 8;
-    unsigned char *ptr = reinterpret_cast<unsigned char *>(data);
-    int delayedstart = m_start-m_giWavForWaveform->delay();
+// Render the next len samples to play (mono, with gain and polarity)
+void FTSound::renderPlay(WAVTYPE* buffer, qint64 len)
+{
+    const qint64 wavsize = qint64(wav.size());
+    const qint64 delay = m_playdelay;
+    qint64 delayedstart = m_start-delay;
+    if(delayedstart>wavsize-1) delayedstart=wavsize-1;
     if(delayedstart<0) delayedstart=0;
-    if(delayedstart>int(wavtoplay->size()-1)) delayedstart=int(wavtoplay->size())-1;
-    int delayedend = m_end-m_giWavForWaveform->delay();
+    qint64 delayedend = m_end-delay;
+    if(delayedend>wavsize-1) delayedend=wavsize-1;
     if(delayedend<0) delayedend=0;
-    if(delayedend>int(wavtoplay->size()-1)) delayedend=int(wavtoplay->size())-1;
-
-    // Polarity apparently matters in very particular cases
-    // so take it into account when playing.
-    double gain = m_giWavForWaveform->gain();
-    if(m_actionInvPolarity->isChecked())
-        gain *= -1;
-
-    // Write as many bits has requested by the call
-    while(writtenbytes<askedlen) {
-        qint16 value = 0;
-
-        if(s_playwin_use && (m_avoidclickswinpos<qint64(s_avoidclickswindow.size()-1)/2)) {
-            value = qint16((gain*(*wavtoplay)[delayedstart]*s_avoidclickswindow[m_avoidclickswinpos++])*32767);
+    const qint64 winlen = qint64(s_avoidclickswindow.size());
+    const qint64 winhalflen = (winlen-1)/2;
+    const bool usewin = s_playwin_use && wavsize>0;
+
+    const WAVTYPE gain = m_playgain;
+    const WAVTYPE* wavdata = (wavsize>0)?&(wav[0]):NULL;
+
+    qint64 n = 0;
+    while(n<len) {
+        if(usewin && m_avoidclickswinpos<winhalflen) {
+            // Fade-in of the first sample
+            qint64 seglen = std::min(len-n, winhalflen-m_avoidclickswinpos);
+            WAVTYPE value = gain*sampleToPlay(delayedstart);
+            const WAVTYPE* win = &(s_avoidclickswindow[m_avoidclickswinpos]);
+            for(qint64 k=0; k<seglen; ++k)
+                buffer[n+k] = value*win[k];
+            m_avoidclickswinpos += seglen;
+            n += seglen;
         }
-        else if(s_playwin_use && (m_pos>m_end) && m_avoidclickswinpos<qint64(s_avoidclickswindow.size()-1)) {
-            value = qint16((gain*(*wavtoplay)[delayedend]*s_avoidclickswindow[1+m_avoidclickswinpos++])*32767);
+        else if(m_pos>m_end && m_end>=m_start && s_playloop.load()) {
+            // Loop: go back to the start without any gap,
+            // cross-fading with what follows the end, if avoiding clicks
+            if(usewin) {
+                m_looptailpos = m_pos;
+                m_looptailfadepos = 0;
+            }
+            m_pos = m_start;
+        }
+        else if(usewin && m_pos>m_end && m_avoidclickswinpos<winlen-1) {
+            // Fade-out of the last sample
+            qint64 seglen = std::min(len-n, winlen-1-m_avoidclickswinpos);
+            WAVTYPE value = gain*sampleToPlay(delayedend);
+            const WAVTYPE* win = &(s_avoidclickswindow[1+m_avoidclickswinpos]);
+            for(qint64 k=0; k<seglen; ++k)
+                buffer[n+k] = value*win[k];
+            m_avoidclickswinpos += seglen;
+            n += seglen;
         }
-        else if (m_pos<=m_end) {
-            int delayedpos = m_pos - m_giWavForWaveform->delay();
-            if(delayedpos>=0 && delayedpos<int(wavtoplay->size())){
-        //        WAVTYPE e = samples[m_pos]*samples[m_pos];
-                WAVTYPE e = abs(gain*(*wavtoplay)[delayedpos]);
-//                s_play_power += e;
-                s_play_power_values.push_front(e);
-                while(s_play_power_values.size()/fs>1.0){ // Has to correspond to the delay between readData calls
-//                    s_play_power -= s_play_power_values.back();
-                    s_play_power_values.pop_back();
+        else if(m_pos<=m_end) {
+            qint64 seglen = std::min(len-n, m_end-m_pos+1);
+
+            // Because of the delay, part of it can be out of the signal
+            qint64 first = std::min(seglen, std::max(qint64(0), -(m_pos-delay)));
+            qint64 last = std::max(first, std::min(seglen, wavsize-(m_pos-delay)));
+            for(qint64 k=0; k<first; ++k)
+                buffer[n+k] = 0.0;
+            const WAVTYPE* x = wavdata+(m_pos-delay);
+            for(qint64 k=first; k<last; ++k)
+                buffer[n+k] = gain*x[k];
+            if(m_isfiltered) {
+                // The filtered span replaces the original samples
+                qint64 ffirst = std::max(first, m_filteredstart-(m_pos-delay));
+                qint64 flast = std::min(last, m_filteredend+1-(m_pos-delay));
+                for(qint64 k=ffirst; k<flast; ++k)
+                    buffer[n+k] = gain*wavfiltered[m_pos-delay+k-m_filteredstart];
+            }
+            for(qint64 k=last; k<seglen; ++k)
+                buffer[n+k] = 0.0;
+
+            if(m_looptailfadepos<winhalflen) {
+                // Cross-fade the start of the loop with the continuation of its end
+                qint64 fadelen = std::min(seglen, winhalflen-m_looptailfadepos);
+                const WAVTYPE* winin = &(s_avoidclickswindow[m_looptailfadepos]);
+                const WAVTYPE* winout = &(s_avoidclickswindow[winhalflen+1+m_looptailfadepos]);
+                for(qint64 k=0; k<fadelen; ++k){
+                    qint64 t = m_looptailpos+k-delay;
+                    WAVTYPE tail = (t>=0 && t<wavsize)?gain*sampleToPlay(t):0.0;
+                    buffer[n+k] = winin[k]*buffer[n+k] + winout[k]*tail;
                 }
+                m_looptailpos += fadelen;
+                m_looptailfadepos += fadelen;
+            }
 
-        //        cout << 20*log10(sqrt(s_play_power/s_play_power_values.size())) << endl;
+            m_pos += seglen;
+            n += seglen;
+        }
+        else {
+            // Nothing left to play
+            for(; n<len; ++n)
+                buffer[n] = 0.0;
+        }
+    }
+}
+
+qint64 FTSound::readData(char *data, qint64 askedlen)
+{
+//    std::cout << "DSSound::readData requested=" << askedlen << endl;
 
-                // Assuming the output audio device has been open in 16bits ...
-                // TODO Manage more output formats
-                WAVTYPE w = gain*(*wavtoplay)[delayedpos];
+    const int nbchannels = std::max(1, m_outputaudioformat.channelCount());
+    const int frameBytes = nbchannels*m_outputaudioformat.sampleSize()/8;
+    unsigned char *ptr = reinterpret_cast<unsigned char *>(data);
+    const qint64 nbframes = askedlen/frameBytes; // Never write more than asked
 
-                if(w>1.0)       w = 1.0;
-                else if(w<-1.0) w = -1.0;
+    if(m_playbuffer.size()<size_t(nbchannels))
+        m_playbuffer.resize(FTSOUND_PLAYBUFFERLEN*nbchannels);
+    WAVTYPE* buffer = &(m_playbuffer[0]);
+    const qint64 maxblocklen = qint64(m_playbuffer.size())/nbchannels;
 
-                value=qint16(w*32767);
-            }
+    // Render block by block in the pre-allocated buffer
+    for(qint64 blockstart=0; blockstart<nbframes; blockstart+=maxblocklen) {
+        const qint64 blocklen = std::min(maxblocklen, nbframes-blockstart);
 
-            m_pos++;
+        renderPlay(buffer, blocklen);
+
+        // Update the level meter
+        for(qint64 k=0; k<blocklen; ++k)
+            s_play_power_values.push(std::abs(buffer[k]));
+
+        // Clip
+        for(qint64 k=0; k<blocklen; ++k){
+            if(buffer[k]>1.0)       buffer[k] = 1.0;
+            else if(buffer[k]<-1.0) buffer[k] = -1.0;
         }
 
-        qToLittleEndian<qint16>(value, ptr);
-        ptr += channelBytes;
-        writtenbytes += channelBytes;
+        // Same signal in all channels (in place, from the end)
+        if(nbchannels>1)
+            for(qint64 k=blocklen-1; k>=0; --k)
+                for(int c=nbchannels-1; c>=0; --c)
+                    buffer[k*nbchannels+c] = buffer[k];
+
+        writeOutputSamples(m_outputaudioformat, buffer, blocklen*nbchannels, ptr);
+        ptr += blocklen*frameBytes;
     }
 
-    s_play_power = 0;
-    for(unsigned int i=0; i<s_play_power_values.size(); i++)
-        s_play_power = max(s_play_power, s_play_power_values[i]);
+    s_play_power = s_play_power_values.max();
 
-//    std::cout << "~DSSound::readData writtenbytes=" << writtenbytes << " m_pos=" << m_pos << " m_end=" << m_end << endl;
+//    std::cout << "~DSSound::readData writtenbytes=" << nbframes*frameBytes << " m_pos=" << m_pos << " m_end=" << m_end << endl;
 
-    if(m_pos>=m_end){
-//        COUTD << "No more data to send to the sound device!" << endl;
-//        QIODevice::close(); // TODO do this instead ??
-//        emit readChannelFinished();
-        return writtenbytes;
-    }
-    else{
-        return writtenbytes;
-    }
+    return nbframes*frameBytes;
 }
 
 qint64 FTSound::writeData(const char *data, qint64 askedlen){
@@ -861,6 +1235,11 @@ qint64 FTSound::writeData(const char *data, qint64 askedlen){
 }
 
 FTSound::~FTSound(){
+    if(m_reloadthread){
+        m_reloadthread->wait();
+        delete m_reloadsnd;
+    }
+
     if(gFL->m_prevSelectedSound==this)
         gFL->m_prevSelectedSound = NULL;
 
@@ -870,11 +1249,15 @@ FTSound::~FTSound(){
     QIODevice::close();
 
     delete m_giWavForWaveform;
+    delete m_giWavFilteredForWaveform;
     delete m_giWavForSpectrumAmplitude;
     delete m_giWavForSpectrumPhase;
     delete m_giWavForSpectrumGroupDelay;
+    delete m_giSQNRForSpectrumAmplitude;
 
-    gFL->ftsnds.erase(std::find(gFL->ftsnds.begin(), gFL->ftsnds.end(), this));
+    std::deque<FTSound*>::iterator it = std::find(gFL->ftsnds.begin(), gFL->ftsnds.end(), this);
+    if(it!=gFL->ftsnds.end()) // Might not be there if the loading failed before being attached
+        gFL->ftsnds.erase(it);
 
     if(m_stftpa){
         delete m_stftpa;
@@ -885,6 +1268,7 @@ FTSound::~FTSound(){
     delete m_actionResetDelay;
     delete m_actionResetAmpScale;
     delete m_actionInvPolarity;
+    delete m_actionsPan;
 }
 
 
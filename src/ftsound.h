@@ -24,15 +24,19 @@ file provided in the source code of DFasma. Another copy can be found at
 #include <deque>
 #include <vector>
 #include <complex>
+#include <algorithm>
 
 #include <QString>
 #include <QColor>
 #include <QAudioFormat>
 #include <QAction>
+#include <QActionGroup>
 #include <QGraphicsItem>
+#include <QAtomicInt>
 
 #include "filetype.h"
 #include "stftcomputethread.h"
+#include "slidingwindowmaximum.h"
 
 #include "qaegiuniformlysampledsignal.h"
 
@@ -43,6 +47,7 @@ file provided in the source code of DFasma. Another copy can be found at
 #endif
 
 #define BUTTERRESPONSEDFTLEN 2048
+#define FTSOUND_PLAYBUFFERLEN 4096 // [samples] Block size for rendering the played sound
 
 #include "stftcomputethread.h"
 
@@ -62,8 +67,15 @@ private:
 
     QAudioFormat m_fileaudioformat;   // Format of the audio data
     void setSamplingRate(double _fs); // Used by implementations of load
+    void resampleToCommonRate();      // Bring the sound to s_fs_common
     int m_channelid;  //-2:channels merged; -1:error; 0:no channel; >0:id
     bool m_isclipped;
+    bool m_isloadingdeferred; // True until attachDeferred() is called
+
+    // Reload
+    void reload_finalize();           // Update the views after a reload
+    FTSound* m_reloadsnd;             // Temporary sound decoding the file in the background
+    QThread* m_reloadthread;
 
     // Playback
     QAudioFormat m_outputaudioformat; // Temporary copy for readData
@@ -76,16 +88,34 @@ public:
     static int getNumberOfChannels(const QString& filePath);
     static double s_fs_common;  // [Hz] Sampling frequency of the sound player // TODO put in sound player
 
-    FTSound(const QString& _fileName, QObject* parent, int channelid=1);
+    FTSound(const QString& _fileName, QObject* parent, int channelid=1, bool deferload=false);
     FTSound(const FTSound& ft);
     virtual FileType* duplicate();
 
+    // For parallel loading (deferload=true in the constructor):
+    void loadDeferred();   // Decode the file. Touches only the signal and its format, can run in a worker thread.
+    void attachDeferred(); // Check the sampling rate and add the sound to the views. GUI thread only.
+    bool loadAppended(const FTSound& loaded); // Decode only the samples appended to the file since it was loaded in the given sound, which must not change meanwhile. Returns false if not possible. Can run in a worker thread.
+
     double fs; // [Hz] Sampling frequency of this specific wav file
     std::vector<WAVTYPE> wav;
-    std::vector<WAVTYPE> wavfiltered;
-    std::vector<WAVTYPE>* wavtoplay;
+    double fsoriginal; // [Hz] Sampling frequency of the file, if it has been resampled (0 otherwise)
+    bool isResampled() const {return fsoriginal>0.0;}
+    void loadOriginal(std::vector<WAVTYPE>& original) const; // The samples at the sampling rate of the file (decoded again if resampled)
+    QByteArray m_wavdigest; // SHA-1 of the samples for the F0 cache (empty until needed, cleared when wav changes)
+    qreal m_wavdigestdelay; // [samples] Delay applied to the samples of m_wavdigest
+    std::vector<WAVTYPE> wavfiltered; // Filtered samples of [m_filteredstart, m_filteredend] only
     WAVTYPE m_filteredmaxamp;
+    int m_filteredstart; // Span of wav which is replaced by wavfiltered when filtered
+    int m_filteredend;
+    inline WAVTYPE sampleToPlay(qint64 n) const {
+        if(m_isfiltered && n>=m_filteredstart && n<=m_filteredend)
+            return wavfiltered[n-m_filteredstart];
+        return wav[n];
+    }
     QAEGIUniformlySampledSignal* m_giWavForWaveform;
+    QAEGIUniformlySampledSignal* m_giWavFilteredForWaveform; // Drawn over the filtered span
+    void updateFilteredWaveform();
 
     // Spectra
     class DFTParameters{
@@ -158,17 +188,30 @@ public:
     qint64 readData(char *data, qint64 maxlen);
     qint64 writeData(const char *data, qint64 len);
 //    qint64 bytesAvailable() const;
+    void renderPlay(WAVTYPE* buffer, qint64 len);
+    static void writeOutputSamples(const QAudioFormat& format, const WAVTYPE* buffer, qint64 len, unsigned char* ptr);
     qint64 m_start; // [sample index]
     qint64 m_pos;   // [sample index]
+    WAVTYPE m_playgain;  // Gain and polarity, fixed when the playback starts
+    qint64 m_playdelay;  // (readData runs in the playback thread)
     qint64 m_end;   // [sample index]
     qint64 m_avoidclickswinpos;// [sample index] position in the pre and post windows
+    qint64 m_looptailpos;      // [sample index] What follows the end of the loop, faded out after wrapping
+    qint64 m_looptailfadepos;  // [sample index] position in the loop cross-fade
 
     static WAVTYPE s_play_power;
-    static std::deque<WAVTYPE> s_play_power_values;
+    static SlidingWindowMaximum s_play_power_values; // Amplitudes over the last second
+    std::vector<WAVTYPE> m_playbuffer; // Rendering buffer for readData, allocated by setPlay
     static bool s_playwin_use;
+    static QAtomicInt s_playloop; // Wrap to m_start after m_end, set by the GUI thread
 
     // Visualization
     QAction* m_actionInvPolarity;
+    QActionGroup* m_actionsPan;
+    QAction* m_actionPanLeft;
+    QAction* m_actionPanCenter;
+    QAction* m_actionPanRight;
+    double pan() const; // [-1,1] From left to right, when mixing sounds
     QAction* m_actionResetAmpScale;
     QAction* m_actionResetDelay;
     QAction* m_actionResetFiltering;
@@ -194,6 +237,7 @@ public:
 
     double setPlay(const QAudioFormat& format, double tstart=0.0, double tstop=0.0, double fstart=0.0, double fstop=0.0);
     bool isPlaying() const {return m_isplaying;}
+    void setPlaySwitched(const QAudioFormat& format);
     void stopPlay();
 
     static std::vector<WAVTYPE> s_avoidclickswindow;
@@ -203,6 +247,7 @@ public:
 
 public slots:
     bool reload();
+    void reloadFinished();
     void needDFTUpdate();
     void resetAmpScale();
     void resetDelay();
@@ -0,0 +1,66 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#include "gvplaycursor.h"
+
+#include <QGraphicsView>
+#include <QPainter>
+#include <QPen>
+
+GVPlayCursor::GVPlayCursor(QGraphicsView* view)
+    : m_view(view)
+    , m_pos(0.0)
+    , m_visible(true)
+{
+}
+
+// Repaint only the vertical strip of the viewport around time t
+void GVPlayCursor::updateStrip(double t){
+    int x = m_view->mapFromScene(QPointF(t, 0.0)).x();
+    m_view->viewport()->update(QRect(x-2, 0, 5, m_view->viewport()->height()));
+}
+
+void GVPlayCursor::move(double t){
+    if(t==m_pos)
+        return;
+
+    if(m_visible)
+        updateStrip(m_pos);
+    m_pos = t;
+    if(m_visible)
+        updateStrip(m_pos);
+}
+
+void GVPlayCursor::setVisible(bool visible){
+    m_visible = visible;
+    updateStrip(m_pos);
+}
+
+void GVPlayCursor::draw(QPainter* painter, double top, double bottom){
+    if(!m_visible)
+        return;
+
+    QPen playCursorPen(QColor(255, 0, 0));
+    playCursorPen.setCosmetic(true);
+    playCursorPen.setWidth(2);
+    painter->setPen(playCursorPen);
+    painter->drawLine(QLineF(m_pos, top, m_pos, bottom));
+}
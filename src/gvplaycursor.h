@@ -0,0 +1,50 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef GVPLAYCURSOR_H
+#define GVPLAYCURSOR_H
+
+class QGraphicsView;
+class QPainter;
+
+// Play cursor of the time views (GVWaveform and GVSpectrogram).
+// It is drawn in the foreground of the view, so that moving it repaints
+// only the strips of the viewport around its previous and new positions.
+class GVPlayCursor
+{
+    QGraphicsView* m_view;
+    double m_pos; // [s]
+    bool m_visible;
+
+    void updateStrip(double t);
+
+public:
+    GVPlayCursor(QGraphicsView* view);
+
+    double position() const {return m_pos;}
+    void move(double t);
+    void setVisible(bool visible);
+
+    // To be called from the view's drawForeground, between the given scene's ordinates
+    void draw(QPainter* painter, double top, double bottom);
+};
+
+#endif // GVPLAYCURSOR_H
@@ -22,6 +22,7 @@ file provided in the source code of DFasma. Another copy can be found at
 #include "gvspectrogramwdialogsettings.h"
 #include "ui_gvspectrogramwdialogsettings.h"
 #include "stftcomputethread.h"
+#include "yinestimator.h"
 
 #include "wmainwindow.h"
 #include "ui_wmainwindow.h"
@@ -40,6 +41,7 @@ file provided in the source code of DFasma. Another copy can be found at
 #include "gvspectrumgroupdelay.h"
 #include "wgenerictimevalue.h"
 #include "gvgenerictimevalue.h"
+#include "gvplaycursor.h"
 
 #include <iostream>
 #include <algorithm>
@@ -57,6 +59,7 @@ using namespace std;
 #include <QTime>
 #include <QToolTip>
 #include <QScrollBar>
+#include <QTimer>
 #include "../external/libqxt/qxtspanslider.h"
 
 #include "qaesigproc.h"
@@ -109,6 +112,13 @@ GVSpectrogram::GVSpectrogram(WMainWindow* parent)
     gMW->m_settings.add(m_aSpectrogramShowHarmonics);
     connect(m_aSpectrogramShowHarmonics, SIGNAL(toggled(bool)), this, SLOT(showHarmonics(bool)));
 
+    m_aSpectrogramShowF0Preview = new QAction(tr("Show F0 &preview"), this);
+    m_aSpectrogramShowF0Preview->setObjectName("m_aSpectrogramShowF0Preview"); // For auto settings
+    m_aSpectrogramShowF0Preview->setStatusTip(tr("Show a fast estimate of the F0 of the current sound in the visible time range (dashed), for adjusting the F0 range before running the full estimation"));
+    m_aSpectrogramShowF0Preview->setCheckable(true);
+    m_aSpectrogramShowF0Preview->setChecked(false);
+    gMW->m_settings.add(m_aSpectrogramShowF0Preview);
+
     m_aAutoUpdate = new QAction(tr("Auto-Update STFT"), this);
     m_aAutoUpdate->setStatusTip(tr("Auto-Update the STFT view when the waveform is modified"));
     m_aAutoUpdate->setCheckable(true);
@@ -164,14 +174,25 @@ GVSpectrogram::GVSpectrogram(WMainWindow* parent)
     m_giInfoTxtInCenter->setText("");
     m_scene->addItem(m_giInfoTxtInCenter);
 
+    // F0 preview
+    m_yin = new YINEstimator();
+    m_giF0Preview = new QAEGISampledSignal(&m_f0preview_ts, &m_f0preview_f0s, this);
+    m_giF0Preview->setShowZeroValues(false);
+    m_giF0Preview->setZValue(2.0); // Above the F0 files
+    m_giF0Preview->hide();
+    m_scene->addItem(m_giF0Preview);
+    m_f0previewtimer = new QTimer(this);
+    m_f0previewtimer->setSingleShot(true);
+    m_f0previewtimer->setInterval(100);
+    connect(m_f0previewtimer, SIGNAL(timeout()), this, SLOT(updateF0Preview()));
+    connect(m_aSpectrogramShowF0Preview, SIGNAL(toggled(bool)), this, SLOT(showF0Preview(bool)));
+    connect(gMW->m_dlgSettings->ui->dsbEstimationF0Min, SIGNAL(valueChanged(double)), this, SLOT(requestF0Preview()));
+    connect(gMW->m_dlgSettings->ui->dsbEstimationF0Max, SIGNAL(valueChanged(double)), this, SLOT(requestF0Preview()));
+    connect(gMW->m_dlgSettings->ui->sbEstimationStepSize, SIGNAL(valueChanged(double)), this, SLOT(requestF0Preview()));
+
     // Play Cursor
-    m_giPlayCursor = new QGraphicsLineItem(0.0, 0.0, 0.0, -100000, NULL);
-    QPen playCursorPen(QColor(255, 0, 0));
-    playCursorPen.setCosmetic(true);
-    playCursorPen.setWidth(2);
-    m_giPlayCursor->setPen(playCursorPen);
+    m_playcursor = new GVPlayCursor(this);
     playCursorSet(0.0, false);
-    m_scene->addItem(m_giPlayCursor);
 
     // Selection
     m_currentAction = CANothing;
@@ -248,6 +269,9 @@ GVSpectrogram::GVSpectrogram(WMainWindow* parent)
     m_contextmenu.addAction(m_aSpectrogramShowGrid);
     m_contextmenu.addAction(m_aSpectrogramShowHarmonics);
     m_contextmenu.addSeparator();
+    m_contextmenu.addAction(m_aSpectrogramShowF0Preview);
+    m_contextmenu.addAction(gMW->ui->actionEstimationF0);
+    m_contextmenu.addSeparator();
     m_contextmenu.addAction(m_aAutoUpdate);
     m_contextmenu.addSeparator();
     m_contextmenu.addAction(m_aShowProperties);
@@ -290,6 +314,48 @@ void GVSpectrogram::showHarmonics(bool show){
     m_scene->update();
 }
 
+void GVSpectrogram::showF0Preview(bool show){
+    if(show)
+        updateF0Preview();
+    else{
+        m_f0previewtimer->stop();
+        m_giF0Preview->hide();
+        m_scene->update();
+    }
+}
+
+// Estimate the preview once the view and the parameters stop changing
+void GVSpectrogram::requestF0Preview(){
+    if(m_aSpectrogramShowF0Preview->isChecked())
+        m_f0previewtimer->start();
+}
+
+void GVSpectrogram::updateF0Preview(){
+    FTSound* csnd = gFL->getCurrentFTSound(true);
+    if(!m_aSpectrogramShowF0Preview->isChecked() || csnd==NULL || !csnd->isVisible() || viewport()->width()<1){
+        m_giF0Preview->hide();
+        return;
+    }
+
+    QRectF viewrect = mapToScene(viewport()->rect()).boundingRect();
+    double tstart = std::max(0.0, viewrect.left());
+    double tend = std::min(csnd->getLastSampleTime(), viewrect.right());
+    // No need for more than one value per pixel
+    double step = std::max(gMW->m_dlgSettings->ui->sbEstimationStepSize->value(), (tend-tstart)/viewport()->width());
+
+    m_yin->estimate(csnd->wav, gFL->getFs(), csnd->m_giWavForWaveform->delay(), tstart, tend, step, gMW->m_dlgSettings->ui->dsbEstimationF0Min->value(), gMW->m_dlgSettings->ui->dsbEstimationF0Max->value(), m_f0preview_ts, m_f0preview_f0s);
+
+    QPen pen(csnd->getColor());
+    pen.setCosmetic(true);
+    pen.setWidth(2);
+    pen.setStyle(Qt::DashLine);
+    m_giF0Preview->setPen(pen);
+    m_giF0Preview->updateMinMaxValues();
+    m_giF0Preview->updateGeometry();
+    m_giF0Preview->show();
+    m_scene->update();
+}
+
 void GVSpectrogram::amplitudeExtentSlidersChanged(){
     if(!gMW->isLoading()) {
         QString tt;
@@ -542,6 +608,7 @@ void GVSpectrogram::viewSet(QRectF viewrect, bool forwardsync) {
 
         updateTextsGeometry();
         m_giGrid->updateLines();
+        requestF0Preview();
 
         if(forwardsync){
             if(gMW->m_gvWaveform && !gMW->m_gvWaveform->viewport()->size().isEmpty()) { // && gMW->ui->actionShowWaveform->isChecked()
@@ -602,6 +669,8 @@ void GVSpectrogram::scrollContentsBy(int dx, int dy) {
     QGraphicsView::scrollContentsBy(dx, dy);
 
     m_giGrid->updateLines();
+    if(dx!=0)
+        requestF0Preview();
 }
 
 void GVSpectrogram::wheelEvent(QWheelEvent* event) {
@@ -1239,16 +1308,20 @@ void GVSpectrogram::playCursorSet(double t, bool forwardsync){
         if(m_selection.width()>0)
             playCursorSet(m_selection.left(), forwardsync);
         else
-            m_giPlayCursor->setPos(QPointF(gMW->m_gvWaveform->m_initialPlayPosition, 0));
+            m_playcursor->move(gMW->m_gvWaveform->m_initialPlayPosition);
     }
     else{
-        m_giPlayCursor->setPos(QPointF(t, 0));
+        m_playcursor->move(t);
     }
 
     if(gMW->m_gvWaveform && forwardsync)
         gMW->m_gvWaveform->playCursorSet(t, false);
 }
 
+void GVSpectrogram::drawForeground(QPainter* painter, const QRectF& rect){
+    m_playcursor->draw(painter, rect.top(), rect.bottom());
+}
+
 void GVSpectrogram::drawBackground(QPainter* painter, const QRectF& rect){
     Q_UNUSED(rect)
 //    cout << QTime::currentTime().toString("hh:mm:ss.zzz").toLocal8Bit().constData() << ": GVSpectrogram::drawBackground " << rect.left() << " " << rect.right() << " " << rect.top() << " " << rect.bottom() << endl;
@@ -1372,9 +1445,12 @@ GVSpectrogram::~GVSpectrogram(){
     m_stftcomputethread->wait();
     delete m_stftcomputethread;
     delete m_dlgSettings;
+    delete m_yin;
+    delete m_playcursor;
 
     delete m_aAutoUpdate;
     delete m_aSpectrogramShowHarmonics;
+    delete m_aSpectrogramShowF0Preview;
     delete m_aSpectrogramShowGrid;
     delete m_aShowProperties;
 }
@@ -29,6 +29,9 @@ file provided in the source code of DFasma. Another copy can be found at
 #include <QThread>
 #include <QMenu>
 class QTime;
+class QTimer;
+class QAEGISampledSignal;
+class GVPlayCursor;
 
 #include "qaesigproc.h"
 #include "qaegigrid.h"
@@ -40,6 +43,7 @@ class GVSpectrogramWDialogSettings;
 class MainWindow;
 class QSpinBox;
 class STFTComputeThread;
+class YINEstimator;
 
 class GVSpectrogram : public QGraphicsView
 {
@@ -79,10 +83,17 @@ public:
     QGraphicsSimpleTextItem* m_giMouseCursorTxtFreq;
     void setMouseCursorPosition(QPointF p, bool forwardsync);
 
-    QGraphicsLineItem* m_giPlayCursor;
+    GVPlayCursor* m_playcursor; // Drawn in the foreground, so that moving it repaints only its strips
 
     QAEGIGrid* m_giGrid;
 
+    // Fast F0 estimate of the current sound in the visible time range
+    YINEstimator* m_yin;
+    std::vector<double> m_f0preview_ts;
+    std::vector<double> m_f0preview_f0s;
+    QAEGISampledSignal* m_giF0Preview;
+    QTimer* m_f0previewtimer; // Wait for the view to settle before estimating
+
     QPointF m_selection_pressedp;
     bool m_topismax;
     bool m_bottomismin;
@@ -107,12 +118,14 @@ public:
 
     void viewSet(QRectF viewrect=QRectF(), bool forwardsync=true);
     void drawBackground(QPainter* painter, const QRectF& rect);
+    void drawForeground(QPainter* painter, const QRectF& rect);
     void draw_spectrogram(QPainter* painter, const QRectF& rect, const QRectF& viewrect, FTSound* snd);
 
     ~GVSpectrogram();
 
     QAction* m_aSpectrogramShowGrid;
     QAction* m_aSpectrogramShowHarmonics;
+    QAction* m_aSpectrogramShowF0Preview;
     QAction* m_aAutoUpdate;
     QAction* m_aZoomOnSelection;
     QAction* m_aSelectionClear;
@@ -127,6 +140,9 @@ public slots:
     void showScrollBars(bool show);
     void gridSetVisible(bool visible);
     void showHarmonics(bool show);
+    void showF0Preview(bool show);
+    void requestF0Preview();
+    void updateF0Preview();
 
     void allSoundsChanged();
     void playCursorSet(double t, bool forwardsync);
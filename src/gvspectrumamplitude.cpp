@@ -528,7 +528,7 @@ void GVSpectrumAmplitude::updateDFTs(){
 
             if(!snd->m_dftparams.isEmpty()
                && snd->m_dftparams==m_trgDFTParameters
-               && snd->m_dftparams.wav==snd->wavtoplay
+               && snd->m_dftparams.wav==&(snd->wav)
                && snd->m_dftparams.ampscale==snd->m_giWavForWaveform->gain()
                && snd->m_dftparams.delay==snd->m_giWavForWaveform->delay())
                 continue;
@@ -540,8 +540,8 @@ void GVSpectrumAmplitude::updateDFTs(){
             for(; n<m_trgDFTParameters.winlen; n++){
                 wn = m_trgDFTParameters.nl+n - snd->m_giWavForWaveform->delay();
 
-                if(wn>=0 && wn<int(snd->wavtoplay->size())) {
-                    WAVTYPE value = gain*(*(snd->wavtoplay))[wn];
+                if(wn>=0 && wn<int(snd->wav.size())) {
+                    WAVTYPE value = gain*snd->sampleToPlay(wn);
 
                     if(value>1.0)       value = 1.0;
                     else if(value<-1.0) value = -1.0;
@@ -613,7 +613,7 @@ void GVSpectrumAmplitude::updateDFTs(){
 
             // Convert the spectrum values to log values
             snd->m_dftparams = m_trgDFTParameters;
-            snd->m_dftparams.wav = snd->wavtoplay;
+            snd->m_dftparams.wav = &(snd->wav);
             snd->m_dftparams.ampscale = snd->m_giWavForWaveform->gain();
             snd->m_dftparams.delay = snd->m_giWavForWaveform->delay();
 
@@ -428,6 +428,7 @@ void GVSpectrumGroupDelay::mouseMoveEvent(QMouseEvent* event){
             currentftsound->m_giWavForWaveform->setDelay(m_pressed_delay + dt*gFL->getFs());
 
             currentftsound->needDFTUpdate();
+            currentftsound->setStatus();
 
             gMW->m_gvWaveform->m_scene->update();
             gMW->m_gvSpectrumAmplitude->updateDFTs();
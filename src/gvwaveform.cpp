@@ -36,8 +36,10 @@ file provided in the source code of DFasma. Another copy can be found at
 #include "gvspectrogram.h"
 #include "wgenerictimevalue.h"
 #include "gvgenerictimevalue.h"
+#include "gvplaycursor.h"
 
 #include <iostream>
+#include <algorithm>
 using namespace std;
 
 #include <QtGlobal>
@@ -179,14 +181,8 @@ GVWaveform::GVWaveform(WMainWindow* parent)
     m_contextmenu.addAction(m_aWaveformStickToSTFTWindows);
 
     // Play Cursor
-    m_giPlayCursor = new QGraphicsLineItem(0.0, -1.0, 0.0, 1.0, NULL);
-    QPen playCursorPen(QColor(255, 0, 0));
-    playCursorPen.setCosmetic(true);
-    playCursorPen.setWidth(2);
-    m_giPlayCursor->setPen(playCursorPen);
-    m_giPlayCursor->setZValue(100);
+    m_playcursor = new GVPlayCursor(this);
     playCursorSet(0.0, false);
-    m_scene->addItem(m_giPlayCursor);
 
     showScrollBars(gMW->m_dlgSettings->ui->cbViewsScrollBarsShow->isChecked());
     connect(gMW->m_dlgSettings->ui->cbViewsScrollBarsShow, SIGNAL(toggled(bool)), this, SLOT(showScrollBars(bool)));
@@ -588,13 +584,10 @@ void GVWaveform::mousePressEvent(QMouseEvent* event){
                 m_ca_pressed_index=-1;
                 FTLabels* selectedlabels = gFL->getCurrentFTLabels();
                 if(selectedlabels){
-                    for(int lli=0; m_ca_pressed_index==-1 && lli<int(selectedlabels->starts.size()); lli++) {
-                        QPoint slp = mapFromScene(QPointF(selectedlabels->starts[lli],0));
-                        if(std::abs(slp.x()-event->x())<5) {
-                            m_ca_pressed_index = lli;
-                            m_currentAction = CALabelModifPosition;
-                            gMW->setEditing(selectedlabels);
-                        }
+                    m_ca_pressed_index = findCloseLabel(selectedlabels, event->x());
+                    if(m_ca_pressed_index!=-1) {
+                        m_currentAction = CALabelModifPosition;
+                        gMW->setEditing(selectedlabels);
                     }
                     if(m_ca_pressed_index==-1) {
                         if(event->modifiers().testFlag(Qt::ControlModifier)){
@@ -800,7 +793,7 @@ void GVWaveform::mouseMoveEvent(QMouseEvent* event){
     else if(m_currentAction==CALabelModifPosition){
         FTLabels* ftlabel = gFL->getCurrentFTLabels();
         if(ftlabel) {
-            ftlabel->moveLabel(m_ca_pressed_index, p.x());
+            m_ca_pressed_index = ftlabel->moveLabel(m_ca_pressed_index, p.x());
             updateTextsGeometry();
         }
     }
@@ -839,13 +832,8 @@ void GVWaveform::mouseMoveEvent(QMouseEvent* event){
             // Check if a marker is close and show the horiz split cursor if true
             bool foundclosemarker = false;
             FTLabels* ftl = gFL->getCurrentFTLabels();
-            if(ftl){
-                for(int lli=0; !foundclosemarker && lli<ftl->getNbLabels(); lli++) {
-                    // cout << ftl->labels[lli].toLatin1().data() << ": " << ftl->starts[lli] << endl;
-                    QPoint slp = mapFromScene(QPointF(ftl->starts[lli],0));
-                    foundclosemarker = std::abs(slp.x()-event->x())<5;
-                }
-            }
+            if(ftl)
+                foundclosemarker = findCloseLabel(ftl, event->x())!=-1;
             if(foundclosemarker)
                 setCursor(Qt::SplitHCursor);
             else
@@ -887,12 +875,6 @@ void GVWaveform::mouseReleaseEvent(QMouseEvent* event){
         m_mouseSelection.setRight(tmp);
     }
 
-    if(m_currentAction==CALabelModifPosition){
-        FTLabels* ftlabel = gFL->getCurrentFTLabels();
-        if(ftlabel)
-            ftlabel->finishEditing();
-    }
-
     if(gMW->ui->actionEditMode->isChecked()){
         gMW->setEditing(NULL);
     }
@@ -930,25 +912,44 @@ void GVWaveform::mouseDoubleClickEvent(QMouseEvent* event){
 
 }
 
+// Index of the label the closest to the pixel x, if closer than 5 pixels (-1 otherwise)
+int GVWaveform::findCloseLabel(FTLabels* ftl, int x){
+    if(ftl->getNbLabels()==0)
+        return -1;
+
+    int index = ftl->findLabel(mapToScene(QPoint(x, 0)).x());
+    int closest = -1;
+    int closestdist = 5;
+    for(int lli=std::max(0, index); lli<=index+1 && lli<ftl->getNbLabels(); ++lli){
+        int dist = std::abs(mapFromScene(QPointF(ftl->getStart(lli),0)).x()-x);
+        if(dist<closestdist){
+            closest = lli;
+            closestdist = dist;
+        }
+    }
+    return closest;
+}
+
 void GVWaveform::selectSegmentFindStartEnd(double x, FTLabels* ftl, double& start, double& end){
     start = -1;
     end = -1;
     if(ftl && ftl->getNbLabels()>0) {
-        if(x<ftl->starts[0]){
+        if(x<ftl->getStart(0)){
             start = 0.0;
-            end = ftl->starts[0];
+            end = ftl->getStart(0);
         }
-        else if(x>ftl->starts.back()){
-            start = ftl->starts.back();
+        else if(x>ftl->getStart(ftl->getNbLabels()-1)){
+            start = ftl->getStart(ftl->getNbLabels()-1);
             end = gFL->getMaxLastSampleTime();
         }
         else{
-            int index = -1;
-            for(int lli=0; lli<ftl->getNbLabels(); lli++) // TODO Simplify and Speed up
-                if(x>ftl->starts[lli])
-                    index = lli;
-            start = ftl->starts[index];
-            end = ftl->starts[index+1];
+            // Last label strictly before x
+            int index = ftl->findLabel(x);
+            while(index>0 && ftl->getStart(index)>=x)
+                index--;
+            index = std::max(0, std::min(index, ftl->getNbLabels()-2));
+            start = ftl->getStart(index);
+            end = ftl->getStart(index+1);
         }
     }
 }
@@ -957,7 +958,7 @@ void GVWaveform::selectSegment(double x, bool add){
     // Check if a marker is close and show the horiz split cursor if true
     FTLabels* ftl = gFL->getCurrentFTLabels(true);
     if(ftl && ftl->getNbLabels()>0) {
-        if(ftl->starts.size()>0){
+        if(ftl->getNbLabels()>0){
             double start, end;
             selectSegmentFindStartEnd(x, ftl, start, end);
             if(add){
@@ -1035,12 +1036,11 @@ void GVWaveform::keyPressEvent(QKeyEvent* event){
             if(ftlabel && !FTGraphicsLabelItem::isEditing()){
                 if(event->text().size()>0){
                     if(m_currentAction==CALabelWritting && m_ftlabel_current_index!=-1){
-                        ftlabel->changeText(m_ftlabel_current_index, ftlabel->waveform_labels[m_ftlabel_current_index]->toPlainText()+event->text());
+                        ftlabel->changeText(m_ftlabel_current_index, ftlabel->labels[m_ftlabel_current_index]+event->text());
                     }
                     else{
                         m_currentAction = CALabelWritting;
-                        ftlabel->addLabel(m_giMouseCursorLine->pos().x(), event->text());
-                        m_ftlabel_current_index = ftlabel->getNbLabels()-1;
+                        m_ftlabel_current_index = ftlabel->addLabel(m_giMouseCursorLine->pos().x(), event->text());
                         gFL->fileInfoUpdate();
                     }
                     updateTextsGeometry(); // TODO Could be avoided maybe
@@ -1147,6 +1147,7 @@ void GVWaveform::fixTimeLimitsToSamples(QRectF& selection, const QRectF& mouseSe
 
 GVWaveform::~GVWaveform(){
     delete m_toolBar;
+    delete m_playcursor;
 }
 
 void GVWaveform::contextMenuEvent(QContextMenuEvent *event){
@@ -1179,6 +1180,10 @@ void GVWaveform::selectionSet(QRectF selection, bool forwardsync){
 
     playCursorSet(m_selection.left(), true); // Put the play cursor
 
+    // Follow the selection when looping
+    if(m_selection.width()>0 && gMW->m_audioengine && gMW->m_audioengine->isLooping())
+        gMW->m_audioengine->setLoopSelection(m_selection.left(), m_selection.right());
+
     if(m_selection.width()>0){
         m_aZoomOnSelection->setEnabled(true);
         m_aSelectionClear->setEnabled(true);
@@ -1268,7 +1273,6 @@ void GVWaveform::updateTextsGeometry(){
 }
 
 void GVWaveform::drawBackground(QPainter* painter, const QRectF& rect){
-    Q_UNUSED(rect)
     // COUTD << "GVWaveform::drawBackground rect:" << rect << endl;
 
     updateTextsGeometry(); // TODO Since called here, can be removed from many other places
@@ -1284,20 +1288,29 @@ void GVWaveform::drawBackground(QPainter* painter, const QRectF& rect){
             outlinePen.setWidth(0);
             painter->setPen(outlinePen);
 
+            // Only those in the exposed rect (the times are sorted)
             gMW->m_gvSpectrogram->m_stftcomputethread->m_mutex_changingstft.lock();
-            for(size_t wci=0; wci<cursnd->m_stftts.size(); wci++)
-                painter->drawLine(QLineF(cursnd->m_stftts[wci], -1.0, cursnd->m_stftts[wci], 1.0));
+            std::vector<FFTTYPE>::const_iterator it = std::lower_bound(cursnd->m_stftts.begin(), cursnd->m_stftts.end(), rect.left());
+            std::vector<FFTTYPE>::const_iterator itend = std::upper_bound(it, cursnd->m_stftts.end(), rect.right());
+            for(; it!=itend; ++it)
+                painter->drawLine(QLineF(*it, -1.0, *it, 1.0));
             gMW->m_gvSpectrogram->m_stftcomputethread->m_mutex_changingstft.unlock();
         }
     }
 }
 
+void GVWaveform::drawForeground(QPainter* painter, const QRectF& rect){
+    Q_UNUSED(rect)
+
+    m_playcursor->draw(painter, -1.0, 1.0);
+}
+
 void GVWaveform::playCursorSet(double t, bool forwardsync){
     if(t==-1){
         if(m_selection.width()>0)
             playCursorSet(m_selection.left(), forwardsync);
         else
-            m_giPlayCursor->setPos(QPointF(m_initialPlayPosition, 0));
+            m_playcursor->move(m_initialPlayPosition);
 
         // Put back the DFT window at selection times
         if(gMW->m_gvSpectrumAmplitude && gMW->m_gvSpectrumPhase
@@ -1305,7 +1318,7 @@ void GVWaveform::playCursorSet(double t, bool forwardsync){
             gMW->m_gvSpectrumAmplitude->setWindowRange(m_selection.left(), m_selection.right());
     }
     else{
-        m_giPlayCursor->setPos(QPointF(t, 0));
+        m_playcursor->move(t);
 
         // Move the DFT window according to play cursor
         if(gMW->m_gvSpectrumAmplitude && gMW->m_gvSpectrumPhase
@@ -1323,5 +1336,5 @@ void GVWaveform::playCursorSet(double t, bool forwardsync){
 }
 
 double GVWaveform::getPlayCursorPosition() const{
-    return m_giPlayCursor->pos().x();
+    return m_playcursor->position();
 }
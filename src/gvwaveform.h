@@ -31,6 +31,7 @@ file provided in the source code of DFasma. Another copy can be found at
 class QToolBar;
 class WMainWindow;
 class FTLabels;
+class GVPlayCursor;
 
 class GVWaveform : public QGraphicsView
 {
@@ -66,7 +67,7 @@ public:
     // QGraphicsRectItem* m_giMouseSelection; // For debug purpose
 //    QGraphicsItemGroup* m_yTicksLabels; // TODO Use this instead of print them individually ?
     qreal m_initialPlayPosition;
-    QGraphicsLineItem* m_giPlayCursor;
+    GVPlayCursor* m_playcursor; // Drawn in the foreground, so that moving it repaints only its strips
     QGraphicsRectItem* m_giFilteredSelection;
 
     // Graphic items
@@ -101,9 +102,11 @@ public:
     void keyPressEvent(QKeyEvent* event);
 
     void drawBackground(QPainter* painter, const QRectF& rect);
+    void drawForeground(QPainter* painter, const QRectF& rect);
 
 //    void cursorUpdate(float x);
 
+    int findCloseLabel(FTLabels* ftl, int x);
     void selectSegmentFindStartEnd(double x, FTLabels* ftl, double& start, double& end);
     void selectSegment(double x, bool add);
     void selectRemoveSegment(double x);
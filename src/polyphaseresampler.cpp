@@ -0,0 +1,197 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+#include "polyphaseresampler.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <QString>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <qmath.h>
+
+#define POLYPHASERESAMPLER_MAXPHASES 512
+#define POLYPHASERESAMPLER_CHUNKLEN 65536 // [output samples] Work unit of the threads
+
+static long long greatestCommonDivisor(long long a, long long b) {
+    while(b!=0){
+        long long t = a%b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+PolyphaseResampler::PolyphaseResampler(double fsin, double fsout, int zerocrossings, double rolloff)
+    : m_fsin(fsin)
+    , m_fsout(fsout)
+    , m_up(POLYPHASERESAMPLER_MAXPHASES)
+    , m_down(0)
+{
+    if(fsin<=0.0 || fsout<=0.0)
+        throw QString("PolyphaseResampler: The sampling rates have to be positive.");
+
+    // Use the exact ratio if it doesn't need too many phases (e.g. 16kHz->48kHz: 3/1, 44.1kHz->48kHz: 160/147)
+    if(fsin==std::floor(fsin) && fsout==std::floor(fsout)){
+        long long d = greatestCommonDivisor((long long)(fsin), (long long)(fsout));
+        if((long long)(fsout)/d<=POLYPHASERESAMPLER_MAXPHASES){
+            m_up = int((long long)(fsout)/d);
+            m_down = int((long long)(fsin)/d);
+        }
+    }
+
+    // Cutoff below the lowest of the two Nyquist frequencies [cycles per input sample]
+    double fc = 0.5*rolloff*std::min(1.0, fsout/fsin);
+    m_halflen = int(std::ceil(zerocrossings/(2.0*fc)));
+    m_taps = 2*m_halflen;
+
+    // The p-th phase delays the signal by p/m_up input sample.
+    // The last phase (p=m_up) is used only for the interpolation between phases.
+    m_bank.resize((m_up+1)*m_taps);
+    for(int p=0; p<=m_up; ++p){
+        WAVTYPE* coefs = &(m_bank[p*m_taps]);
+        double sum = 0.0;
+        for(int k=0; k<m_taps; ++k){
+            double u = double(p)/m_up + m_halflen - 1 - k; // [input samples] Distance to the output sample
+            double h = 0.0;
+            if(std::abs(u)<m_halflen){
+                double x = 2.0*fc*u;
+                h = 2.0*fc*((x==0.0)?1.0:std::sin(M_PI*x)/(M_PI*x));
+                double r = u/m_halflen; // Blackman window
+                h *= 0.42 + 0.5*std::cos(M_PI*r) + 0.08*std::cos(2.0*M_PI*r);
+            }
+            coefs[k] = h;
+            sum += h;
+        }
+        for(int k=0; k<m_taps; ++k) // Unit gain at DC for every phase
+            coefs[k] /= sum;
+    }
+}
+
+size_t PolyphaseResampler::outputLength(size_t inlen) const {
+    if(m_down>0)
+        return size_t(((long long)(inlen)*m_up + m_down-1)/m_down);
+    else
+        return size_t(std::ceil(inlen*m_fsout/m_fsin));
+}
+
+long long PolyphaseResampler::inputIndex(long long m) const {
+    if(m_down>0)
+        return (m*m_down)/m_up;
+    else
+        return (long long)(std::floor(m*(m_fsin/m_fsout)));
+}
+
+void PolyphaseResampler::resample(const WAVTYPE* in, size_t inlen, WAVTYPE* out, size_t outstart, size_t outend) const {
+    if(outend>outstart)
+        resampleBlock(in, 0, inlen, out+outstart, (long long)(outstart), outend-outstart);
+}
+
+void PolyphaseResampler::resampleBlock(const WAVTYPE* in, long long instart, size_t inlen, WAVTYPE* out, long long outstart, size_t outlen) const {
+
+    const double step = m_fsin/m_fsout; // [input samples]
+
+    for(size_t i=0; i<outlen; ++i){
+        const long long m = outstart+(long long)(i);
+
+        // Find the input sample preceding the output time and the phase to use
+        long long n0;
+        int p;
+        WAVTYPE a = 0.0; // Interpolation weight between phases p and p+1
+        if(m_down>0){
+            long long t = m*m_down;
+            n0 = t/m_up;
+            p = int(t - n0*m_up);
+        }
+        else{
+            double t = m*step;
+            n0 = (long long)(std::floor(t));
+            double pos = (t-n0)*m_up;
+            p = std::min(int(pos), m_up-1);
+            a = pos - p;
+        }
+
+        const WAVTYPE* c0 = &(m_bank[p*m_taps]);
+        const WAVTYPE* c1 = c0 + m_taps;
+        long long first = n0 - m_halflen + 1 - instart; // First input sample under the filter
+        WAVTYPE y0 = 0.0;
+        WAVTYPE y1 = 0.0;
+
+        if(first>=0 && first+m_taps<=(long long)(inlen)){
+            // Plain dot products, which the compiler can vectorize
+            const WAVTYPE* x = in + first;
+            if(a==0.0){
+                for(int k=0; k<m_taps; ++k)
+                    y0 += c0[k]*x[k];
+            }
+            else{
+                for(int k=0; k<m_taps; ++k){
+                    y0 += c0[k]*x[k];
+                    y1 += c1[k]*x[k];
+                }
+            }
+        }
+        else{
+            // Close to the boundaries, the signal is zero outside of [0,inlen[
+            int kstart = int(std::max(0LL, -first));
+            int kend = int(std::min((long long)(m_taps), (long long)(inlen)-first));
+            for(int k=kstart; k<kend; ++k){
+                y0 += c0[k]*in[first+k];
+                if(a!=0.0)
+                    y1 += c1[k]*in[first+k];
+            }
+        }
+
+        out[i] = (a==0.0)?y0:(y0+a*(y1-y0));
+    }
+}
+
+class PolyphaseResamplerChunk : public QRunnable {
+    const PolyphaseResampler* m_resampler;
+    const WAVTYPE* m_in;
+    size_t m_inlen;
+    WAVTYPE* m_out;
+    size_t m_outstart;
+    size_t m_outend;
+
+public:
+    PolyphaseResamplerChunk(const PolyphaseResampler* resampler, const WAVTYPE* in, size_t inlen, WAVTYPE* out, size_t outstart, size_t outend)
+        : m_resampler(resampler), m_in(in), m_inlen(inlen), m_out(out), m_outstart(outstart), m_outend(outend)
+    {}
+    void run() {
+        m_resampler->resample(m_in, m_inlen, m_out, m_outstart, m_outend);
+    }
+};
+
+void PolyphaseResampler::resample(const std::vector<WAVTYPE>& in, std::vector<WAVTYPE>& out) const {
+
+    out.resize(outputLength(in.size()));
+    if(out.empty())
+        return;
+
+    // The chunks write disjoint parts of the output, they don't need any lock
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    for(size_t start=0; start<out.size(); start+=POLYPHASERESAMPLER_CHUNKLEN)
+        pool.start(new PolyphaseResamplerChunk(this, &(in[0]), in.size(), &(out[0]), start, std::min(out.size(), start+POLYPHASERESAMPLER_CHUNKLEN)));
+    pool.waitForDone();
+}
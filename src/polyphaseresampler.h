@@ -0,0 +1,71 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POLYPHASERESAMPLER_H
+#define POLYPHASERESAMPLER_H
+
+#include <vector>
+#include <cstddef>
+
+#ifdef SIGPROC_FLOAT
+#define WAVTYPE float
+#else
+#define WAVTYPE double
+#endif
+
+// Resampling through a bank of windowed-sinc filters (one per fractional delay).
+// If the ratio of the sampling rates reduces to a fraction with a small
+// denominator, each output sample uses exactly one phase of the bank.
+// Otherwise, the two closest phases are linearly interpolated.
+class PolyphaseResampler
+{
+    double m_fsin;  // [Hz]
+    double m_fsout; // [Hz]
+    int m_up;       // Number of phases in the bank
+    int m_down;     // If >0, the ratio is exactly m_up/m_down
+    int m_halflen;  // [input samples] Half length of the filters
+    int m_taps;     // Number of coefficients of each phase
+    std::vector<WAVTYPE> m_bank; // (m_up+1) phases of m_taps coefficients, contiguous
+
+public:
+    PolyphaseResampler(double fsin, double fsout, int zerocrossings=16, double rolloff=0.95);
+
+    double fsIn() const {return m_fsin;}
+    double fsOut() const {return m_fsout;}
+    int halfLength() const {return m_halflen;}
+    size_t outputLength(size_t inlen) const;
+
+    // Index of the input sample preceding the output sample m
+    // (the output sample m uses the inputs [inputIndex(m)-halfLength()+1, inputIndex(m)+halfLength()])
+    long long inputIndex(long long m) const;
+
+    // Compute the output samples [outstart,outend[ into out[outstart..outend-1]
+    void resample(const WAVTYPE* in, size_t inlen, WAVTYPE* out, size_t outstart, size_t outend) const;
+
+    // For streaming, in[0] is the input sample of index instart
+    // and out[0] receives the output sample of index outstart
+    // (the signal is zero outside of the given input samples)
+    void resampleBlock(const WAVTYPE* in, long long instart, size_t inlen, WAVTYPE* out, long long outstart, size_t outlen) const;
+
+    // Resample the whole signal, by chunks shared among the available cores
+    void resample(const std::vector<WAVTYPE>& in, std::vector<WAVTYPE>& out) const;
+};
+
+#endif // POLYPHASERESAMPLER_H
@@ -0,0 +1,79 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SLIDINGWINDOWMAXIMUM_H
+#define SLIDINGWINDOWMAXIMUM_H
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#ifdef SIGPROC_FLOAT
+#define WAVTYPE float
+#else
+#define WAVTYPE double
+#endif
+
+// Maximum of the last values pushed, over a sliding window.
+// O(1) amortized per value, using a monotonic queue in a ring buffer
+// (allocated by reset() only).
+class SlidingWindowMaximum
+{
+    std::vector<WAVTYPE> m_values;  // Decreasing candidates for the maximum
+    std::vector<int64_t> m_indices; // Index of each candidate
+    size_t m_head;
+    size_t m_size;
+    int64_t m_count;  // Number of values pushed since reset
+    int64_t m_winlen;
+
+public:
+    SlidingWindowMaximum() : m_head(0), m_size(0), m_count(0), m_winlen(0) {}
+
+    void reset(int64_t winlen) {
+        m_winlen = std::max(int64_t(1), winlen);
+        m_values.resize(m_winlen);
+        m_indices.resize(m_winlen);
+        m_head = 0;
+        m_size = 0;
+        m_count = 0;
+    }
+    inline void push(WAVTYPE value) {
+        if(m_winlen==0)
+            return;
+        // Drop the front candidate if it goes out of the window
+        // (first, since the buffer is full after a decreasing run of m_winlen values)
+        if(m_size>0 && m_indices[m_head]<=m_count-m_winlen){
+            m_head = (m_head+1)%m_winlen;
+            m_size--;
+        }
+        // Drop the candidates which can't be the maximum anymore
+        while(m_size>0 && m_values[(m_head+m_size-1)%m_winlen]<=value)
+            m_size--;
+        size_t back = (m_head+m_size)%m_winlen;
+        m_values[back] = value;
+        m_indices[back] = m_count;
+        m_size++;
+        m_count++;
+    }
+    inline WAVTYPE max() const {return (m_size>0)?m_values[m_head]:0.0;}
+};
+
+#endif // SLIDINGWINDOWMAXIMUM_H
@@ -0,0 +1,51 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SORTEDMOVE_H
+#define SORTEDMOVE_H
+
+#include <vector>
+#include <algorithm>
+
+// Moving one element of sorted parallel arrays (e.g. the labels of FTLabels)
+// to keep them sorted when its key changes.
+// The elements in between are shifted by one, which is O(n) move-assignments
+// (moving does not allocate, but each QString in between is move-assigned).
+
+// Index where the element at index has to go for its key to become t
+inline int sortedMoveIndex(const std::vector<double>& keys, int index, double t) {
+    if(index>0 && t<keys[index-1])
+        return int(std::upper_bound(keys.begin(), keys.begin()+index, t)-keys.begin());
+    else if(index<int(keys.size())-1 && t>keys[index+1])
+        return int(std::lower_bound(keys.begin()+index+1, keys.end(), t)-keys.begin())-1;
+    return index;
+}
+
+// Move the element at index to newindex, shifting the ones in between
+template<typename T>
+void sortedMove(std::vector<T>& values, int index, int newindex) {
+    if(newindex<index)
+        std::rotate(values.begin()+newindex, values.begin()+index, values.begin()+index+1);
+    else if(newindex>index)
+        std::rotate(values.begin()+index, values.begin()+index+1, values.begin()+newindex+1);
+}
+
+#endif // SORTEDMOVE_H
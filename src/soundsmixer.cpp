@@ -0,0 +1,414 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#include "soundsmixer.h"
+
+#include <algorithm>
+#include <qmath.h>
+
+SoundsMixer::SoundsMixer(QObject* parent)
+    : QIODevice(parent)
+    , m_resampler(NULL)
+    , m_resampleoutpos(0)
+    , m_resamplehiststart(0)
+    , m_resamplehistlen(0)
+    , m_resamplehistcap(0)
+    , m_switchto(NULL)
+    , m_current(NULL)
+    , m_fadingout(NULL)
+    , m_fadepos(0)
+    , m_loopchanged(0)
+    , m_loopstart(0)
+    , m_loopend(0)
+    , m_outputframes(0)
+    , m_playedseq(0)
+    , m_playedstart(0)
+    , m_playedend(0)
+    , m_playedoriginms(0)
+{
+}
+
+SoundsMixer::~SoundsMixer() {
+    delete m_resampler;
+}
+
+double SoundsMixer::setPlay(const std::vector<FTSound*>& sounds, const QAudioFormat& format, double tstart, double tstop, double fstart, double fstop, double headroom) {
+    m_sounds = sounds;
+    m_format = format;
+
+    // The sounds are played at their own rate, the mix is resampled if necessary
+    m_soundformat = format;
+    if(!m_sounds.empty())
+        m_soundformat.setSampleRate(int(m_sounds[0]->fs));
+
+    double tobeplayed = 0.0;
+    if(m_sounds.size()==1){
+        tobeplayed = m_sounds[0]->setPlay(m_soundformat, tstart, tstop, fstart, fstop);
+    }
+    else{
+        for(size_t si=0; si<m_sounds.size(); ++si)
+            tobeplayed = std::max(tobeplayed, m_sounds[si]->setPlay(m_soundformat, tstart, tstop));
+
+        // Share the same bounds, so that the sounds stay aligned when looping
+        // (outside of its signal, a sound plays silence)
+        qint64 start = m_sounds[0]->m_start;
+        qint64 end = m_sounds[0]->m_end;
+        for(size_t si=1; si<m_sounds.size(); ++si){
+            start = std::min(start, m_sounds[si]->m_start);
+            end = std::max(end, m_sounds[si]->m_end);
+        }
+        for(size_t si=0; si<m_sounds.size(); ++si){
+            m_sounds[si]->m_start = start;
+            m_sounds[si]->m_pos = start;
+            m_sounds[si]->m_end = end;
+        }
+    }
+    m_loopchanged.store(0);
+    m_outputframes = 0;
+    if(!m_sounds.empty())
+        publishPlayed(m_sounds[0]->m_start, m_sounds[0]->m_end, 0);
+    m_current = m_sounds.empty()?NULL:m_sounds[0];
+    m_fadingout = NULL;
+    m_switchto.store(NULL);
+
+    // Pre-compute the gains and allocate everything before playing
+    int nbchannels = std::max(1, m_format.channelCount());
+    WAVTYPE mixgain = 1.0;
+    if(m_sounds.size()>1)
+        mixgain = std::pow(10.0, -headroom/20.0);
+    m_channelgains.resize(m_sounds.size()*nbchannels);
+    for(size_t si=0; si<m_sounds.size(); ++si){
+        double pan = m_sounds[si]->pan();
+        for(int c=0; c<nbchannels; ++c){
+            WAVTYPE channelgain = 1.0;
+            if(nbchannels==2 && m_sounds.size()>1){
+                // Balance: the center keeps the full level in both channels
+                if(c==0) channelgain = std::min(1.0, 1.0-pan);
+                else     channelgain = std::min(1.0, 1.0+pan);
+            }
+            m_channelgains[si*nbchannels+c] = mixgain*channelgain;
+        }
+    }
+    m_soundbuffer.resize(FTSOUND_PLAYBUFFERLEN);
+    m_fadebuffer.resize(FTSOUND_PLAYBUFFERLEN);
+    m_mixbuffer.resize(FTSOUND_PLAYBUFFERLEN*nbchannels);
+
+    if(m_soundformat.sampleRate()!=m_format.sampleRate()){
+        if(m_resampler==NULL
+           || m_resampler->fsIn()!=m_soundformat.sampleRate()
+           || m_resampler->fsOut()!=m_format.sampleRate()){
+            delete m_resampler;
+            m_resampler = NULL;
+            m_resampler = new PolyphaseResampler(m_soundformat.sampleRate(), m_format.sampleRate());
+        }
+        // The input frames needed by an output block, plus one mixed block in excess
+        m_resamplehistcap = qint64(std::ceil(FTSOUND_PLAYBUFFERLEN*double(m_soundformat.sampleRate())/m_format.sampleRate()))
+                          + 2*m_resampler->halfLength() + 2 + FTSOUND_PLAYBUFFERLEN;
+        m_resamplehist.resize(m_resamplehistcap*nbchannels);
+        m_resamplemix.resize(FTSOUND_PLAYBUFFERLEN*nbchannels);
+        m_resampleout.resize(FTSOUND_PLAYBUFFERLEN);
+        m_resampleoutpos = 0;
+        m_resamplehiststart = 0;
+        m_resamplehistlen = 0;
+    }
+    else{
+        delete m_resampler;
+        m_resampler = NULL;
+    }
+
+    QIODevice::open(QIODevice::ReadOnly);
+
+    return tobeplayed;
+}
+
+bool SoundsMixer::switchTo(FTSound* sound) {
+    if(m_sounds.size()!=1 || !isOpen())
+        return false;
+
+    // A sound already prepared can be rendered right now by the playback thread
+    // (as the current sound or the one fading out), so its playback state is left untouched
+    if(std::find(m_sounds.begin(), m_sounds.end(), sound)==m_sounds.end()
+       && std::find(m_switched.begin(), m_switched.end(), sound)==m_switched.end()){
+        sound->setPlaySwitched(m_soundformat);
+        m_switched.push_back(sound);
+    }
+    m_switchto.storeRelease(sound); // Taken at the next readData
+
+    return true;
+}
+
+// Change the bounds of the loop, taken at the next readData
+void SoundsMixer::setLoopSelection(double tstart, double tstop) {
+    if(m_sounds.empty() || !isOpen())
+        return;
+
+    if(tstart>tstop)
+        std::swap(tstart, tstop);
+    double fs = m_soundformat.sampleRate();
+    qint64 start = std::max(qint64(0), qint64(0.5+tstart*fs));
+    qint64 end = std::max(start, qint64(0.5+tstop*fs));
+
+    // A filtered sound has been prepared on its selection only,
+    // so the loop cannot go outside of it.
+    FTSound* snd = m_sounds[0];
+    if(m_sounds.size()==1 && snd->isFiltered() && snd->m_filteredend>=snd->m_filteredstart){
+        start = qBound(snd->m_filteredstart+snd->m_playdelay, start, snd->m_filteredend+snd->m_playdelay);
+        end = qBound(start, end, snd->m_filteredend+snd->m_playdelay);
+    }
+
+    m_loopmutex.lock();
+    m_loopstart = start;
+    m_loopend = end;
+    m_loopchanged.storeRelease(1);
+    m_loopmutex.unlock();
+}
+
+// The playback thread is the only writer once playing
+void SoundsMixer::publishPlayed(qint64 start, qint64 end, int originms) {
+    m_playedseq.fetchAndAddOrdered(1);
+    m_playedstart.storeRelease(int(start));
+    m_playedend.storeRelease(int(end));
+    m_playedoriginms.storeRelease(originms);
+    m_playedseq.fetchAndAddOrdered(1);
+}
+
+// Retry until the bounds have been read between two writes
+int SoundsMixer::playedBounds(qint64& start, qint64& end, int& originms) const {
+    int seq;
+    do {
+        seq = m_playedseq.loadAcquire();
+        start = m_playedstart.loadAcquire();
+        end = m_playedend.loadAcquire();
+        originms = m_playedoriginms.loadAcquire();
+    } while((seq&1) || seq!=m_playedseq.loadAcquire());
+
+    return seq;
+}
+
+void SoundsMixer::stopPlay() {
+    for(size_t si=0; si<m_sounds.size(); ++si)
+        m_sounds[si]->stopPlay();
+    for(size_t si=0; si<m_switched.size(); ++si)
+        m_switched[si]->stopPlay();
+    m_sounds.clear();
+    m_switched.clear();
+    m_current = NULL;
+    m_fadingout = NULL;
+    m_switchto.store(NULL);
+    QIODevice::close();
+}
+
+// Continue the playback with the sound asked by switchTo, if any
+void SoundsMixer::takeSwitch() {
+    FTSound* next = m_switchto.fetchAndStoreAcquire(NULL);
+    if(next==NULL || next==m_current || m_current==NULL)
+        return;
+
+    // Same position (the delay of each sound is applied while rendering)
+    qint64 fadelen = (qint64(FTSound::s_avoidclickswindow.size())-1)/2;
+    next->m_start = m_current->m_start;
+    next->m_end = m_current->m_end;
+    next->m_pos = m_current->m_pos;
+    next->m_avoidclickswinpos = std::max(m_current->m_avoidclickswinpos, fadelen); // The cross-fade replaces the fade-in
+    next->m_looptailpos = m_current->m_looptailpos;
+    next->m_looptailfadepos = m_current->m_looptailfadepos;
+
+    if(fadelen>0 && next!=m_fadingout){
+        m_fadingout = m_current;
+        m_fadepos = 0;
+    }
+    else
+        m_fadingout = NULL;
+
+    m_current = next;
+}
+
+// Apply the loop bounds asked by setLoopSelection, if any
+// (the position stays in the new loop and wraps at its end)
+void SoundsMixer::takeLoopSelection() {
+    if(m_loopchanged.loadAcquire()==0 || !m_loopmutex.tryLock())
+        return; // Otherwise, retry at the next readData
+
+    for(size_t si=0; si<m_sounds.size(); ++si){
+        m_sounds[si]->m_start = m_loopstart;
+        m_sounds[si]->m_end = m_loopend;
+        m_sounds[si]->m_pos = qBound(m_loopstart, m_sounds[si]->m_pos, m_loopend);
+    }
+    if(m_current){
+        m_current->m_start = m_loopstart;
+        m_current->m_end = m_loopend;
+        m_current->m_pos = qBound(m_loopstart, m_current->m_pos, m_loopend);
+    }
+
+    // Re-base the clock of the cursor on the position taken from now on
+    // (the frames already mixed for the resampler are played before)
+    FTSound* snd = m_current?m_current:(m_sounds.empty()?NULL:m_sounds[0]);
+    if(snd){
+        double pending = 0.0;
+        if(m_resampler)
+            pending = double(m_resamplehiststart+m_resamplehistlen-m_resampler->inputIndex(m_resampleoutpos));
+        double origin = double(m_outputframes)/m_format.sampleRate()
+                      + (pending-double(snd->m_pos-m_loopstart))/m_soundformat.sampleRate();
+        publishPlayed(m_loopstart, m_loopend, qRound(1000*origin));
+    }
+    m_loopchanged.store(0);
+
+    m_loopmutex.unlock();
+}
+
+// Mix blocklen frames of the sounds, at their own sampling rate, into the interleaved mixbuffer
+void SoundsMixer::mixBlock(WAVTYPE* mixbuffer, qint64 blocklen) {
+    const int nbchannels = std::max(1, m_format.channelCount());
+    WAVTYPE* sndbuffer = &(m_soundbuffer[0]);
+
+    std::fill(mixbuffer, mixbuffer+blocklen*nbchannels, 0.0);
+
+    for(size_t si=0; si<m_sounds.size(); ++si){
+        if(m_sounds.size()==1){
+            m_current->renderPlay(sndbuffer, blocklen);
+
+            if(m_fadingout){
+                // Cross-fade with the sound played before the switch
+                const qint64 fadelen = (qint64(FTSound::s_avoidclickswindow.size())-1)/2;
+                const qint64 len = std::min(blocklen, fadelen-m_fadepos);
+                m_fadingout->renderPlay(&(m_fadebuffer[0]), len);
+                const WAVTYPE* winin = &(FTSound::s_avoidclickswindow[m_fadepos]);
+                const WAVTYPE* winout = &(FTSound::s_avoidclickswindow[fadelen+1+m_fadepos]);
+                for(qint64 k=0; k<len; ++k)
+                    sndbuffer[k] = winin[k]*sndbuffer[k] + winout[k]*m_fadebuffer[k];
+                m_fadepos += len;
+                if(m_fadepos>=fadelen)
+                    m_fadingout = NULL;
+            }
+        }
+        else
+            m_sounds[si]->renderPlay(sndbuffer, blocklen);
+
+        const WAVTYPE* gains = &(m_channelgains[si*nbchannels]);
+        for(int c=0; c<nbchannels; ++c){
+            const WAVTYPE gain = gains[c];
+            if(gain==0.0)
+                continue;
+            WAVTYPE* out = mixbuffer+c;
+            for(qint64 k=0; k<blocklen; ++k)
+                out[k*nbchannels] += gain*sndbuffer[k];
+        }
+    }
+}
+
+// Compute the next blocklen frames at the rate of the device into the interleaved mixbuffer
+void SoundsMixer::resampleBlock(WAVTYPE* mixbuffer, qint64 blocklen) {
+    const int nbchannels = std::max(1, m_format.channelCount());
+    const int halflen = m_resampler->halfLength();
+    const long long first = m_resampler->inputIndex(m_resampleoutpos)-halflen+1;
+    const long long last = m_resampler->inputIndex(m_resampleoutpos+blocklen-1)+halflen;
+
+    // Forget the frames which are not needed anymore
+    if(first>m_resamplehiststart){
+        qint64 drop = qint64(std::min((long long)(m_resamplehistlen), first-m_resamplehiststart));
+        for(int c=0; c<nbchannels; ++c){
+            WAVTYPE* row = &(m_resamplehist[c*m_resamplehistcap]);
+            std::copy(row+drop, row+m_resamplehistlen, row);
+        }
+        m_resamplehistlen -= drop;
+        m_resamplehiststart += drop;
+    }
+
+    // Mix the frames up to the last one needed
+    while(m_resamplehiststart+m_resamplehistlen<=last){
+        qint64 len = std::min(qint64(m_soundbuffer.size()), m_resamplehistcap-m_resamplehistlen);
+        if(len<=0)
+            break;
+        WAVTYPE* mix = &(m_resamplemix[0]);
+        mixBlock(mix, len);
+        for(int c=0; c<nbchannels; ++c){
+            WAVTYPE* row = &(m_resamplehist[c*m_resamplehistcap+m_resamplehistlen]);
+            for(qint64 k=0; k<len; ++k)
+                row[k] = mix[k*nbchannels+c];
+        }
+        m_resamplehistlen += len;
+    }
+
+    WAVTYPE* out = &(m_resampleout[0]);
+    for(int c=0; c<nbchannels; ++c){
+        m_resampler->resampleBlock(&(m_resamplehist[c*m_resamplehistcap]), m_resamplehiststart, size_t(m_resamplehistlen), out, m_resampleoutpos, size_t(blocklen));
+        for(qint64 k=0; k<blocklen; ++k)
+            mixbuffer[k*nbchannels+c] = out[k];
+    }
+    m_resampleoutpos += blocklen;
+}
+
+qint64 SoundsMixer::readData(char *data, qint64 askedlen) {
+    const int nbchannels = std::max(1, m_format.channelCount());
+    const int frameBytes = nbchannels*m_format.sampleSize()/8;
+    unsigned char *ptr = reinterpret_cast<unsigned char *>(data);
+    const qint64 nbframes = askedlen/frameBytes; // Never write more than asked
+
+    if(m_soundbuffer.empty() || m_mixbuffer.size()<m_soundbuffer.size()*nbchannels)
+        return 0;
+    WAVTYPE* mixbuffer = &(m_mixbuffer[0]);
+
+    takeLoopSelection();
+    if(m_sounds.size()==1)
+        takeSwitch();
+
+    for(qint64 blockstart=0; blockstart<nbframes; blockstart+=qint64(m_soundbuffer.size())) {
+        const qint64 blocklen = std::min(qint64(m_soundbuffer.size()), nbframes-blockstart);
+        const qint64 nbvalues = blocklen*nbchannels;
+
+        if(m_resampler)
+            resampleBlock(mixbuffer, blocklen);
+        else
+            mixBlock(mixbuffer, blocklen);
+
+        // Update the level meter
+        for(qint64 k=0; k<blocklen; ++k){
+            WAVTYPE amp = 0.0;
+            for(int c=0; c<nbchannels; ++c)
+                amp = std::max(amp, WAVTYPE(std::abs(mixbuffer[k*nbchannels+c])));
+            FTSound::s_play_power_values.push(amp);
+        }
+
+        // Clip
+        for(qint64 k=0; k<nbvalues; ++k){
+            if(mixbuffer[k]>1.0)       mixbuffer[k] = 1.0;
+            else if(mixbuffer[k]<-1.0) mixbuffer[k] = -1.0;
+        }
+
+        FTSound::writeOutputSamples(m_format, mixbuffer, nbvalues, ptr);
+        ptr += blocklen*frameBytes;
+    }
+
+    FTSound::s_play_power = FTSound::s_play_power_values.max();
+    m_outputframes += nbframes;
+
+    return nbframes*frameBytes;
+}
+
+qint64 SoundsMixer::writeData(const char *data, qint64 askedlen){
+
+    Q_UNUSED(data)
+    Q_UNUSED(askedlen)
+
+    throw QString("SoundsMixer::writeData: There is no reason to call this function.");
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SOUNDSMIXER_H
+#define SOUNDSMIXER_H
+
+#include <vector>
+
+#include <QIODevice>
+#include <QAudioFormat>
+#include <QAtomicPointer>
+#include <QAtomicInt>
+#include <QMutex>
+
+#include "ftsound.h"
+#include "polyphaseresampler.h"
+
+// Plays multiple sounds at once, each one with its own gain, delay,
+// polarity and pan, so that they can be compared directly by ear
+// (e.g. a null test of a reference and its inverted processed version).
+// When playing a single sound, the playback can be switched to another
+// sound, at the same position and with a cross-fade (A/B comparison).
+// While looping, the selection can be changed without restarting the playback.
+// If the device runs at another sampling rate than the sounds, the mix is
+// resampled in streaming blocks, in the playback thread.
+class SoundsMixer : public QIODevice
+{
+    std::vector<FTSound*> m_sounds;
+    QAudioFormat m_format;      // Format of the device
+    QAudioFormat m_soundformat; // Same, at the sampling rate of the sounds
+    std::vector<WAVTYPE> m_channelgains; // Gain of each sound in each channel, including the headroom
+    std::vector<WAVTYPE> m_soundbuffer;  // Rendering buffer of a single sound
+    std::vector<WAVTYPE> m_fadebuffer;   // Rendering buffer of the sound fading out
+    std::vector<WAVTYPE> m_mixbuffer;    // Interleaved channels
+    void mixBlock(WAVTYPE* mixbuffer, qint64 blocklen);
+
+    // Streaming resampling to the rate of the device
+    PolyphaseResampler* m_resampler;    // NULL if the rates are the same
+    long long m_resampleoutpos;          // [output frames] Next frame to compute
+    long long m_resamplehiststart;       // [input frames] Index of the first frame in the history
+    qint64 m_resamplehistlen;
+    qint64 m_resamplehistcap;
+    std::vector<WAVTYPE> m_resamplehist; // Mixed frames at the rate of the sounds, one row of m_resamplehistcap per channel
+    std::vector<WAVTYPE> m_resamplemix;  // Interleaved mix to append to the history
+    std::vector<WAVTYPE> m_resampleout;  // Resampled frames of a single channel
+    void resampleBlock(WAVTYPE* mixbuffer, qint64 blocklen);
+
+    // A/B switching
+    QAtomicPointer<FTSound> m_switchto; // Set by the GUI thread, taken by the playback thread
+    std::vector<FTSound*> m_switched;   // All the sounds prepared for switching (GUI thread only)
+    FTSound* m_current;                 // Played sound, when single (playback thread only)
+    FTSound* m_fadingout;               // Previous sound, during the cross-fade (playback thread only)
+    qint64 m_fadepos;
+    void takeSwitch();
+
+    // Loop selection changes
+    QMutex m_loopmutex;     // Only tried by the playback thread, never waited for
+    QAtomicInt m_loopchanged;
+    qint64 m_loopstart;     // [sample index]
+    qint64 m_loopend;       // [sample index]
+    void takeLoopSelection();
+
+    qint64 m_outputframes;  // [device frames] Written since the start (playback thread only)
+
+    // Bounds of the played loop, published for the GUI thread (seqlock, odd while writing)
+    QAtomicInt m_playedseq;
+    QAtomicInt m_playedstart;    // [sample index]
+    QAtomicInt m_playedend;      // [sample index]
+    QAtomicInt m_playedoriginms; // [ms] Played duration when the position was at the start of the loop
+    void publishPlayed(qint64 start, qint64 end, int originms);
+
+public:
+    explicit SoundsMixer(QObject* parent=NULL);
+    ~SoundsMixer();
+
+    const std::vector<FTSound*>& sounds() const {return m_sounds;}
+
+    // The filtering is applied only when playing a single sound
+    // headroom [dB] attenuates the mix of two sounds or more
+    double setPlay(const std::vector<FTSound*>& sounds, const QAudioFormat& format, double tstart=0.0, double tstop=0.0, double fstart=0.0, double fstop=0.0, double headroom=0.0);
+    bool switchTo(FTSound* sound);
+    void setLoopSelection(double tstart, double tstop);
+    int playedBounds(qint64& start, qint64& end, int& originms) const; // Can be called from the GUI thread while playing, returns the version of the bounds
+    void stopPlay();
+
+    qint64 readData(char *data, qint64 maxlen);
+    qint64 writeData(const char *data, qint64 len);
+};
+
+#endif // SOUNDSMIXER_H
@@ -0,0 +1,126 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#include "stftmasking.h"
+
+#include <algorithm>
+#include <qmath.h>
+
+int STFTMasking::windowLength(double fs, double winduration) {
+    int dftlen = 2;
+    while(dftlen<winduration*fs)
+        dftlen *= 2;
+    return dftlen;
+}
+
+STFTMasking::STFTMasking(double fs, double winduration)
+    : m_fs(fs)
+{
+    m_dftlen = windowLength(fs, winduration);
+    m_stepsize = m_dftlen/4;
+
+    // Periodic Hann window
+    m_win.resize(m_dftlen);
+    for(int n=0; n<m_dftlen; ++n)
+        m_win[n] = 0.5-0.5*std::cos(2*M_PI*n/m_dftlen);
+
+    m_fft = new qae::FFTwrapper();
+    m_fft->resize(m_dftlen);
+}
+
+STFTMasking::~STFTMasking() {
+    delete m_fft;
+}
+
+// Inverse DFT of the half spectrum of a real signal, using the forward real FFT only.
+// With spec=A+iB, A is even and B is odd, so that the DFT of A is real and even,
+// the DFT of B is imaginary and odd, and frame[n]=(DFT(A)[n]+Im(DFT(B)[n]))/N.
+void STFTMasking::inverse(const std::vector<std::complex<FFTTYPE> >& spec, std::vector<FFTTYPE>& frame) {
+    int N = m_dftlen;
+
+    std::vector<FFTTYPE> dfta(N/2+1);
+    m_fft->in[0] = spec[0].real();
+    for(int k=1; k<N/2; ++k){
+        m_fft->in[k] = spec[k].real();
+        m_fft->in[N-k] = spec[k].real();
+    }
+    m_fft->in[N/2] = spec[N/2].real();
+    m_fft->execute();
+    for(int n=0; n<=N/2; ++n)
+        dfta[n] = m_fft->out[n].real();
+
+    m_fft->in[0] = 0.0;
+    for(int k=1; k<N/2; ++k){
+        m_fft->in[k] = spec[k].imag();
+        m_fft->in[N-k] = -spec[k].imag();
+    }
+    m_fft->in[N/2] = 0.0;
+    m_fft->execute();
+
+    frame[0] = dfta[0]/N;
+    for(int n=1; n<N/2; ++n){
+        FFTTYPE b = m_fft->out[n].imag();
+        frame[n] = (dfta[n]+b)/N;
+        frame[N-n] = (dfta[n]-b)/N;
+    }
+    frame[N/2] = dfta[N/2]/N;
+}
+
+void STFTMasking::bandPass(std::vector<WAVTYPE>& x, double fstart, double fstop) {
+    int N = m_dftlen;
+    int len = int(x.size());
+    if(len==0)
+        return;
+
+    // The bins to keep
+    int kstart = int(std::ceil(fstart*N/m_fs));
+    int kstop = int(std::floor(fstop*N/m_fs));
+    kstart = std::max(0, kstart);
+    kstop = std::min(N/2, kstop);
+
+    std::vector<WAVTYPE> y(len, 0.0);
+    std::vector<WAVTYPE> wsum(len, 0.0); // Sum of the squared windows, for normalization
+    std::vector<std::complex<FFTTYPE> > spec(N/2+1);
+    std::vector<FFTTYPE> frame(N);
+
+    // The first frame is centered on the first sample
+    for(int start=-N/2; start<len; start+=m_stepsize){
+
+        for(int n=0; n<N; ++n){
+            int xn = start+n;
+            m_fft->in[n] = (xn>=0 && xn<len)?m_win[n]*x[xn]:0.0;
+        }
+        m_fft->execute();
+
+        for(int k=0; k<=N/2; ++k)
+            spec[k] = (k>=kstart && k<=kstop)?m_fft->out[k]:std::complex<FFTTYPE>(0.0,0.0);
+
+        inverse(spec, frame);
+
+        for(int n=std::max(0,-start); n<N && start+n<len; ++n){
+            y[start+n] += m_win[n]*frame[n];
+            wsum[start+n] += m_win[n]*m_win[n];
+        }
+    }
+
+    for(int n=0; n<len; ++n)
+        x[n] = (wsum[n]>0.0)?y[n]/wsum[n]:0.0;
+}
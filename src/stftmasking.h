@@ -0,0 +1,55 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef STFTMASKING_H
+#define STFTMASKING_H
+
+#include <vector>
+#include <complex>
+
+#include "qaesigproc.h"
+
+// Band-pass filtering by masking the Short-Time Fourier Transform (STFT)
+// and resynthesizing by weighted overlap-add.
+// The band edges are as sharp as the frequency resolution of the STFT,
+// and the cost doesn't depend on the width of the band.
+class STFTMasking
+{
+    double m_fs;
+    int m_dftlen;
+    int m_stepsize;
+    std::vector<FFTTYPE> m_win; // Used for both analysis and synthesis
+    qae::FFTwrapper* m_fft;
+
+    void inverse(const std::vector<std::complex<FFTTYPE> >& spec, std::vector<FFTTYPE>& frame);
+
+public:
+    // The window duration is rounded to the next power of 2
+    STFTMasking(double fs, double winduration=0.040);
+    ~STFTMasking();
+
+    static int windowLength(double fs, double winduration=0.040);
+
+    // Keep only the frequencies in [fstart,fstop] [Hz], in place
+    void bandPass(std::vector<WAVTYPE>& x, double fstart, double fstop);
+};
+
+#endif // STFTMASKING_H
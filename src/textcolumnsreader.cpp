@@ -0,0 +1,324 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#include "textcolumnsreader.h"
+
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <stdint.h>
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QRegExp>
+
+#define TEXTCOLUMNSREADER_MINCHUNKSIZE (1<<20) // [bytes] Below which a chunk is not worth a thread
+
+static inline bool isBlank(char c) {
+    return c==' ' || c=='\t' || c=='\r' || c=='\f' || c=='\v';
+}
+
+// Parse one chunk of whole lines
+class TextColumnsChunkTask : public QRunnable {
+    const char* m_begin;
+    const char* m_end;
+    const std::vector<int>* m_columns;
+    int m_textcolumn;
+    std::vector< std::vector<double> >* m_values;
+    std::vector<QByteArray>* m_texts;
+
+public:
+    TextColumnsChunkTask(const char* begin, const char* end, const std::vector<int>* columns, int textcolumn, std::vector< std::vector<double> >* values, std::vector<QByteArray>* texts)
+        : m_begin(begin), m_end(end), m_columns(columns), m_textcolumn(textcolumn), m_values(values), m_texts(texts)
+    {}
+    void run() {
+        const std::vector<int>& columns = *m_columns;
+        int lastcolumn = m_textcolumn;
+        for(size_t i=0; i<columns.size(); ++i)
+            lastcolumn = std::max(lastcolumn, columns[i]);
+
+        m_values->resize(columns.size());
+        std::vector<double> linevalues(columns.size());
+        const char* p = m_begin;
+        while(p<m_end){
+            const char* le = (const char*)memchr(p, '\n', m_end-p);
+            if(le==NULL)
+                le = m_end;
+
+            size_t found = 0;
+            bool valid = true;
+            QByteArray text;
+            const char* q = p;
+            for(int col=0; valid && col<=lastcolumn; ++col){
+                while(q<le && isBlank(*q))
+                    ++q;
+                if(q>=le)
+                    break;
+                const char* tokstart = q;
+                while(q<le && !isBlank(*q))
+                    ++q;
+
+                for(size_t i=0; valid && i<columns.size(); ++i){
+                    if(columns[i]==col){
+                        const char* r = tokstart;
+                        valid = TextColumnsReader::parseNumber(r, q, linevalues[i]) && r==q;
+                        found++;
+                    }
+                }
+                if(col==m_textcolumn)
+                    text = QByteArray(tokstart, int(q-tokstart));
+            }
+
+            if(valid && found==columns.size()){
+                for(size_t i=0; i<columns.size(); ++i)
+                    (*m_values)[i].push_back(linevalues[i]);
+                if(m_texts)
+                    m_texts->push_back(text);
+            }
+
+            p = le+1;
+        }
+    }
+};
+
+TextColumnsReader::TextColumnsReader(const QString& filepath)
+    : m_file(filepath)
+    , m_data(NULL)
+    , m_size(0)
+    , m_start(0)
+{
+    if(!m_file.open(QIODevice::ReadOnly))
+        throw QString("TextColumnsReader: Cannot open the file.");
+
+    m_size = m_file.size();
+    if(m_size>0){
+        m_data = (const char*)m_file.map(0, m_size);
+        if(m_data==NULL){
+            // Some files cannot be mapped (e.g. on special file systems)
+            m_buffer = m_file.readAll();
+            m_data = m_buffer.constData();
+            m_size = m_buffer.size();
+        }
+    }
+}
+
+TextColumnsReader::~TextColumnsReader() {
+    if(m_data && m_buffer.isEmpty())
+        m_file.unmap((uchar*)m_data);
+}
+
+void TextColumnsReader::skipHeader(const QByteArray& headerend) {
+    const char* p = m_data+m_start;
+    const char* end = m_data+m_size;
+    while(p<end){
+        const char* le = (const char*)memchr(p, '\n', end-p);
+        if(le==NULL)
+            le = end;
+        bool isend = (le-p)>=headerend.size() && memcmp(p, headerend.constData(), headerend.size())==0;
+        p = std::min(le+1, end);
+        if(isend)
+            break;
+    }
+    m_start = p-m_data;
+}
+
+void TextColumnsReader::read(const std::vector<int>& columns, std::vector< std::vector<double> >& values, int textcolumn, std::vector<QByteArray>* texts) {
+    values.clear();
+    values.resize(columns.size());
+    if(texts)
+        texts->clear();
+    if(m_data==NULL || m_start>=m_size)
+        return;
+
+    // Split in chunks of whole lines
+    const char* end = m_data+m_size;
+    qint64 len = m_size-m_start;
+    int nbchunks = int(std::min(qint64(4*QThread::idealThreadCount()), len/TEXTCOLUMNSREADER_MINCHUNKSIZE+1));
+    std::vector<const char*> bounds(1, m_data+m_start);
+    for(int k=1; k<nbchunks; ++k){
+        const char* p = std::max(bounds.back(), m_data+m_start+(len*k)/nbchunks);
+        const char* le = (const char*)memchr(p, '\n', end-p);
+        if(le==NULL)
+            break;
+        bounds.push_back(le+1);
+    }
+    bounds.push_back(end);
+    nbchunks = int(bounds.size())-1;
+
+    std::vector< std::vector< std::vector<double> > > chunkvalues(nbchunks);
+    std::vector< std::vector<QByteArray> > chunktexts(nbchunks);
+    if(nbchunks==1){
+        TextColumnsChunkTask task(bounds[0], bounds[1], &columns, textcolumn, &(chunkvalues[0]), texts?&(chunktexts[0]):NULL);
+        task.run();
+    }
+    else{
+        QThreadPool pool;
+        pool.setMaxThreadCount(QThread::idealThreadCount());
+        for(int k=0; k<nbchunks; ++k)
+            pool.start(new TextColumnsChunkTask(bounds[k], bounds[k+1], &columns, textcolumn, &(chunkvalues[k]), texts?&(chunktexts[k]):NULL));
+        pool.waitForDone();
+    }
+
+    // Gather the chunks
+    for(size_t i=0; i<columns.size(); ++i){
+        size_t total = 0;
+        for(int k=0; k<nbchunks; ++k)
+            total += chunkvalues[k][i].size();
+        values[i].reserve(total);
+        for(int k=0; k<nbchunks; ++k){
+            values[i].insert(values[i].end(), chunkvalues[k][i].begin(), chunkvalues[k][i].end());
+            std::vector<double>().swap(chunkvalues[k][i]);
+        }
+    }
+    if(texts){
+        for(int k=0; k<nbchunks; ++k)
+            texts->insert(texts->end(), chunktexts[k].begin(), chunktexts[k].end());
+    }
+}
+
+int TextColumnsReader::selectedColumn(const QString& dataselectors) {
+    // Following the SDIF syntax [#stream][:frame][/matrix][.column][_row][@time]
+    QString selectors = dataselectors.section('@', 0, 0); // The time can contain a dot
+    QRegExp rx("\\.([0-9]+)");
+    if(rx.indexIn(selectors)==-1)
+        return -1;
+    return std::max(0, rx.cap(1).toInt()-1);
+}
+
+int TextColumnsReader::countNumbers(const char* p, const char* end) {
+    int nb = 0;
+    while(p<end){
+        while(p<end && isBlank(*p))
+            ++p;
+        if(p>=end || *p=='\n')
+            break;
+        const char* tokend = p;
+        while(tokend<end && !isBlank(*tokend) && *tokend!='\n')
+            ++tokend;
+        double value;
+        if(!parseNumber(p, tokend, value) || p!=tokend)
+            return 0;
+        nb++;
+    }
+    return nb;
+}
+
+bool TextColumnsReader::parseNumber(const char*& p, const char* end, double& value) {
+    const char* q = p;
+    bool negative = false;
+    if(q<end && (*q=='-' || *q=='+')){
+        negative = (*q=='-');
+        ++q;
+    }
+
+    // Infinite and undefined values, as written by the C and C++ libraries
+    if(q<end && (*q=='i' || *q=='I' || *q=='n' || *q=='N')){
+        static const char* words[] = {"infinity", "inf", "nan"};
+        for(int w=0; w<3; ++w){
+            int len = int(strlen(words[w]));
+            if(end-q>=len && qstrnicmp(q, words[w], len)==0){
+                if(w<2)
+                    value = std::numeric_limits<double>::infinity();
+                else
+                    value = std::numeric_limits<double>::quiet_NaN();
+                if(negative)
+                    value = -value;
+                p = q+len;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Keep up to 19 significant digits in an integer mantissa
+    uint64_t mantissa = 0;
+    int nbdigits = 0;
+    int exponent = 0;
+    bool anydigit = false;
+    bool exact = true;
+    for(; q<end && *q>='0' && *q<='9'; ++q){
+        anydigit = true;
+        if(nbdigits<19){
+            mantissa = mantissa*10+(*q-'0');
+            if(mantissa>0)
+                nbdigits++;
+        }
+        else{
+            exponent++;
+            exact = exact && *q=='0';
+        }
+    }
+    if(q<end && *q=='.'){
+        for(++q; q<end && *q>='0' && *q<='9'; ++q){
+            anydigit = true;
+            if(nbdigits<19){
+                mantissa = mantissa*10+(*q-'0');
+                if(mantissa>0)
+                    nbdigits++;
+                exponent--;
+            }
+            else
+                exact = exact && *q=='0';
+        }
+    }
+    if(!anydigit)
+        return false;
+
+    if(q<end && (*q=='e' || *q=='E')){
+        const char* r = q+1;
+        bool expnegative = false;
+        if(r<end && (*r=='-' || *r=='+')){
+            expnegative = (*r=='-');
+            ++r;
+        }
+        if(r<end && *r>='0' && *r<='9'){
+            int e = 0;
+            for(; r<end && *r>='0' && *r<='9'; ++r)
+                if(e<100000)
+                    e = e*10+(*r-'0');
+            exponent += expnegative?-e:e;
+            q = r;
+        }
+    }
+
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    if(mantissa==0)
+        value = 0.0;
+    else if(exact && mantissa<=(uint64_t(1)<<53) && exponent>=-22 && exponent<=22){
+        // Both the mantissa and the power of ten are exact doubles, so is the result
+        if(exponent<0)
+            value = double(mantissa)/pow10[-exponent];
+        else
+            value = double(mantissa)*pow10[exponent];
+    }
+    else{
+        // Rare, keep the correct rounding of the C library
+        value = QByteArray(p, int(q-p)).toDouble();
+        negative = false; // The sign has been parsed with the rest
+    }
+    if(negative)
+        value = -value;
+
+    p = q;
+    return true;
+}
@@ -0,0 +1,65 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TEXTCOLUMNSREADER_H
+#define TEXTCOLUMNSREADER_H
+
+#include <vector>
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+
+// Reader of text files made of columns separated by white spaces
+// (time/value, F0, labels, etc.).
+// The file is memory-mapped and split into chunks of whole lines,
+// which are parsed in parallel. Only the requested columns are converted.
+class TextColumnsReader
+{
+    QFile m_file;
+    const char* m_data;
+    qint64 m_size;
+    qint64 m_start; // Where the data start (after the header, if any)
+    QByteArray m_buffer; // If the file cannot be mapped
+
+public:
+    TextColumnsReader(const QString& filepath);
+    ~TextColumnsReader();
+
+    // The data start after the line beginning with headerend
+    void skipHeader(const QByteArray& headerend);
+
+    // For each line, read the numbers of the given columns (0 for the first one),
+    // and the word of the text column, if any (-1 otherwise).
+    // The lines lacking one of the numbers (e.g. empty lines) are skipped.
+    void read(const std::vector<int>& columns, std::vector< std::vector<double> >& values, int textcolumn=-1, std::vector<QByteArray>* texts=NULL);
+
+    // The column selected by the data selectors (e.g. "file.txt::.3" selects the 3rd column)
+    // Returns the index of the column (0 for the first one), -1 if none is selected.
+    static int selectedColumn(const QString& dataselectors);
+
+    // Number of columns of the line if they are all numbers, 0 otherwise
+    static int countNumbers(const char* p, const char* end);
+
+    // Parse the number at p (as strtod in the C locale would), moving p after it
+    static bool parseNumber(const char*& p, const char* end, double& value);
+};
+
+#endif // TEXTCOLUMNSREADER_H
@@ -84,8 +84,11 @@ WDialogSettings::WDialogSettings(QWidget *parent) :
     connect(ui->btnSettingsClear, SIGNAL(clicked()), this, SLOT(settingsClear()));  
     connect(ui->sbViewsCacheLimit, SIGNAL(valueChanged(int)), this, SLOT(setCacheLimit(int)));
 
+    gMW->m_settings.add(ui->cbPlaybackFilteringMethod);
     gMW->m_settings.add(ui->sbPlaybackButterworthOrder);
     gMW->m_settings.add(ui->cbPlaybackFilteringCompensateEnergy);
+    gMW->m_settings.add(ui->sbPlaybackMixingHeadroom);
+    gMW->m_settings.add(ui->cbPlaybackSwitchOnSelection);
     gMW->m_settings.add(ui->ckPlaybackAvoidClicksAddWindows);
     gMW->m_settings.add(ui->sbPlaybackAvoidClicksWindowDuration);
     gMW->m_settings.add(ui->cbLabelsDefaultTextEncoding, true);
@@ -101,6 +104,9 @@ WDialogSettings::WDialogSettings(QWidget *parent) :
     gMW->m_settings.addFont(ui->lblGridFontSample);
     gMW->m_settings.add(ui->dsbEstimationF0Min);
     gMW->m_settings.add(ui->dsbEstimationF0Max);
+    gMW->m_settings.add(ui->dsbEstimationF0SegmentDuration);
+    gMW->m_settings.add(ui->cbEstimationF0Cache);
+    gMW->m_settings.add(ui->sbEstimationF0CacheSize);
     ui->pbGridFontChange->setText(ui->lblGridFontSample->font().family());
 
     // Load the documentation
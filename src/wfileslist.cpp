@@ -26,6 +26,12 @@ file provided in the source code of DFasma. Another copy can be found at
 #include <QMessageBox>
 #include <QItemDelegate>
 #include <QKeyEvent>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QFileSystemWatcher>
+#include <QTimer>
 
 #include "filetype.h"
 #include "ftsound.h"
@@ -53,6 +59,7 @@ file provided in the source code of DFasma. Another copy can be found at
 #include "gvgenerictimevalue.h"
 
 #include <fstream>
+#include <sstream>
 
 #include "qaehelpers.h"
 
@@ -74,7 +81,6 @@ class FilesListWidgetDelegate : public QItemDelegate {
 WFilesList::WFilesList(QMainWindow *parent)
     : QListWidget(parent)
     , m_prgdlg(NULL)
-    , m_loadingmsgbox(NULL)
     , m_currentAction(CANothing)
     , m_prevSelectedFile(NULL)
     , m_prevSelectedSound(NULL)
@@ -90,6 +96,13 @@ WFilesList::WFilesList(QMainWindow *parent)
     setWordWrap(true);
 
     setItemDelegate(new FilesListWidgetDelegate(this));
+
+    m_filewatcher = new QFileSystemWatcher(this);
+    connect(m_filewatcher, SIGNAL(fileChanged(QString)), this, SLOT(fileChangedOnDisc(QString)));
+    m_filewatcherdebounce = new QTimer(this);
+    m_filewatcherdebounce->setSingleShot(true);
+    m_filewatcherdebounce->setInterval(250);
+    connect(m_filewatcherdebounce, SIGNAL(timeout()), this, SLOT(checkChangedFiles()));
 }
 
 void WFilesList::openEditor(QWidget * editor){
@@ -127,17 +140,66 @@ void WFilesList::changeFileListItemsSize() {
     setFont(cfont);
 }
 
+void WFilesList::watchFile(const QString& filepath) {
+    QString path = FileType::removeDataSelectors(filepath);
+    std::map<QString,int>::iterator it = m_watchedfiles.find(path);
+    if(it!=m_watchedfiles.end())
+        it->second++;
+    else if(QFileInfo(path).exists() && m_filewatcher->addPath(path))
+        m_watchedfiles[path] = 1;
+    // Otherwise (e.g. too many watched files), it is checked on focus change
+}
+
+void WFilesList::unwatchFile(const QString& filepath) {
+    QString path = FileType::removeDataSelectors(filepath);
+    std::map<QString,int>::iterator it = m_watchedfiles.find(path);
+    if(it==m_watchedfiles.end())
+        return;
+    if(--(it->second)==0){
+        m_filewatcher->removePath(path);
+        m_watchedfiles.erase(it);
+    }
+}
+
+void WFilesList::fileChangedOnDisc(const QString& filepath) {
+    m_changedfiles.insert(filepath);
+    m_filewatcherdebounce->start(); // Restart the waiting at each change
+}
+
+void WFilesList::checkChangedFiles() {
+    for(size_t fi=0; fi<ftsnds.size(); fi++)
+        if(m_changedfiles.count(FileType::removeDataSelectors(ftsnds[fi]->fileFullPath))>0)
+            ftsnds[fi]->checkFileStatus();
+    for(size_t fi=0; fi<ftfzeros.size(); fi++)
+        if(m_changedfiles.count(FileType::removeDataSelectors(ftfzeros[fi]->fileFullPath))>0)
+            ftfzeros[fi]->checkFileStatus();
+    for(size_t fi=0; fi<ftlabels.size(); fi++)
+        if(m_changedfiles.count(FileType::removeDataSelectors(ftlabels[fi]->fileFullPath))>0)
+            ftlabels[fi]->checkFileStatus();
+
+    // Some editors replace the file instead of writing into it, which removes it from the watcher
+    QStringList watched = m_filewatcher->files();
+    for(std::set<QString>::iterator it=m_changedfiles.begin(); it!=m_changedfiles.end(); ++it)
+        if(m_watchedfiles.find(*it)!=m_watchedfiles.end() && !watched.contains(*it) && QFileInfo(*it).exists())
+            m_filewatcher->addPath(*it);
+
+    m_changedfiles.clear();
+
+    gFL->fileInfoUpdate();
+}
+
 // Check if a file has been modified on the disc
+// Only for the files which are not watched
 void WFilesList::checkFileModifications(){
 //    cout << "GET FOCUS " << QDateTime::currentMSecsSinceEpoch() << endl;
     for(size_t fi=0; fi<ftsnds.size(); fi++)
-        if(!ftsnds[fi]->isDistantFile())
+        if(!ftsnds[fi]->isDistantFile() && m_watchedfiles.find(FileType::removeDataSelectors(ftsnds[fi]->fileFullPath))==m_watchedfiles.end())
             ftsnds[fi]->checkFileStatus();
     for(size_t fi=0; fi<ftfzeros.size(); fi++)
-        if(!ftfzeros[fi]->isDistantFile())
+        if(!ftfzeros[fi]->isDistantFile() && m_watchedfiles.find(FileType::removeDataSelectors(ftfzeros[fi]->fileFullPath))==m_watchedfiles.end())
             ftfzeros[fi]->checkFileStatus();
     for(size_t fi=0; fi<ftlabels.size(); fi++)
-        if(!ftlabels[fi]->isDistantFile())
+        if(!ftlabels[fi]->isDistantFile() && m_watchedfiles.find(FileType::removeDataSelectors(ftlabels[fi]->fileFullPath))==m_watchedfiles.end())
             ftlabels[fi]->checkFileStatus();
 
     gFL->fileInfoUpdate();
@@ -152,7 +214,117 @@ void WFilesList::stopFileProgressDialog() {
     QCoreApplication::processEvents(); // To show the progress
 }
 
-void WFilesList::addExistingFilesRecursive(const QStringList& files, FileType::FType type) {
+// Only some audio file libraries can decode files in parallel
+#if defined(file_audio_LIBSNDFILE) || defined(file_audio_LIBSOX)
+#define FILESLIST_PARALLEL_DECODING
+#endif
+
+// Guess the container and the data type of a file, without any GUI interaction
+class FileProbeTask : public QRunnable {
+    WFilesList::FileToLoad* m_file;
+    QAtomicInt* m_done;
+    QAtomicInt* m_canceled;
+
+    void probe() {
+        #ifdef SUPPORT_SDIF
+        static QMutex s_sdif_mutex; // The SDIF library is not reentrant
+        QMutexLocker sdiflocker(&s_sdif_mutex);
+        #endif
+
+        // Attention: There is the type of data stored in DFasma (FILETYPE) (ex. FileType::FTSOUND)
+        //  and the format of the file (ex. FFSOUND)
+        //  and the file container (sdif, any sound, text)
+
+        // This should be always "guessable"
+        m_file->container = FileType::guessContainer(FileType::removeDataSelectors(m_file->filepath));
+
+        // Then, guess the type of the data in the file, if not specified yet
+        // (SDIF and non-labels text files are resolved in the GUI thread)
+        if(m_file->container==FileType::FCANYSOUND) {
+            if(m_file->type==FileType::FTUNSET)
+                m_file->type = FileType::FTSOUND; // These two have to match
+            if(m_file->type==FileType::FTSOUND)
+                m_file->nchan = FTSound::getNumberOfChannels(m_file->filepath);
+        }
+        else if(m_file->container==FileType::FCTEXT && m_file->type==FileType::FTUNSET) {
+            // Distinguish between f0, labels and future VUF files (and futur others ...)
+            // Do a grammar check (But this won't help to diff F0 and VUF files)
+            // TODO Switch to QTextStream
+            std::ifstream fin(m_file->filepath.toLatin1().constData());
+            if(!fin.is_open())
+                throw QString("Cannot open this file");
+            double t;
+            std::string line, text;
+            // Check the first line only (Assuming it is enough)
+            // TODO May have to skip commented lines depending on the text format
+            if(!std::getline(fin, line))
+                throw QString("There is not a single line in this file");
+
+            // Check for a label: <number> <number> <txt>
+            std::istringstream iss1(line);
+            std::istringstream iss2(line);
+            if(((iss1 >> t >> t >> text) && iss1.eof())
+                || ((iss2 >> t >> t >> text >> text) && iss2.eof())){
+                m_file->type = FileType::FTLABELS;
+            }
+        }
+        else if(m_file->container==FileType::FCEST && m_file->type==FileType::FTUNSET) {
+            // Currently support only F0 data
+            m_file->type = FileType::FTFZERO;
+        }
+    }
+
+public:
+    FileProbeTask(WFilesList::FileToLoad* file, QAtomicInt* done, QAtomicInt* canceled)
+        : m_file(file), m_done(done), m_canceled(canceled)
+    {}
+    void run() {
+        if(!m_canceled->load()){
+            try{
+                probe();
+            }
+            catch(QString err){
+                m_file->error = err;
+            }
+        }
+        m_done->fetchAndAddOrdered(1);
+    }
+};
+
+// Decode a sound created with the deferred loading
+class SoundDecodeTask : public QRunnable {
+    WFilesList::FileToLoad* m_file;
+    QAtomicInt* m_done;
+    QAtomicInt* m_canceled;
+
+public:
+    SoundDecodeTask(WFilesList::FileToLoad* file, QAtomicInt* done, QAtomicInt* canceled)
+        : m_file(file), m_done(done), m_canceled(canceled)
+    {}
+    void run() {
+        if(!m_canceled->load()){
+            try{
+                m_file->snd->loadDeferred();
+            }
+            catch(QString err){
+                m_file->error = err;
+            }
+        }
+        m_done->fetchAndAddOrdered(1);
+    }
+};
+
+// Wait for the workers, while keeping the progress dialog alive
+static void waitForLoadingWorkers(QThreadPool& pool, QAtomicInt& done, QAtomicInt& canceled, QProgressDialog* prgdlg) {
+    while(!pool.waitForDone(50)){
+        prgdlg->setValue(done.load());
+        QCoreApplication::processEvents(); // To show the progress
+        if(prgdlg->wasCanceled())
+            canceled.store(1);
+    }
+}
+
+void WFilesList::listFilesRecursive(const QStringList& files, FileType::FType type, std::vector<FileToLoad>& list) {
     for(int fi=0; fi<files.size() && !m_prgdlg->wasCanceled(); fi++) {
         if(QFileInfo(files[fi]).isDir()) {
 //            COUTD << "Add recursive" << endl;
@@ -160,30 +332,20 @@ void WFilesList::addExistingFilesRecursive(const QStringList& files, FileType::F
 
             // Recursive call on directories
             fpd.setFilter(QDir::AllDirs | QDir::NoDotAndDotDot);
-            if(fpd.count()>0){
-                for(int fpdi=0; fpdi<int(fpd.count()) && !m_prgdlg->wasCanceled(); ++fpdi){
-//                    COUTD << "Dir: " << fpd[fpdi].toLatin1().constData() << endl;
-                    addExistingFilesRecursive(QStringList(fpd.filePath(fpd[fpdi])));
-                }
+            for(int fpdi=0; fpdi<int(fpd.count()) && !m_prgdlg->wasCanceled(); ++fpdi){
+//                COUTD << "Dir: " << fpd[fpdi].toLatin1().constData() << endl;
+                listFilesRecursive(QStringList(fpd.filePath(fpd[fpdi])), FileType::FTUNSET, list);
             }
 
             // Add the files of the current directory
             fpd.setFilter(QDir::Files | QDir::NoDotAndDotDot);
-            if(fpd.count()>0){
-                m_prgdlg->setMaximum(fpd.count());
-//                COUTD << "Setmax " << fpd.count() << endl;
-                for(int fpdi=0; fpdi<int(fpd.count()) && !m_prgdlg->wasCanceled(); ++fpdi){
-//                    COUTD << "File: " << fpd[fpdi].toLatin1().constData() << endl;
-                    m_prgdlg->setValue(fpdi);
-                    QCoreApplication::processEvents(); // To show the progress
-                    addExistingFile(fpd.filePath(fpd[fpdi]));
-                }
-            }
+            for(int fpdi=0; fpdi<int(fpd.count()); ++fpdi)
+                list.push_back(FileToLoad(fpd.filePath(fpd[fpdi])));
+
+            QCoreApplication::processEvents(); // To keep the abort button alive
         }
         else {
-            if(m_prgdlg) m_prgdlg->setValue(fi);
-            QCoreApplication::processEvents(); // To show the progress
-            addExistingFile(files[fi], type);
+            list.push_back(FileToLoad(files[fi], type));
         }
     }
 }
@@ -191,174 +353,199 @@ void WFilesList::addExistingFilesRecursive(const QStringList& files, FileType::F
 void WFilesList::addExistingFiles(const QStringList& files, FileType::FType type) {
 
     // These progress dialogs HAVE to be built on the stack otherwise ghost dialogs appear.
-    QProgressDialog prgdlg("Opening files...", "Abort", 0, files.size(), this);
+    QProgressDialog prgdlg("Listing files...", "Abort", 0, files.size(), this);
     prgdlg.setMinimumDuration(500);
     m_prgdlg = &prgdlg;
 
-    addExistingFilesRecursive(files, type);
+    // The list of files is flattened first, so that the workers share a single queue
+    std::vector<FileToLoad> files2probe;
+    listFilesRecursive(files, type, files2probe);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    QAtomicInt done(0);
+    QAtomicInt canceled(0);
+
+    // Guess the containers and data types in parallel
+    prgdlg.setLabelText("Opening files...");
+    prgdlg.setMaximum(files2probe.size());
+    for(size_t fi=0; fi<files2probe.size() && !prgdlg.wasCanceled(); ++fi)
+        pool.start(new FileProbeTask(&(files2probe[fi]), &done, &canceled));
+    waitForLoadingWorkers(pool, done, canceled, m_prgdlg);
+
+    // Ask the user what is still unknown, in the order of the files
+    std::vector<FileToLoad> files2load;
+    for(size_t fi=0; fi<files2probe.size() && !prgdlg.wasCanceled(); ++fi){
+        try{
+            if(!files2probe[fi].error.isEmpty())
+                throw files2probe[fi].error;
+            resolveFileToLoad(files2probe[fi], files2load);
+        }
+        catch(QString err){
+            reportLoadingError(files2probe[fi].filepath, err);
+        }
+    }
+
+    // Decode the sounds in parallel
+    done.store(0);
+    int nbsnds = 0;
+    for(size_t fi=0; fi<files2load.size(); ++fi)
+        if(files2load[fi].snd)
+            nbsnds++;
+    prgdlg.setLabelText("Decoding sounds...");
+    prgdlg.setMaximum(nbsnds);
+    for(size_t fi=0; fi<files2load.size() && !prgdlg.wasCanceled(); ++fi){
+        if(files2load[fi].snd){
+            #ifdef FILESLIST_PARALLEL_DECODING
+                pool.start(new SoundDecodeTask(&(files2load[fi]), &done, &canceled));
+            #else
+                SoundDecodeTask(&(files2load[fi]), &done, &canceled).run();
+                prgdlg.setValue(done.load());
+                QCoreApplication::processEvents(); // To show the progress
+            #endif
+        }
+    }
+    waitForLoadingWorkers(pool, done, canceled, m_prgdlg);
+
+    // Finally, add the files to the list and the views, in the order of the files
+    prgdlg.setLabelText("Adding files...");
+    prgdlg.setMaximum(files2load.size());
+    bool sndadded = false;
+    for(size_t fi=0; fi<files2load.size(); ++fi){
+        if(prgdlg.wasCanceled()){
+            delete files2load[fi].snd; // Never attached
+            continue;
+        }
+
+        prgdlg.setValue(fi);
+        QCoreApplication::processEvents(); // To show the progress
+        try{
+            sndadded = sndadded || files2load[fi].type==FileType::FTSOUND;
+            attachFileToLoad(files2load[fi]);
+        }
+        catch(QString err){
+            delete files2load[fi].snd; // Failed before being attached
+            files2load[fi].snd = NULL;
+            reportLoadingError(files2load[fi].filepath, err);
+        }
+    }
+
+    if(sndadded && ftsnds.size()>0)
+        gMW->m_gvWaveform->fitViewToSoundsAmplitude();
 
     stopFileProgressDialog();
     m_prgdlg = NULL;
 }
 
 void WFilesList::addExistingFile(const QString& filepath, FileType::FType type) {
-    // Not used for directories, use addExistingFiles instead
-
-    try{
-        bool isfirsts = ftsnds.size()==0;
-        int viewid=-1; // The view where the file will be added to (only for generic file types)
-                       // By default, create a new view
+    addExistingFiles(QStringList(filepath), type);
+}
 
-        // Attention: There is the type of data stored in DFasma (FILETYPE) (ex. FileType::FTSOUND)
-        //  and the format of the file (ex. FFSOUND)
-        //  and the file container (sdif, any sound, text)
+void WFilesList::resolveFileToLoad(FileToLoad file, std::vector<FileToLoad>& toload) {
 
-        QFileInfo fileinfo(filepath);
-        int filesize = fileinfo.size()/std::pow(2.0, 20.0); // File size in [MB]
-//        DCOUT << filepath << " size: " << filesize << "MB" << std::endl;
-
-        if(filesize>50){ // If bigger than X MB
-            m_loadingmsgbox = new QMessageBox(gMW);
-            m_loadingmsgbox->setWindowTitle("DFasma");
-            m_loadingmsgbox->setText("Loading big file ...");
-            m_loadingmsgbox->setWindowModality(Qt::NonModal);
-            m_loadingmsgbox->setStandardButtons(QMessageBox::NoButton);
-            m_loadingmsgbox->show();
-            for(int nsilly=0; nsilly<3; ++nsilly){
-                QThread::msleep(10);
-                QCoreApplication::processEvents(); // To show the progress
+    if(file.type==FileType::FTUNSET){
+        #ifdef SUPPORT_SDIF
+        if(file.container==FileType::FCSDIF) {
+            if(FileType::SDIF_hasFrame(file.filepath, "1FQ0"))
+                file.type = FileType::FTFZERO;
+            else if (FileType::SDIF_hasFrame(file.filepath, "1MRK"))
+                file.type = FileType::FTLABELS;
+            else
+                throw QString("Unsupported SDIF data.");
+        }
+        #endif
+        if(file.container==FileType::FCTEXT || file.container==FileType::FCBINARY) {
+            // The first line didn't look like labels, or binary values
+            stopFileProgressDialog();
+            WDialogFileTypeChooserTxt dlg(this, file.filepath);
+            int ret = dlg.exec();
+            if(ret==1){
+                file.type = dlg.selectedFileType();
+                file.viewid = dlg.selectedView();
             }
         }
+    }
 
-        // This should be always "guessable"
-        FileType::FileContainer container = FileType::guessContainer(FileType::removeDataSelectors(filepath));
+    if(file.type==FileType::FTUNSET)
+        throw QString("Cannot find any data or audio channel in this file that is handled by DFasma.");
 
-        // Then, guess the type of the data in the file, if not specified yet
-        if(type==FileType::FTUNSET){
-            // The format and the DFasma's type have to correspond
-            if(container==FileType::FCANYSOUND) {
-                type = FileType::FTSOUND; // These two have to match
-            }
-            #ifdef SUPPORT_SDIF
-            else if(container==FileType::FCSDIF) {
-                if(FileType::SDIF_hasFrame(filepath, "1FQ0"))
-                    type = FileType::FTFZERO;
-                else if (FileType::SDIF_hasFrame(filepath, "1MRK"))
-                    type = FileType::FTLABELS;
-                else
-                    throw QString("Unsupported SDIF data.");
-            }
-            #endif
-            else if(container==FileType::FCTEXT) {
-                // Distinguish between f0, labels and future VUF files (and futur others ...)
-                // Do a grammar check (But this won't help to diff F0 and VUF files)
-                // TODO Switch to QTextStream
-                std::ifstream fin(filepath.toLatin1().constData());
-                if(!fin.is_open())
-                    throw QString("Cannot open this file");
-                double t;
-                std::string line, text;
-                // Check the first line only (Assuming it is enough)
-                // TODO May have to skip commented lines depending on the text format
-                if(!std::getline(fin, line))
-                    throw QString("There is not a single line in this file");
-
-                // Check for a label: <number> <number> <txt>
-                std::istringstream iss1(line);
-                std::istringstream iss2(line);
-                if(((iss1 >> t >> t >> text) && iss1.eof())
-                    || ((iss2 >> t >> t >> text >> text) && iss2.eof())){
-                    type = FileType::FTLABELS;
+    if(file.type==FileType::FTSOUND){
+        std::vector<int> channelids;
+        if(file.nchan==1){
+            // If there is only one channel, just load it
+            channelids.push_back(1);
+        }
+        else{
+            // If more than one channel, ask what to do
+            stopFileProgressDialog();
+            WDialogSelectChannel dlg(file.filepath, file.nchan, this);
+            if(dlg.exec()) {
+                if(dlg.ui->rdbImportEachChannel->isChecked()){
+                    for(int ci=1; ci<=file.nchan; ci++)
+                        channelids.push_back(ci);
                 }
-                else{
-                    stopFileProgressDialog();
-                    WDialogFileTypeChooserTxt dlg(this, filepath);
-                    int ret = dlg.exec();
-                    if(ret==1){
-                        type = dlg.selectedFileType();
-                        viewid = dlg.selectedView();
-                    }
+                else if(dlg.ui->rdbImportOnlyOneChannel->isChecked()){
+                    channelids.push_back(dlg.ui->sbChannelID->value());
+                }
+                else if(dlg.ui->rdbMergeAllChannels->isChecked()){
+                    channelids.push_back(-2);// -2 is a code for merging the channels
                 }
-            }
-            else if(container==FileType::FCEST) {
-                // Currently support only F0 data
-                type = FileType::FTFZERO;
-            }
-            else if(container==FileType::FCBINARY) {
-                // TODO
             }
         }
 
-        if(type==FileType::FTUNSET)
-            throw QString("Cannot find any data or audio channel in this file that is handled by DFasma.");
+        // The data will be decoded later on by the workers
+        for(size_t ci=0; ci<channelids.size(); ++ci){
+            FileToLoad sndfile = file;
+            sndfile.snd = new FTSound(file.filepath, this, channelids[ci], true);
+            toload.push_back(sndfile);
+        }
+    }
+    else
+        toload.push_back(file);
+}
 
-        // Finally, load the data knowing the file type and the container
-        if(type==FileType::FTSOUND){
-            int nchan = FTSound::getNumberOfChannels(filepath);
-            if(nchan==1){
-                // If there is only one channel, just load it
-                addItem(new FTSound(filepath, this));
-            }
-            else{
-                // If more than one channel, ask what to do
-                stopFileProgressDialog();
-                WDialogSelectChannel dlg(filepath, nchan, this);
-                if(dlg.exec()) {
-                    if(dlg.ui->rdbImportEachChannel->isChecked()){
-                        for(int ci=1; ci<=nchan; ci++){
-                            addItem(new FTSound(filepath, this, ci));
-                        }
-                    }
-                    else if(dlg.ui->rdbImportOnlyOneChannel->isChecked()){
-                        addItem(new FTSound(filepath, this, dlg.ui->sbChannelID->value()));
-                    }
-                    else if(dlg.ui->rdbMergeAllChannels->isChecked()){
-                        addItem(new FTSound(filepath, this, -2));// -2 is a code for merging the channels
-                    }
-                }
-            }
+void WFilesList::attachFileToLoad(FileToLoad& file) {
 
-            if(ftsnds.size()>0){
-                // The first sound determines the common sampling frequency for the audio output
-                if(isfirsts)
-                    gMW->audioInitialize(ftsnds[0]->fs);
+    if(!file.error.isEmpty())
+        throw file.error;
 
-                gMW->m_gvWaveform->fitViewToSoundsAmplitude();
-            }
-        }
-        else if(type == FileType::FTFZERO){
-            addItem(new FTFZero(filepath, this, container));
-        }
-        else if(type == FileType::FTLABELS){
-            addItem(new FTLabels(filepath, this, container));
-        }
-        else if(type==FileType::FTGENTIMEVALUE){
-            WidgetGenericTimeValue* widget = NULL;
-//            if(viewid==-2)
-//                throw QString("A view has not been selected for "+filepath);
-            if(viewid==-1)
-                widget = gMW->addWidgetGenericTimeValue();
-            else
-                widget = gMW->m_wGenericTimeValues.at(viewid);
-            addItem(new FTGenericTimeValue(filepath, widget, container));
-        }
+    if(file.type==FileType::FTSOUND){
+        bool isfirsts = ftsnds.size()==0;
+
+        file.snd->attachDeferred();
+        addItem(file.snd);
+        file.snd = NULL; // Now owned by the list
+
+        // The first sound determines the common sampling frequency for the audio output
+        if(isfirsts)
+            gMW->audioInitialize(ftsnds[0]->fs);
     }
-    catch (QString err)
-    {
-        stopFileProgressDialog();
-        QMessageBox::StandardButton ret=QMessageBox::warning(this, "Failed to load file ...", "Data from the following file can't be loaded:\n"+filepath+"'\n\nReason:\n"+err, QMessageBox::Ok | QMessageBox::Abort, QMessageBox::Ok);
-        if(ret==QMessageBox::Abort)
-            if(m_prgdlg)
-                m_prgdlg->cancel();
+    else if(file.type == FileType::FTFZERO){
+        addItem(new FTFZero(file.filepath, this, file.container));
     }
-
-    if(m_loadingmsgbox){
-        m_loadingmsgbox->close();
-        delete m_loadingmsgbox;
-        m_loadingmsgbox = NULL;
+    else if(file.type == FileType::FTLABELS){
+        addItem(new FTLabels(file.filepath, this, file.container));
+    }
+    else if(file.type==FileType::FTGENTIMEVALUE){
+        WidgetGenericTimeValue* widget = NULL;
+//        if(file.viewid==-2)
+//            throw QString("A view has not been selected for "+file.filepath);
+        if(file.viewid==-1)
+            widget = gMW->addWidgetGenericTimeValue();
+        else
+            widget = gMW->m_wGenericTimeValues.at(file.viewid);
+        addItem(new FTGenericTimeValue(file.filepath, widget, file.container));
     }
 }
 
+void WFilesList::reportLoadingError(const QString& filepath, const QString& err) {
+    stopFileProgressDialog();
+    QMessageBox::StandardButton ret=QMessageBox::warning(this, "Failed to load file ...", "Data from the following file can't be loaded:\n"+filepath+"'\n\nReason:\n"+err, QMessageBox::Ok | QMessageBox::Abort, QMessageBox::Ok);
+    if(ret==QMessageBox::Abort)
+        if(m_prgdlg)
+            m_prgdlg->cancel();
+}
+
 
 bool WFilesList::hasFile(FileType *ft) const {
 //    COUTD << "FilesListWidget::hasItem " << ft << endl;
@@ -424,14 +611,8 @@ FTLabels* WFilesList::getCurrentFTLabels(bool forceselect) {
     return NULL;
 }
 void WFilesList::setLabelsEditable(bool editable){
-    for(size_t fi=0; fi<ftlabels.size(); fi++){
-        for(size_t li=0; li<ftlabels[fi]->waveform_labels.size(); li++){
-            if(editable)
-                ftlabels[fi]->waveform_labels[li]->setTextInteractionFlags(Qt::TextEditorInteraction);
-            else
-                ftlabels[fi]->waveform_labels[li]->setTextInteractionFlags(Qt::NoTextInteraction);
-        }
-    }
+    for(size_t fi=0; fi<ftlabels.size(); fi++)
+        ftlabels[fi]->setEditable(editable);
 }
 
 void WFilesList::showFileContextMenu(const QPoint& pos) {
@@ -492,6 +673,18 @@ void WFilesList::fileSelectionChanged() {
                 m_nb_fzeros_in_selection++;
         }
 
+        // A/B comparison: continue the playback with the newly selected sound
+        if(currfile && currfile->is(FileType::FTSOUND)
+           && gMW->m_dlgSettings->ui->cbPlaybackSwitchOnSelection->isChecked()
+           && gMW->m_audioengine && gMW->m_audioengine->state()==QAudio::ActiveState){
+            try {
+                gMW->m_audioengine->switchPlayback((FTSound*)currfile);
+            }
+            catch(QString err){
+                gMW->statusBar()->showMessage("Cannot switch the playback: "+err, 3000);
+            }
+        }
+
         // Update the spectrogram to current selected signal
         if(m_nb_snds_in_selection>0){
             if(gMW->m_gvWaveform->m_aWaveformShowSelectedWaveformOnTop){
@@ -501,6 +694,7 @@ void WFilesList::fileSelectionChanged() {
                 gMW->m_gvSpectrumGroupDelay->m_scene->update();
             }
             gMW->m_gvSpectrogram->updateSTFTPlot();
+            gMW->m_gvSpectrogram->requestF0Preview();
             gMW->m_gvSpectrogram->m_scene->update();
         }
         if(m_nb_fzeros_in_selection>0){
@@ -742,6 +936,31 @@ void WFilesList::selectedFilesSave() {
     }
 }
 
+// Run the F0 estimation of a single file, without any GUI interaction
+class F0EstimationTask : public QRunnable {
+    FTFZero::Estimation* m_est;
+    QAtomicInt* m_done;
+    QAtomicInt* m_canceled;
+
+public:
+    F0EstimationTask(FTFZero::Estimation* est, QAtomicInt* done, QAtomicInt* canceled)
+        : m_est(est), m_done(done), m_canceled(canceled)
+    {}
+    void run() {
+        if(!m_canceled->load()){
+            try{
+                FTFZero::computeEstimation(*m_est);
+            }
+            catch(QString err){
+                m_est->error = err;
+            }
+            // Free the copy of the signal as soon as possible
+            std::vector<int16_t>().swap(m_est->data);
+        }
+        m_done->fetchAndAddOrdered(1);
+    }
+};
+
 void WFilesList::selectedFilesEstimateF0() {
     QList<QListWidgetItem*> l = selectedItems();
 
@@ -761,41 +980,105 @@ void WFilesList::selectedFilesEstimateF0() {
 
     bool force = QGuiApplication::keyboardModifiers().testFlag(Qt::ShiftModifier);
 
+    // List the files to estimate, in the order of the selection
+    std::vector<FileType*> files;
+    for(int i=0; i<l.size(); i++) {
+        FileType* currentfile = (FileType*)l.at(i);
+        if(currentfile->is(FileType::FTSOUND) || currentfile->is(FileType::FTFZERO))
+            files.push_back(currentfile);
+    }
+    if(files.empty())
+        return;
+
+    // A single file is estimated in the background,
+    // so that the views can be used while its segments show up.
+    if(files.size()==1){
+        if(files[0]->is(FileType::FTSOUND))
+            gFL->addItem(new FTFZero(gFL, (FTSound*)files[0], f0min, f0max, tstart, tend, force));
+        else
+            ((FTFZero*)files[0])->estimate(NULL, f0min, f0max, tstart, tend, force);
+        gMW->updateWindowTitle();
+        return;
+    }
+
+    if(getFs()<6000.0)
+        QMessageBox::warning(gMW, "Problem during estimation of F0", "Sampling rate is smaller than 6kHz, which may create substantial estimation errors.");
+
     // These progress dialogs HAVE to be built on the stack otherwise ghost dialogs appear.
-    QProgressDialog prgdlg("Estimating F0...", "Abort", 0, l.size(), this);
+    QProgressDialog prgdlg("Estimating F0...", "Abort", 0, int(files.size()), this);
     prgdlg.setMinimumDuration(500);
     m_prgdlg = &prgdlg;
 
-    for(int i=0; i<l.size() && !m_prgdlg->wasCanceled(); i++) {
-        FileType* currentfile = (FileType*)l.at(i);
+    QStringList errors;
+
+    // Copy the signals in the GUI thread, and run one independent estimation per file
+    std::vector<FTFZero::Estimation> ests(files.size());
+    QThreadPool pool;
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    // Share the threads among the files, so that the segments of long recordings don't oversubscribe them
+    const int maxthreads = std::max(1, QThread::idealThreadCount()/std::max(1, std::min(int(files.size()), QThread::idealThreadCount())));
+    QAtomicInt done(0);
+    QAtomicInt canceled(0);
+    for(size_t fi=0; fi<files.size() && !prgdlg.wasCanceled(); ++fi){
+        FTSound* snd = NULL;
+        if(files[fi]->is(FileType::FTSOUND))
+            snd = (FTSound*)files[fi];
+        else
+            snd = ((FTFZero*)files[fi])->m_src_snd;
+
+        if(!hasFile(snd)){
+            ests[fi].error = "The source file used for updating the F0 is not listed in the application anymore.";
+            done.fetchAndAddOrdered(1);
+            continue;
+        }
+        if(files[fi]->is(FileType::FTFZERO) && ((FTFZero*)files[fi])->isEstimating()){
+            ests[fi].error = "An estimation of this F0 is already running.";
+            done.fetchAndAddOrdered(1);
+            continue;
+        }
+
+        FTFZero::prepareEstimation(snd, f0min, f0max, tstart, tend, force, ests[fi]);
+        ests[fi].canceled = &canceled; // Aborting also stops the running estimations
+        ests[fi].maxthreads = maxthreads;
+        pool.start(new F0EstimationTask(&(ests[fi]), &done, &canceled));
+    }
+    waitForLoadingWorkers(pool, done, canceled, m_prgdlg);
+
+    // Attach the results in the order of the selection
+    for(size_t fi=0; fi<files.size(); ++fi){
+        if(!ests[fi].computed && canceled.load())
+            continue; // Aborted, nothing to report
+        if(!ests[fi].error.isEmpty()){
+            errors.append(files[fi]->visibleName+": "+ests[fi].error);
+            continue;
+        }
+        if(!ests[fi].computed)
+            continue; // Canceled
 
         try {
             // If from a sound, generate a new F0 file
-            if(currentfile->is(FileType::FTSOUND))
-                gFL->addItem(new FTFZero(gFL, (FTSound*)currentfile, f0min, f0max, tstart, tend, force));
+            if(files[fi]->is(FileType::FTSOUND))
+                gFL->addItem(new FTFZero(gFL, (FTSound*)files[fi], ests[fi]));
 
             // If from an F0 file, update it
-            if(currentfile->is(FileType::FTFZERO))
-                ((FTFZero*)currentfile)->estimate(NULL, f0min, f0max, tstart, tend, force);
-
-            gMW->m_gvSpectrogram->m_scene->update();
-            gMW->m_gvSpectrumAmplitude->m_scene->update();
-
-            m_prgdlg->setValue(i);
+            if(files[fi]->is(FileType::FTFZERO))
+                ((FTFZero*)files[fi])->applyEstimation(ests[fi]);
         }
         catch(QString err){
-            gMW->globalWaitingBarDone();
-            stopFileProgressDialog();
-            QMessageBox::StandardButton ret=QMessageBox::warning(gMW, "Error during F0 estimation", "Estimation of the F0 of "+currentfile->visibleName+" failed for the following reason:\n"+err, QMessageBox::Ok | QMessageBox::Abort, QMessageBox::Ok);
-            if(ret==QMessageBox::Abort)
-                if(m_prgdlg)
-                    m_prgdlg->cancel();
+            errors.append(files[fi]->visibleName+": "+err);
         }
     }
 
+    gMW->m_gvSpectrogram->m_scene->update();
+    gMW->m_gvSpectrumAmplitude->m_scene->update();
+
     stopFileProgressDialog();
     m_prgdlg = NULL;
 
+    // A single report for all the failures
+    if(!errors.isEmpty())
+        QMessageBox::warning(gMW, "Error during F0 estimation", "Estimation of the F0 failed for "+QString::number(errors.size())+" file(s):\n"+errors.join("\n"));
+
     gMW->updateWindowTitle();
 }
 
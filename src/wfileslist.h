@@ -21,16 +21,19 @@ file provided in the source code of DFasma. Another copy can be found at
 #ifndef FILESLISTWIDGET_H
 #define FILESLISTWIDGET_H
 
+#include <vector>
+#include <set>
 #include <QListWidget>
 #include <QMainWindow>
 class QProgressDialog;
+class QFileSystemWatcher;
+class QTimer;
 
 #include "filetype.h"
 class FTSound;
 class FTFZero;
 class FTLabels;
 class FTGenericTimeValue;
-class QMessageBox;
 
 #ifdef SIGPROC_FLOAT
 #define WAVTYPE float
@@ -51,13 +54,17 @@ class WFilesList : public QListWidget
     // I cannot find a way to do it already from the Qt5 library.
     // (FilesListWidget::hasItem returns NULL)
     std::map<FileType*,bool> m_present_files;
-    void addExistingFilesRecursive(const QStringList& files, FileType::FType type=FileType::FTUNSET);
 
     std::deque<FileType*> m_current_sourced;
 
+    // Watch the files on the disc, instead of checking them all on each focus change
+    QFileSystemWatcher* m_filewatcher;
+    std::map<QString,int> m_watchedfiles; // Number of files in the list using each watched path
+    QTimer* m_filewatcherdebounce;        // Wait for the writing to settle before checking the files
+    std::set<QString> m_changedfiles;
+
     // The progress dialog when loading a lot of files
     QProgressDialog* m_prgdlg;
-    QMessageBox* m_loadingmsgbox;
     void stopFileProgressDialog();
 
     enum CurrentAction {CANothing, CASetSource};
@@ -65,6 +72,29 @@ class WFilesList : public QListWidget
 
     virtual void keyPressEvent(QKeyEvent * event);
 
+public:
+    // Used for the parallel loading of files.
+    // Guessing the containers and decoding the sounds is done by workers,
+    // whereas dialogs and attachment to the views is done in the GUI thread.
+    class FileToLoad {
+    public:
+        QString filepath;
+        FileType::FType type;
+        FileType::FileContainer container;
+        int nchan;     // Number of channels (sounds only)
+        int viewid;    // View where to add the file (generic time/value only)
+        FTSound* snd;  // Sound under decoding (sounds only)
+        QString error;
+        FileToLoad(const QString& _filepath=QString(), FileType::FType _type=FileType::FTUNSET)
+            : filepath(_filepath), type(_type), container(FileType::FCUNSET), nchan(0), viewid(-1), snd(NULL)
+        {}
+    };
+private:
+    void listFilesRecursive(const QStringList& files, FileType::FType type, std::vector<FileToLoad>& list);
+    void resolveFileToLoad(FileToLoad file, std::vector<FileToLoad>& toload);
+    void attachFileToLoad(FileToLoad& file);
+    void reportLoadingError(const QString& filepath, const QString& err);
+
 public:
     explicit WFilesList(QMainWindow *parent = 0);
 
@@ -77,6 +107,9 @@ public:
     std::deque<FTGenericTimeValue*> ftgenerictimevalues;
     bool hasFile(FileType *ft) const;
 
+    void watchFile(const QString& filepath);
+    void unwatchFile(const QString& filepath);
+
     void addExistingFiles(const QStringList& files, FileType::FType type=FileType::FTUNSET);
     void addExistingFile(const QString& filepath, FileType::FType type=FileType::FTUNSET);
 
@@ -96,6 +129,10 @@ public:
     void openEditor(QWidget * editor);
     void closeEditor(QWidget * editor, QAbstractItemDelegate::EndEditHint hint);
 
+private slots:
+    void fileChangedOnDisc(const QString& filepath);
+    void checkChangedFiles();
+
 public slots:
     void changeFileListItemsSize();
     void checkFileModifications();
@@ -39,6 +39,7 @@ file provided in the source code of DFasma. Another copy can be found at
 #include "gvspectrogramwdialogsettings.h"
 #include "ui_gvspectrogramwdialogsettings.h"
 #include "gvgenerictimevalue.h"
+#include "gvplaycursor.h"
 #include "ftsound.h"
 #include "ftfzero.h"
 #include "ftlabels.h"
@@ -168,6 +169,7 @@ WMainWindow::WMainWindow(QStringList filestoload, QStringList genericfilestoload
     addAction(ui->actionSelectedFilesDuplicate);
     addAction(ui->actionSelectedFilesSave);
     addAction(ui->actionPlayFiltered);
+    addAction(ui->actionPlayMixed);
     addAction(ui->actionEstimationF0);
     addAction(ui->actionEstimationF0Forced);
     addAction(ui->actionEstimationVoicedUnvoicedMarkers);
@@ -177,6 +179,8 @@ WMainWindow::WMainWindow(QStringList filestoload, QStringList genericfilestoload
     ui->actionPlay->setEnabled(false);
     connect(ui->actionPlay, SIGNAL(triggered()), this, SLOT(play()));
     connect(ui->actionPlayFiltered, SIGNAL(triggered()), this, SLOT(playFiltered()));
+    connect(ui->actionPlayMixed, SIGNAL(triggered()), this, SLOT(playMixed()));
+    ui->actionPlayLoop->setIcon(style()->standardIcon(QStyle::SP_BrowserReload));
     m_pbVolume = new QProgressBar(this);
     m_pbVolume->setOrientation(Qt::Vertical);
     m_pbVolume->setTextVisible(false);
@@ -304,6 +308,7 @@ WMainWindow::WMainWindow(QStringList filestoload, QStringList genericfilestoload
         connect(m_audioengine, SIGNAL(formatChanged(const QAudioFormat&)), this, SLOT(audioOutputFormatChanged(const QAudioFormat&)));
         connect(m_audioengine, SIGNAL(playPositionChanged(double)), m_gvWaveform, SLOT(playCursorSet(double)));
         connect(m_audioengine, SIGNAL(localEnergyChanged(double)), this, SLOT(localEnergyChanged(double)));
+        connect(ui->actionPlayLoop, SIGNAL(toggled(bool)), m_audioengine, SLOT(setLoop(bool)));
         // List the audio devices and select the first one
         m_dlgSettings->ui->cbPlaybackAudioOutputDevices->clear();
         QList<QAudioDeviceInfo> audioDevices = m_audioengine->availableAudioOutputDevices();
@@ -883,16 +888,16 @@ void WMainWindow::audioEnable(bool enable){
         ui->actionPlay->setVisible(true);
         m_audioSeparatorAction->setVisible(true);
         m_pbVolumeAction->setVisible(true);
-        m_gvWaveform->m_giPlayCursor->show();
-        m_gvSpectrogram->m_giPlayCursor->show();
+        m_gvWaveform->m_playcursor->setVisible(true);
+        m_gvSpectrogram->m_playcursor->setVisible(true);
     }
     else {
         DLOG << "Audio NOT Available";
         ui->actionPlay->setVisible(false);
         m_pbVolumeAction->setVisible(false);
         m_audioSeparatorAction->setVisible(false);
-        m_gvWaveform->m_giPlayCursor->hide();
-        m_gvSpectrogram->m_giPlayCursor->hide();
+        m_gvWaveform->m_playcursor->setVisible(false);
+        m_gvSpectrogram->m_playcursor->setVisible(false);
     }
 }
 
@@ -931,7 +936,10 @@ void WMainWindow::audioOutputFormatChanged(const QAudioFormat &format) {
         // Display some information
         QString str = "";
         str += "Codec: "+QString::number(format.channelCount())+" channel "+m_audioengine->format().codec()+"<br/>";
-        str += "Sampling frequency: "+QString::number(format.sampleRate())+"Hz<br/>";
+        str += "Sampling frequency: "+QString::number(format.sampleRate())+"Hz";
+        if(FTSound::s_fs_common>0 && format.sampleRate()!=int(FTSound::s_fs_common))
+            str += " (resampled on the fly from "+QString::number(FTSound::s_fs_common)+"Hz)";
+        str += "<br/>";
         str += "Sample type: "+QString::number(format.sampleSize())+"b ";
         QAudioFormat::SampleType sampletype = format.sampleType();
         if(sampletype==QAudioFormat::Unknown)
@@ -971,7 +979,7 @@ void WMainWindow::play(bool filtered){
             FTSound* currentftsound = gFL->getCurrentFTSound(true);
             if(currentftsound){
 
-                double tstart = m_gvWaveform->m_giPlayCursor->pos().x();
+                double tstart = m_gvWaveform->getPlayCursorPosition();
                 double tstop = gFL->getMaxLastSampleTime();
                 if(m_gvWaveform->m_selection.width()>0){
                     tstart = m_gvWaveform->m_selection.left();
@@ -1009,6 +1017,58 @@ void WMainWindow::play(bool filtered){
         statusBar()->showMessage("The sound cannot be played. Please check settings for details.");
 }
 
+void WMainWindow::playMixed(){
+    DLOG << "WMainWindow::playMixed";
+
+    if(m_audioengine
+       && m_audioengine->isInitialized()){
+
+        if(m_audioengine->state()==QAudio::IdleState
+           || m_audioengine->state()==QAudio::StoppedState){
+
+            // Mix all the selected sounds
+            std::vector<FTSound*> sounds;
+            QList<QListWidgetItem*> list = gFL->selectedItems();
+            for(int i=0; i<list.size(); i++){
+                FileType* file = (FileType*)list.at(i);
+                if(file->is(FileType::FTSOUND))
+                    sounds.push_back((FTSound*)file);
+            }
+            if(sounds.empty()){
+                statusBar()->showMessage("Select the sounds to play together in the files list.", 3000);
+                return;
+            }
+
+            double tstart = m_gvWaveform->getPlayCursorPosition();
+            double tstop = gFL->getMaxLastSampleTime();
+            if(m_gvWaveform->m_selection.width()>0){
+                tstart = m_gvWaveform->m_selection.left();
+                tstop = m_gvWaveform->m_selection.right();
+            }
+
+            try {
+                m_gvWaveform->m_initialPlayPosition = tstart;
+                m_playingftsound = NULL; // The audio engine stops the mixed sounds
+                m_audioengine->startPlayback(sounds, tstart, tstop, m_dlgSettings->ui->sbPlaybackMixingHeadroom->value());
+
+                ui->actionPlay->setEnabled(false);
+                // Delay the stop and re-play,
+                // to avoid the audio engine to go hysterical and crash.
+                QTimer::singleShot(250, this, SLOT(enablePlay()));
+            }
+            catch(QString err){
+                statusBar()->showMessage("Error during playback: "+err);
+            }
+        }
+        else if(m_audioengine->state()==QAudio::ActiveState){
+            // If playing, just stop it
+            m_audioengine->stopPlayback();
+        }
+    }
+    else
+        statusBar()->showMessage("The sound cannot be played. Please check settings for details.");
+}
+
 void WMainWindow::enablePlay(){
     ui->actionPlay->setEnabled(true); // Re-enable the play/stop button once the timer m_playreenabler timed out.
 }
@@ -97,6 +97,7 @@ private slots:
 
     void play(bool filtered=false);
     void playFiltered();
+    void playMixed();
     void audioStateChanged(QAudio::State state);
     void audioOutputFormatChanged(const QAudioFormat& format);
     void enablePlay();
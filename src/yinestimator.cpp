@@ -0,0 +1,140 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#include "yinestimator.h"
+
+#include <algorithm>
+#include <qmath.h>
+
+#define YIN_THRESHOLD 0.15 // Below which a dip of the normalized difference is taken as a period
+#define YIN_SILENCE 1e-10  // [mean energy] Below which the frame is unvoiced
+
+YINEstimator::YINEstimator() {
+    m_fft = new qae::FFTwrapper();
+}
+
+YINEstimator::~YINEstimator() {
+    delete m_fft;
+}
+
+// Returns the F0 [Hz] of the frame, 0 if unvoiced.
+// frame has framelen=2*taumax samples, m_fft has to be at least twice as long.
+double YINEstimator::estimateFrame(const FFTTYPE* frame, int framelen, double fs, int taumin, int taumax) {
+    int N = m_fft->size();
+
+    m_energy.resize(framelen+1);
+    m_energy[0] = 0.0;
+    for(int n=0; n<framelen; ++n)
+        m_energy[n+1] = m_energy[n] + frame[n]*frame[n];
+    if(m_energy[framelen]<YIN_SILENCE*framelen)
+        return 0.0;
+
+    // Autocorrelation r[tau]=sum_n frame[n]*frame[n+tau], from the power spectrum.
+    // The power spectrum is real and even, so that its inverse DFT is its forward DFT divided by N.
+    for(int n=0; n<framelen; ++n)
+        m_fft->in[n] = frame[n];
+    for(int n=framelen; n<N; ++n)
+        m_fft->in[n] = 0.0;
+    m_fft->execute();
+    m_power.resize(N/2+1);
+    for(int k=0; k<=N/2; ++k)
+        m_power[k] = std::norm(m_fft->out[k]);
+    m_fft->in[0] = m_power[0];
+    for(int k=1; k<N/2; ++k)
+        m_fft->in[k] = m_fft->in[N-k] = m_power[k];
+    m_fft->in[N/2] = m_power[N/2];
+    m_fft->execute();
+
+    // Difference function d[tau]=sum_n (frame[n]-frame[n+tau])^2 over the framelen-tau overlapping samples,
+    // divided by their number, and its cumulative mean normalization
+    m_cmnd.resize(taumax+1);
+    m_cmnd[0] = 1.0;
+    FFTTYPE cumsum = 0.0;
+    for(int tau=1; tau<=taumax; ++tau){
+        FFTTYPE r = m_fft->out[tau].real()/N;
+        FFTTYPE d = m_energy[framelen-tau] + (m_energy[framelen]-m_energy[tau]) - 2*r;
+        d = std::max(FFTTYPE(0.0), d/(framelen-tau));
+        cumsum += d;
+        m_cmnd[tau] = (cumsum>0.0)?d*tau/cumsum:1.0;
+    }
+
+    // First dip below the threshold, down to its local minimum
+    int tau = taumin;
+    while(tau<=taumax && m_cmnd[tau]>=YIN_THRESHOLD)
+        ++tau;
+    if(tau>taumax)
+        return 0.0;
+    while(tau+1<=taumax && m_cmnd[tau+1]<m_cmnd[tau])
+        ++tau;
+
+    // Parabolic interpolation of the minimum
+    double period = tau;
+    if(tau>taumin && tau<taumax){
+        double a = m_cmnd[tau-1];
+        double b = m_cmnd[tau];
+        double c = m_cmnd[tau+1];
+        double den = a - 2*b + c;
+        if(den>0.0)
+            period += 0.5*(a-c)/den;
+    }
+
+    return fs/period;
+}
+
+void YINEstimator::estimate(const std::vector<WAVTYPE>& wav, double fs, int64_t delay, double tstart, double tend, double step, double f0min, double f0max, std::vector<double>& ts, std::vector<double>& f0s) {
+    ts.clear();
+    f0s.clear();
+    if(tend<tstart || step<=0.0 || f0min<=0.0 || f0max<=f0min)
+        return;
+
+    int taumin = std::max(2, int(std::floor(fs/f0max)));
+    int taumax = int(std::ceil(fs/f0min));
+    if(taumax<=taumin)
+        return;
+    int framelen = 2*taumax;
+
+    // Twice the frame length, for avoiding the circular aliasing of the autocorrelation
+    int N = 2;
+    while(N<2*framelen)
+        N *= 2;
+    if(m_fft->size()!=N)
+        m_fft->resize(N);
+
+    std::vector<FFTTYPE> frame(framelen);
+    int64_t nbframes = int64_t((tend-tstart)/step)+1;
+    ts.resize(nbframes);
+    f0s.resize(nbframes);
+    for(int64_t i=0; i<nbframes; ++i){
+        ts[i] = tstart + i*step;
+
+        // Frame centered on ts[i]
+        int64_t first = int64_t(ts[i]*fs+0.5) - taumax - delay;
+        for(int n=0; n<framelen; ++n){
+            int64_t idx = first+n;
+            frame[n] = (idx>=0 && idx<int64_t(wav.size()))?wav[idx]:0.0;
+        }
+
+        double f0 = estimateFrame(frame.data(), framelen, fs, taumin, taumax);
+        if(f0>0.0)
+            f0 = std::max(f0min, std::min(f0max, f0));
+        f0s[i] = f0;
+    }
+}
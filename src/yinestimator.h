@@ -0,0 +1,52 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef YINESTIMATOR_H
+#define YINESTIMATOR_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "qaesigproc.h"
+
+// Fast F0 estimation, for previewing while adjusting the estimation parameters.
+// Follows YIN (de Cheveigné and Kawahara, 2002), with the difference function
+// derived from the autocorrelation of each frame, which is computed by FFT.
+// Far less robust than REAPER, but orders of magnitude faster.
+class YINEstimator
+{
+    qae::FFTwrapper* m_fft;
+    std::vector<FFTTYPE> m_power;  // Power spectrum of the frame
+    std::vector<FFTTYPE> m_energy; // Cumulated energy of the frame
+    std::vector<FFTTYPE> m_cmnd;   // Cumulative mean normalized difference
+
+    double estimateFrame(const FFTTYPE* frame, int framelen, double fs, int taumin, int taumax);
+
+public:
+    YINEstimator();
+    ~YINEstimator();
+
+    // Estimate the F0 [Hz] every step [s] in [tstart,tend] [s] (0 if unvoiced)
+    // wav[n] is the sample at time (n+delay)/fs
+    void estimate(const std::vector<WAVTYPE>& wav, double fs, int64_t delay, double tstart, double tend, double step, double f0min, double f0max, std::vector<double>& ts, std::vector<double>& f0s);
+};
+
+#endif // YINESTIMATOR_H
@@ -0,0 +1,106 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+// Compare BiquadCascade::filtfilt with scipy.signal.sosfiltfilt, at the edges and across blocks.
+// The reference values were computed with:
+//  sos = np.vstack([scipy.signal.butter(8, 4000, 'low', fs=16000, output='sos'), scipy.signal.butter(6, 300, 'high', fs=16000, output='sos')])
+//  n = np.arange(5000)
+//  y = scipy.signal.sosfiltfilt(sos, np.sin(2*np.pi*220*n/16000)+0.5*np.cos(2*np.pi*5000*n/16000)+0.3)
+// Build and run from this directory:
+//  g++ -I../src test_biquadcascade.cpp ../src/biquadcascade.cpp -o test_biquadcascade && ./test_biquadcascade
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+#include "biquadcascade.h"
+
+static const double s_sos[7][6] = {
+    {0.0092672855840887705, 0.018534571168177541, 0.0092672855840887705, 1, -1.3877787807814457e-16, 0.0097005565352636224},
+    {1, 2, 1, 1, -1.9428902930940244e-16, 0.092019210455573097},
+    {1, 2, 1, 1, -1.6653345369377353e-16, 0.2857021544554057},
+    {1, 2, 1, 1, -2.2204460492503131e-16, 0.67351367771599169},
+    {0.79631696882965874, -1.5926339376593175, 0.79631696882965874, 1, -1.7836363810069937, 0.79608602862707778},
+    {1, -2, 1, 1, -1.8337326589246477, 0.84653197479202347},
+    {1, -2, 1, 1, -1.9275005788340498, 0.9409543877210631}
+};
+
+static const double s_expected[20][2] = {
+    {0, 0.027016933974632507},
+    {1, -0.51852448537638152},
+    {2, -0.56095320930680392},
+    {3, -0.29902139408159445},
+    {4, -0.20034561309781426},
+    {5, -0.28484628677023677},
+    {6, -0.28433950095693927},
+    {7, -0.17047927879331015},
+    {2046, 0.016801891581672869}, // Around the end of the first block
+    {2047, 0.018355763081460984},
+    {2048, 0.02060445082850618},
+    {2049, 0.020526012886178936},
+    {4992, -0.2374075093393398},
+    {4993, -0.27130616164200994},
+    {4994, -0.25519677061960622},
+    {4995, -0.20060381103820851},
+    {4996, -0.21298697752372098},
+    {4997, -0.28086610596359152},
+    {4998, -0.22358968859158868},
+    {4999, 0.029548789677811854}
+};
+
+int main() {
+    std::vector< std::vector<double> > num, den;
+    for(int si=0; si<7; ++si){
+        num.push_back(std::vector<double>(s_sos[si], s_sos[si]+3));
+        den.push_back(std::vector<double>(s_sos[si]+3, s_sos[si]+6));
+    }
+    BiquadCascade cascade;
+    cascade.addSections(num, den);
+
+    std::vector<WAVTYPE> x(5000);
+    for(size_t n=0; n<x.size(); ++n)
+        x[n] = std::sin(2*M_PI*220*n/16000.0) + 0.5*std::cos(2*M_PI*5000*n/16000.0) + 0.3;
+    cascade.filtfilt(x);
+
+    bool ok = true;
+    for(int i=0; i<20; ++i){
+        size_t n = size_t(s_expected[i][0]);
+        if(std::abs(x[n]-s_expected[i][1])>1e-6){
+            std::cout << "FAILED n=" << n << ": " << x[n] << " instead of " << s_expected[i][1] << std::endl;
+            ok = false;
+        }
+    }
+
+    // Shorter than the extensions (scipy needs padlen=len-1 for these)
+    std::vector<WAVTYPE> constant(10, 0.5);
+    cascade.filtfilt(constant);
+    for(size_t n=0; n<constant.size(); ++n){
+        if(std::abs(constant[n])>1e-6){ // The high-pass removes a constant entirely
+            std::cout << "FAILED constant n=" << n << ": " << constant[n] << " instead of 0" << std::endl;
+            ok = false;
+        }
+    }
+
+    if(ok)
+        std::cout << "OK" << std::endl;
+
+    return ok?0:1;
+}
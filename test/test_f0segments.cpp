@@ -0,0 +1,102 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+// Compare the F0 tracked in segments with the F0 tracked over the whole recording.
+// Needs the REAPER submodule (git submodule update --init).
+// Build and run from this directory:
+//  g++ -fPIC -I../src -I../external/REAPER test_f0segments.cpp ../src/ftfzerotracking.cpp ../external/REAPER/epoch_tracker/epoch_tracker.cc ../external/REAPER/epoch_tracker/fft.cc ../external/REAPER/epoch_tracker/fd_filter.cc ../external/REAPER/epoch_tracker/lpc_analyzer.cc $(pkg-config --cflags --libs Qt5Widgets) -o test_f0segments && ./test_f0segments
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+#include "ftfzero.h"
+
+// Not linked with the GUI side of FTFZero
+void FTFZeroEstimationThread::publishSegment(int64_t, const float*, size_t) {}
+
+// Harmonic signal with a slowly varying F0 and, optionally, a short silence every gapperiod seconds
+static std::vector<int16_t> synthesize(double fs, double duration, double gapperiod) {
+    std::vector<int16_t> data(size_t(duration*fs));
+    double phase = 0.0;
+    for(size_t n=0; n<data.size(); ++n){
+        double t = n/fs;
+        double f0 = 140.0 + 40.0*std::sin(2*M_PI*t/7.3) + 10.0*std::sin(2*M_PI*t/1.1);
+        phase += 2*M_PI*f0/fs;
+        double value = 0.0;
+        for(int h=1; h*f0<0.4*fs && h<=20; ++h)
+            value += std::cos(h*phase)/h;
+        if(gapperiod>0.0 && std::fmod(t, gapperiod)>gapperiod-0.4)
+            value = 0.0;
+        data[n] = int16_t(3000.0*value + (std::rand()%21-10)); // Low noise, so that the silences are not digital zeros
+    }
+    return data;
+}
+
+static bool check(const char* name, double gapperiod) {
+    FTFZero::Estimation whole;
+    whole.fs = 16000.0;
+    whole.f0min = 60.0;
+    whole.f0max = 400.0;
+    whole.timestepsize = 0.005;
+    whole.data = synthesize(whole.fs, 95.0, gapperiod);
+
+    FTFZero::Estimation segmented = whole;
+    segmented.segmentduration = 20.0;
+
+    FTFZero::trackF0(whole.data.data(), whole.data.size(), whole, whole.f0);
+    FTFZero::trackF0Segmented(segmented);
+
+    if(segmented.nbsegments<2){
+        std::cout << "FAILED " << name << ": not segmented (" << segmented.nbsegments << " segment)" << std::endl;
+        return false;
+    }
+    if(whole.f0.size()!=segmented.f0.size()){
+        std::cout << "FAILED " << name << ": " << segmented.f0.size() << " frames instead of " << whole.f0.size() << std::endl;
+        return false;
+    }
+
+    // The overlaps are tracked twice, so the stitched F0 should be the same as the whole one
+    size_t nbvoicingdiffs = 0;
+    size_t nbf0diffs = 0;
+    for(size_t i=0; i<whole.f0.size(); ++i){
+        bool wv = whole.f0[i]>0.0f;
+        bool sv = segmented.f0[i]>0.0f;
+        if(wv!=sv)
+            nbvoicingdiffs++;
+        else if(wv && std::abs(segmented.f0[i]-whole.f0[i])>0.01*whole.f0[i])
+            nbf0diffs++;
+    }
+    bool ok = nbvoicingdiffs+nbf0diffs<=whole.f0.size()/100;
+
+    std::cout << (ok?"OK ":"FAILED ") << name << ": " << segmented.nbsegments << " segments, mismatch in the overlaps " << segmented.maxmismatch << "Hz, " << nbvoicingdiffs << " voicing and " << nbf0diffs << " F0 differences over " << whole.f0.size() << " frames" << std::endl;
+
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+
+    ok = check("with silences", 3.0) && ok;   // The cuts fall in the silences
+    ok = check("continuous", 0.0) && ok;      // The cuts fall in voiced segments
+
+    return ok?0:1;
+}
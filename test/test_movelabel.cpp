@@ -0,0 +1,90 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+// Time the moves of one label among 50k labels, as done by FTLabels::moveLabel,
+// and check that the labels stay sorted with their texts.
+// Build and run from this directory:
+//  g++ -O2 -fPIC -I../src test_movelabel.cpp $(pkg-config --cflags --libs Qt5Core) -o test_movelabel && ./test_movelabel
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+
+#include <QString>
+
+#include "sortedmove.h"
+
+#define NBLABELS 50000
+
+struct Labels {
+    std::vector<double> starts;
+    std::vector<QString> labels;
+    std::vector<QString> fulltexts;
+
+    int move(int index, double t) {
+        int newindex = sortedMoveIndex(starts, index, t);
+        sortedMove(starts, index, newindex);
+        sortedMove(labels, index, newindex);
+        sortedMove(fulltexts, index, newindex);
+        starts[newindex] = t;
+        return newindex;
+    }
+};
+
+// Time per move [us]
+static double timeMoves(Labels& ls, int nbmoves, bool far, bool& ok) {
+    std::clock_t start = std::clock();
+    for(int m=0; m<nbmoves; ++m){
+        int index = std::rand()%NBLABELS;
+        double t;
+        if(far)
+            t = (index<NBLABELS/2)?NBLABELS+0.5:-0.5; // Across the whole file
+        else
+            t = ls.starts[index]+(std::rand()%7-3)+0.5; // Among its neighbors
+        QString text = ls.fulltexts[index];
+        int newindex = ls.move(index, t);
+        if(ls.fulltexts[newindex]!=text || ls.labels[newindex]!=text || ls.starts[newindex]!=t)
+            ok = false;
+    }
+    return 1e6*double(std::clock()-start)/CLOCKS_PER_SEC/nbmoves;
+}
+
+int main() {
+    Labels ls;
+    for(int i=0; i<NBLABELS; ++i){
+        ls.starts.push_back(i);
+        ls.labels.push_back(QString("label")+QString::number(i));
+        ls.fulltexts.push_back(ls.labels.back());
+    }
+
+    bool ok = true;
+    double nearus = timeMoves(ls, 100000, false, ok);
+    double farus = timeMoves(ls, 200, true, ok);
+
+    for(int i=1; i<NBLABELS; ++i)
+        if(ls.starts[i]<ls.starts[i-1])
+            ok = false;
+
+    std::cout << (ok?"OK":"FAILED") << " " << NBLABELS << " labels: move among its neighbors " << nearus << "us, across the file " << farus << "us" << std::endl;
+
+    return ok?0:1;
+}
@@ -0,0 +1,75 @@
+/*
+Copyright (C) 2015  Gilles Degottex <gilles.degottex@gmail.com>
+
+This file is part of DFasma.
+
+DFasma is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+DFasma is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+A copy of the GNU General Public License is available in the LICENSE.txt
+file provided in the source code of DFasma. Another copy can be found at
+<http://www.gnu.org/licenses/>.
+*/
+
+
+// Compare SlidingWindowMaximum with a brute force maximum.
+// Build and run from this directory:
+//  g++ -I../src test_slidingwindowmaximum.cpp -o test_slidingwindowmaximum && ./test_slidingwindowmaximum
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#include "slidingwindowmaximum.h"
+
+static bool check(const char* name, const std::vector<WAVTYPE>& values, int64_t winlen) {
+    SlidingWindowMaximum swm;
+    swm.reset(winlen);
+    for(size_t n=0; n<values.size(); ++n){
+        swm.push(values[n]);
+        WAVTYPE expected = values[n];
+        for(int64_t k=std::max(int64_t(0), int64_t(n)-winlen+1); k<=int64_t(n); ++k)
+            expected = std::max(expected, values[k]);
+        if(swm.max()!=expected){
+            std::cout << "FAILED " << name << " winlen=" << winlen << " n=" << n << ": " << swm.max() << " instead of " << expected << std::endl;
+            return false;
+        }
+    }
+    std::cout << "OK " << name << " winlen=" << winlen << std::endl;
+    return true;
+}
+
+int main() {
+    bool ok = true;
+
+    for(int64_t winlen=1; winlen<=8; ++winlen){
+        // Strictly decreasing, longer than the window (e.g. a decaying envelope)
+        std::vector<WAVTYPE> decreasing;
+        for(int n=0; n<10*winlen; ++n)
+            decreasing.push_back(1.0-0.001*n);
+        ok = check("decreasing", decreasing, winlen) && ok;
+
+        std::vector<WAVTYPE> increasing;
+        for(int n=0; n<10*winlen; ++n)
+            increasing.push_back(0.001*n);
+        ok = check("increasing", increasing, winlen) && ok;
+
+        std::vector<WAVTYPE> constant(10*winlen, 0.5);
+        ok = check("constant", constant, winlen) && ok;
+
+        srand(1);
+        std::vector<WAVTYPE> random;
+        for(int n=0; n<1000; ++n)
+            random.push_back(rand()/double(RAND_MAX));
+        ok = check("random", random, winlen) && ok;
+    }
+
+    return ok?0:1;
+}